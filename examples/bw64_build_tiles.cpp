@@ -0,0 +1,31 @@
+#include <cstdlib>
+#include <iostream>
+#include <bw64/bw64.hpp>
+
+using namespace bw64;
+
+int main(int argc, char const* argv[]) {
+  if (argc < 2 || argc > 4) {
+    std::cout << "usage: " << argv[0]
+              << " [BW64_FILE] ([SIDECAR_FILE] ([TILE_FRAMES]))" << std::endl;
+    std::cout << "builds a channel-major tiled sidecar, by default "
+                 "BW64_FILE.tiles with 65536 frames per tile"
+              << std::endl;
+    exit(1);
+  }
+  const std::string sidecar = argc > 2 ? argv[2] : tiledSidecarPath(argv[1]);
+  const uint32_t tileFrames =
+      argc > 3 ? static_cast<uint32_t>(std::strtoul(argv[3], nullptr, 10))
+               : 65536u;
+  try {
+    auto bw64File = readFile(argv[1]);
+    bw64File->writeTiledSidecar(sidecar, tileFrames);
+    std::cout << "wrote " << sidecar << ": " << bw64File->channels()
+              << " channels, " << bw64File->numberOfFrames() << " frames, "
+              << tileFrames << " frames per tile" << std::endl;
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    exit(1);
+  }
+  return 0;
+}
@@ -0,0 +1,38 @@
+#include <cstdlib>
+#include <iostream>
+#include <bw64/bw64.hpp>
+#include <bw64/proxy.hpp>
+
+using namespace bw64;
+
+int main(int argc, char const* argv[]) {
+  if (argc < 3 || argc > 6) {
+    std::cout << "usage: " << argv[0]
+              << " [BW64_FILE] [PROXY_FILE] ([CHANNELS] ([SAMPLE_RATE] "
+                 "([BIT_DEPTH])))"
+              << std::endl;
+    std::cout << "writes a downmixed, resampled and requantised proxy, by "
+                 "default with 2 channels, 24000 Hz and 16 bits"
+              << std::endl;
+    exit(1);
+  }
+  ProxyOptions options;
+  if (argc > 3)
+    options.channels =
+        static_cast<uint16_t>(std::strtoul(argv[3], nullptr, 10));
+  if (argc > 4)
+    options.sampleRate =
+        static_cast<uint32_t>(std::strtoul(argv[4], nullptr, 10));
+  if (argc > 5)
+    options.bitDepth =
+        static_cast<uint16_t>(std::strtoul(argv[5], nullptr, 10));
+  try {
+    const uint64_t frames = writeProxy(argv[1], argv[2], options);
+    std::cout << "wrote " << argv[2] << ": " << frames << " frames"
+              << std::endl;
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    exit(1);
+  }
+  return 0;
+}
@@ -1,4 +1,4 @@
 #!/bin/bash
-DIRS="examples include src tests"
+DIRS="examples include python src tests"
 
 find $DIRS \( -iname '*.cpp' -or -iname '*.hpp' \) -exec clang-format -style=file -i '{}' +
@@ -0,0 +1,170 @@
+/**
+ * @file async.hpp
+ *
+ * Awaitable C++20 coroutine interface to Bw64Reader and Bw64Writer.
+ *
+ * This header requires C++20 coroutine support, and is empty otherwise; the
+ * rest of the library only requires C++11.
+ */
+#pragma once
+#if __cplusplus >= 202002L && defined(__has_include)
+#if __has_include(<coroutine>)
+#define BW64_HAS_COROUTINES 1
+#endif
+#endif
+
+#ifdef BW64_HAS_COROUTINES
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdint.h>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include "reader.hpp"
+#include "thread_pool.hpp"
+#include "writer.hpp"
+
+namespace bw64 {
+
+  /**
+   * @brief Executes the blocking part of asynchronous operations
+   *
+   * Implement this to run file access on the I/O facility of an application,
+   * e.g. an io_uring based event loop or an existing thread pool.
+   */
+  class Executor {
+   public:
+    virtual ~Executor() = default;
+
+    /// @brief Run a task, usually on another thread
+    ///
+    /// The task does not throw; exceptions are passed on to the awaiting
+    /// coroutine.
+    virtual void execute(std::function<void()> task) = 0;
+  };
+
+  /**
+   * @brief Executor running tasks on a ThreadPool
+   */
+  class ThreadPoolExecutor : public Executor {
+   public:
+    /// @brief Start an executor with the given number of threads
+    explicit ThreadPoolExecutor(
+        size_t threads = std::thread::hardware_concurrency())
+        : pool_(threads) {}
+
+    void execute(std::function<void()> task) override {
+      pool_.submit(std::move(task));
+    }
+
+   private:
+    ThreadPool pool_;
+  };
+
+  /**
+   * @brief Awaitable running a blocking operation on an Executor
+   *
+   * The awaiting coroutine is suspended, the operation is run by the
+   * executor, and the coroutine is resumed on the executor thread once it is
+   * done, without another hand-over to a different thread. Exceptions thrown
+   * by the operation are rethrown by `co_await`.
+   */
+  template <typename T>
+  class AsyncOperation {
+   public:
+    AsyncOperation(Executor& executor, std::function<T()> operation)
+        : executor_(&executor), operation_(std::move(operation)) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+      executor_->execute([this, handle]() {
+        try {
+          if constexpr (std::is_void<T>::value) {
+            operation_();
+          } else {
+            result_.emplace(operation_());
+          }
+        } catch (...) {
+          exception_ = std::current_exception();
+        }
+        handle.resume();
+      });
+    }
+
+    T await_resume() {
+      if (exception_) std::rethrow_exception(exception_);
+      if constexpr (!std::is_void<T>::value) return std::move(*result_);
+    }
+
+   private:
+    struct Empty {};
+    using Result =
+        std::optional<std::conditional_t<std::is_void<T>::value, Empty, T>>;
+
+    Executor* executor_;
+    std::function<T()> operation_;
+    Result result_;
+    std::exception_ptr exception_;
+  };
+
+  /**
+   * @brief Open a BW64 file for reading
+   *
+   * @returns awaitable for a `unique_ptr` to the Bw64Reader
+   */
+  inline AsyncOperation<std::unique_ptr<Bw64Reader>> asyncOpen(
+      Executor& executor, std::string filename) {
+    return AsyncOperation<std::unique_ptr<Bw64Reader>>(
+        executor, [filename = std::move(filename)]() {
+          return std::unique_ptr<Bw64Reader>(
+              new Bw64Reader(filename.c_str()));
+        });
+  }
+
+  /**
+   * @brief Read frames with Bw64Reader::read()
+   *
+   * The reader and buffer must not be used until the read has completed.
+   *
+   * @returns awaitable for the number of frames read
+   */
+  template <typename T, typename std::enable_if<
+                            std::is_floating_point<T>::value, int>::type = 0>
+  AsyncOperation<uint64_t> asyncRead(Executor& executor, Bw64Reader& reader,
+                                     T* outBuffer, uint64_t frames) {
+    return AsyncOperation<uint64_t>(executor, [&reader, outBuffer, frames]() {
+      return reader.read(outBuffer, frames);
+    });
+  }
+
+  /**
+   * @brief Write frames with Bw64Writer::write()
+   *
+   * The writer and buffer must not be used until the write has completed.
+   *
+   * @returns awaitable for the number of frames written
+   */
+  template <typename T, typename std::enable_if<
+                            std::is_floating_point<T>::value, int>::type = 0>
+  AsyncOperation<uint64_t> asyncWrite(Executor& executor, Bw64Writer& writer,
+                                      T* inBuffer, uint64_t frames) {
+    return AsyncOperation<uint64_t>(executor, [&writer, inBuffer, frames]() {
+      return writer.write(inBuffer, frames);
+    });
+  }
+
+  /**
+   * @brief Finalise and close a file with Bw64Writer::close()
+   */
+  inline AsyncOperation<void> asyncClose(Executor& executor,
+                                         Bw64Writer& writer) {
+    return AsyncOperation<void>(executor, [&writer]() { writer.close(); });
+  }
+
+}  // namespace bw64
+
+#endif
@@ -0,0 +1,87 @@
+/**
+ * @file block_cache.hpp
+ *
+ * Interface for caches of decoded blocks, used by Bw64Reader::read().
+ */
+#pragma once
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+
+namespace bw64 {
+
+  /**
+   * @brief Identity of the contents of a file
+   *
+   * Two readers of files with the same identity share cached blocks, so it
+   * must change whenever the file does, e.g. by including its size and
+   * modification time.
+   */
+  struct FileIdentity {
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    uint64_t size = 0;
+    /// modification time in nanoseconds
+    uint64_t modified = 0;
+  };
+
+  inline bool operator==(const FileIdentity& a, const FileIdentity& b) {
+    return a.device == b.device && a.inode == b.inode && a.size == b.size &&
+           a.modified == b.modified;
+  }
+  inline bool operator!=(const FileIdentity& a, const FileIdentity& b) {
+    return !(a == b);
+  }
+
+  /**
+   * @brief Cache of decoded blocks of files
+   *
+   * A block holds the frames `[block * blockFrames, (block + 1) *
+   * blockFrames)` of a file decoded to float, where `blockFrames` is
+   * `blockBytes() / (channels * sizeof(float))`; the last block of a file may
+   * be shorter. Implementations must be safe to use from several threads.
+   *
+   * See Bw64Reader::useBlockCache() and SharedBlockCache.
+   */
+  class BlockCache {
+   public:
+    virtual ~BlockCache() = default;
+
+    /// @brief Get the size of a block in bytes
+    virtual size_t blockBytes() const = 0;
+
+    /// @brief Get the identity of a file; throws if it can not be determined
+    virtual FileIdentity identify(const std::string& filename) = 0;
+
+    /**
+     * @brief Copy part of a block from the cache
+     *
+     * @param file     identity of the file
+     * @param block    index of the block in the file
+     * @param size     size of the whole block in bytes
+     * @param offset   first byte of the block to copy
+     * @param bytes    number of bytes to copy
+     * @param out      buffer for `bytes` bytes
+     *
+     * @returns false if the block is not cached; `out` may then have been
+     * written to
+     */
+    virtual bool lookup(const FileIdentity& file, uint64_t block, size_t size,
+                        size_t offset, size_t bytes, void* out) = 0;
+
+    /**
+     * @brief Offer a block to the cache
+     *
+     * The cache may drop the block, e.g. if it is being written by another
+     * thread.
+     *
+     * @param file  identity of the file
+     * @param block index of the block in the file
+     * @param data  decoded block
+     * @param size  size of the block in bytes
+     */
+    virtual void insert(const FileIdentity& file, uint64_t block,
+                        const void* data, size_t size) = 0;
+  };
+
+}  // namespace bw64
@@ -7,6 +7,7 @@
 #pragma once
 #include "reader.hpp"
 #include "writer.hpp"
+#include "group_writer.hpp"
 
 namespace bw64 {
 
@@ -40,6 +41,8 @@ namespace bw64 {
    * @param bitDepth target bitdepth of the new file
    * @param chnaChunk Channel allocation chunk to include, if any
    * @param axmlChunk AXML chunk to include, if any
+   * @param dataAlignment align the first sample to a multiple of this many
+   * bytes, if not 0; see Bw64Writer::Bw64Writer()
    *
    * @returns `unique_ptr` to a Bw64Writer instance that is ready to write
    * samples.
@@ -49,7 +52,8 @@ namespace bw64 {
       const std::string& filename, uint16_t channels = 1u,
       uint32_t sampleRate = 48000u, uint16_t bitDepth = 24u,
       std::shared_ptr<ChnaChunk> chnaChunk = nullptr,
-      std::shared_ptr<AxmlChunk> axmlChunk = nullptr) {
+      std::shared_ptr<AxmlChunk> axmlChunk = nullptr,
+      uint32_t dataAlignment = 0) {
     std::vector<std::shared_ptr<Chunk>> additionalChunks;
     if (chnaChunk) {
       additionalChunks.push_back(chnaChunk);
@@ -58,7 +62,8 @@ namespace bw64 {
       additionalChunks.push_back(axmlChunk);
     }
     return std::unique_ptr<Bw64Writer>(new Bw64Writer(
-        filename.c_str(), channels, sampleRate, bitDepth, additionalChunks));
+        filename.c_str(), channels, sampleRate, bitDepth, additionalChunks,
+        dataAlignment));
   }
 
 }  // namespace bw64
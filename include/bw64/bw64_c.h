@@ -0,0 +1,188 @@
+/**
+ * @file bw64_c.h
+ *
+ * C interface to libbw64, for use from other languages through their foreign
+ * function interfaces. It is implemented by the `bw64_c` shared library.
+ *
+ * All functions return a ::bw64_status; on failure, bw64_last_error() gives
+ * a description of the error. No C++ exceptions cross this interface.
+ *
+ * Sample buffers are always provided by the caller, or, for the `_view` and
+ * `_buffer` functions, owned by the reader or writer, so that no additional
+ * copies are made at the interface.
+ */
+#ifndef BW64_C_H
+#define BW64_C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32) && !defined(BW64_C_STATIC)
+#if defined(BW64_C_BUILDING)
+#define BW64_C_EXPORT __declspec(dllexport)
+#else
+#define BW64_C_EXPORT __declspec(dllimport)
+#endif
+#elif defined(__GNUC__)
+#define BW64_C_EXPORT __attribute__((visibility("default")))
+#else
+#define BW64_C_EXPORT
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Result of a C API call
+typedef enum bw64_status {
+  /// success
+  BW64_OK = 0,
+  /// an argument was invalid, e.g. a null pointer
+  BW64_INVALID_ARGUMENT = 1,
+  /// the requested chunk is not present
+  BW64_NOT_FOUND = 2,
+  /// any other error, e.g. a malformed file or a failed read or write
+  BW64_ERROR = 3
+} bw64_status;
+
+/// @brief Origin of a seek; see bw64_reader_seek()
+typedef enum bw64_seek_origin {
+  BW64_SEEK_SET = 0,
+  BW64_SEEK_CUR = 1,
+  BW64_SEEK_END = 2
+} bw64_seek_origin;
+
+/// @brief Format of a file
+typedef struct bw64_format {
+  uint16_t format_tag;
+  uint16_t channels;
+  uint32_t sample_rate;
+  uint16_t bit_depth;
+  /// bytes per frame
+  uint16_t block_alignment;
+  /// number of frames in the data chunk; frames written so far for writers
+  uint64_t number_of_frames;
+} bw64_format;
+
+/// @brief Opaque handle of a file opened for reading
+typedef struct bw64_reader bw64_reader;
+/// @brief Opaque handle of a file opened for writing
+typedef struct bw64_writer bw64_writer;
+
+/// @brief Get the description of the last error on the calling thread
+///
+/// The returned string is valid until the next failing call on this thread.
+BW64_C_EXPORT const char* bw64_last_error(void);
+
+/// @brief Get the FourCC id of a four character string, e.g. "axml"
+BW64_C_EXPORT uint32_t bw64_fourcc(const char* id);
+
+/// @brief Open a file for reading
+BW64_C_EXPORT bw64_status bw64_reader_open(const char* filename,
+                                           bw64_reader** reader);
+/// @brief Close a file and free the reader; accepts NULL
+BW64_C_EXPORT void bw64_reader_close(bw64_reader* reader);
+
+/// @brief Get the format of the file
+BW64_C_EXPORT bw64_status bw64_reader_format(const bw64_reader* reader,
+                                             bw64_format* format);
+/// @brief Get the current frame position
+BW64_C_EXPORT bw64_status bw64_reader_tell(const bw64_reader* reader,
+                                           uint64_t* frame);
+/// @brief Seek a frame position; the result is clamped to the data chunk
+BW64_C_EXPORT bw64_status bw64_reader_seek(bw64_reader* reader,
+                                           int64_t offset,
+                                           bw64_seek_origin origin);
+
+/// @brief Read interleaved frames into a caller buffer of
+/// `frames * channels` floats
+BW64_C_EXPORT bw64_status bw64_reader_read(bw64_reader* reader, float* out,
+                                           uint64_t frames,
+                                           uint64_t* frames_read);
+/// @brief Read frames into `channels` caller buffers of `frames` floats
+BW64_C_EXPORT bw64_status bw64_reader_read_planar(bw64_reader* reader,
+                                                  float* const* out,
+                                                  uint64_t frames,
+                                                  uint64_t* frames_read);
+/// @brief Read encoded frames into a caller buffer of
+/// `frames * block_alignment` bytes
+BW64_C_EXPORT bw64_status bw64_reader_read_raw(bw64_reader* reader, void* out,
+                                               uint64_t frames,
+                                               uint64_t* frames_read);
+/// @brief Read encoded frames into memory owned by the reader
+///
+/// `*data` points to `*frames_read` frames, and stays valid until the next
+/// call on this reader.
+BW64_C_EXPORT bw64_status bw64_reader_read_raw_view(bw64_reader* reader,
+                                                    uint64_t frames,
+                                                    const void** data,
+                                                    uint64_t* frames_read);
+
+/// @brief Get the number of chunks in the file
+BW64_C_EXPORT bw64_status bw64_reader_chunk_count(const bw64_reader* reader,
+                                                  size_t* count);
+/// @brief Get the id and size of the chunk at `index` in file order
+BW64_C_EXPORT bw64_status bw64_reader_chunk_info(const bw64_reader* reader,
+                                                 size_t index, uint32_t* id,
+                                                 uint64_t* size);
+/// @brief Get the contents of the first chunk with an id
+///
+/// `*data` points to `*size` bytes owned by the reader, valid until it is
+/// closed. Returns ::BW64_NOT_FOUND if there is no such chunk. The data
+/// chunk is not available; use the read functions instead.
+BW64_C_EXPORT bw64_status bw64_reader_chunk_data(bw64_reader* reader,
+                                                 uint32_t id,
+                                                 const void** data,
+                                                 uint64_t* size);
+
+/// @brief Open a file for writing; an existing file is overwritten
+BW64_C_EXPORT bw64_status bw64_writer_open(const char* filename,
+                                           uint16_t channels,
+                                           uint32_t sample_rate,
+                                           uint16_t bit_depth,
+                                           bw64_writer** writer);
+/// @brief Finalise and close a file, and free the writer; accepts NULL
+///
+/// The writer is freed even if finalising the file fails.
+BW64_C_EXPORT bw64_status bw64_writer_close(bw64_writer* writer);
+
+/// @brief Get the format of the file
+BW64_C_EXPORT bw64_status bw64_writer_format(const bw64_writer* writer,
+                                             bw64_format* format);
+
+/// @brief Write interleaved frames from a caller buffer of
+/// `frames * channels` floats
+BW64_C_EXPORT bw64_status bw64_writer_write(bw64_writer* writer,
+                                            const float* in, uint64_t frames);
+/// @brief Write frames from `channels` caller buffers of `frames` floats
+BW64_C_EXPORT bw64_status bw64_writer_write_planar(bw64_writer* writer,
+                                                   const float* const* in,
+                                                   uint64_t frames);
+/// @brief Write encoded frames from a caller buffer
+BW64_C_EXPORT bw64_status bw64_writer_write_raw(bw64_writer* writer,
+                                                const void* in,
+                                                uint64_t frames);
+/// @brief Get memory owned by the writer for `frames` encoded frames
+///
+/// Fill it, then call bw64_writer_commit() to write them without a further
+/// copy. The buffer stays valid until the next call on this writer.
+BW64_C_EXPORT bw64_status bw64_writer_buffer(bw64_writer* writer,
+                                             uint64_t frames, void** data);
+/// @brief Write `frames` frames from the buffer of bw64_writer_buffer()
+BW64_C_EXPORT bw64_status bw64_writer_commit(bw64_writer* writer,
+                                             uint64_t frames);
+
+/// @brief Set the contents of the axml chunk, written when closing
+BW64_C_EXPORT bw64_status bw64_writer_set_axml(bw64_writer* writer,
+                                               const char* data, size_t size);
+/// @brief Add a marker at a frame, with an optional label (may be NULL)
+BW64_C_EXPORT bw64_status bw64_writer_add_marker(bw64_writer* writer,
+                                                 uint64_t frame,
+                                                 const char* label,
+                                                 uint32_t* cue_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BW64_C_H */
@@ -272,6 +272,317 @@ namespace bw64 {
     std::string data_;
   };
 
+  /**
+   * @brief Cue point of a CueChunk, as stored in the file
+   */
+  struct CuePoint {
+    /// unique identifier, used to refer to the cue point from labels
+    uint32_t id;
+    /// position in the play order
+    uint32_t position;
+    /// id of the chunk containing the cue point; 'data'
+    uint32_t dataChunkId;
+    /// position of the chunk in a wave list; 0
+    uint32_t chunkStart;
+    /// position of the block containing the cue point; 0
+    uint32_t blockStart;
+    /// frame position of the cue point in the data chunk
+    uint32_t sampleOffset;
+  };
+
+  /**
+   * @brief Class representation of a CueChunk
+   *
+   * Cue points are kept in the order in which they are stored in the file.
+   */
+  class CueChunk : public Chunk {
+   public:
+    static uint32_t Id() { return utils::fourCC("cue "); }
+
+    CueChunk() = default;
+    CueChunk(std::vector<CuePoint> cuePoints)
+        : cuePoints_(std::move(cuePoints)) {}
+
+    uint32_t id() const override { return CueChunk::Id(); }
+    uint64_t size() const override {
+      return sizeof(uint32_t) + cuePoints_.size() * sizeof(CuePoint);
+    }
+
+    /// @brief CuePoints getter
+    const std::vector<CuePoint>& cuePoints() const { return cuePoints_; }
+    /// @brief Add a cue point
+    void addCuePoint(const CuePoint& cuePoint) {
+      cuePoints_.push_back(cuePoint);
+    }
+
+    void write(std::ostream& stream) const override {
+      utils::writeValue(stream, utils::safeCast<uint32_t>(cuePoints_.size()));
+      stream.write(reinterpret_cast<const char*>(cuePoints_.data()),
+                   cuePoints_.size() * sizeof(CuePoint));
+    }
+
+   private:
+    std::vector<CuePoint> cuePoints_;
+  };
+
+  /**
+   * @brief Text attached to a cue point by a 'labl' or 'note' sub-chunk
+   */
+  struct CueText {
+    uint32_t cueId;
+    std::string text;
+  };
+
+  /**
+   * @brief Class representation of an associated data list ('LIST' chunk of
+   * type 'adtl')
+   *
+   * The sub-chunks are kept as stored in the file, so chunks with many
+   * labels are read and written without creating an object per label.
+   * Labels and notes are decoded on request; other sub-chunks (e.g. 'ltxt')
+   * are preserved.
+   */
+  class AdtlChunk : public Chunk {
+   public:
+    AdtlChunk() = default;
+    /// @brief Create from the sub-chunks following the 'adtl' list type
+    AdtlChunk(std::vector<char> subChunks) : data_(std::move(subChunks)) {}
+
+    uint32_t id() const override { return utils::fourCC("LIST"); }
+    uint64_t size() const override { return 4u + data_.size(); }
+
+    /// @brief Get the labels ('labl' sub-chunks)
+    std::vector<CueText> labels() const {
+      return texts(utils::fourCC("labl"));
+    }
+    /// @brief Get the notes ('note' sub-chunks)
+    std::vector<CueText> notes() const { return texts(utils::fourCC("note")); }
+
+    /// @brief Add a label to a cue point
+    void addLabel(uint32_t cueId, const std::string& text) {
+      addText(utils::fourCC("labl"), cueId, text);
+    }
+    /// @brief Add a note to a cue point
+    void addNote(uint32_t cueId, const std::string& text) {
+      addText(utils::fourCC("note"), cueId, text);
+    }
+
+    /// @brief Get the sub-chunks as stored in the file
+    const std::vector<char>& data() const { return data_; }
+
+    void write(std::ostream& stream) const override {
+      utils::writeValue(stream, utils::fourCC("adtl"));
+      stream.write(data_.data(), data_.size());
+    }
+
+   private:
+    void addText(uint32_t subChunkId, uint32_t cueId,
+                 const std::string& text) {
+      const uint32_t size = utils::safeCast<uint32_t>(
+          sizeof(cueId) + text.size() + 1);
+      const char* values[] = {reinterpret_cast<const char*>(&subChunkId),
+                              reinterpret_cast<const char*>(&size),
+                              reinterpret_cast<const char*>(&cueId)};
+      for (const char* value : values)
+        data_.insert(data_.end(), value, value + sizeof(uint32_t));
+      data_.insert(data_.end(), text.begin(), text.end());
+      data_.push_back('\0');
+      if (size % 2 == 1) data_.push_back('\0');
+    }
+
+    std::vector<CueText> texts(uint32_t subChunkId) const {
+      std::vector<CueText> result;
+      size_t position = 0;
+      while (position + 8 <= data_.size()) {
+        const uint32_t id = utils::loadValue<uint32_t>(&data_[position]);
+        const uint32_t size = utils::loadValue<uint32_t>(&data_[position + 4]);
+        const size_t start = position + 8;
+        if (size > data_.size() - start)
+          throw std::runtime_error("adtl sub-chunk ends after end of chunk");
+        if (id == subChunkId && size >= 4) {
+          result.push_back(CueText{utils::loadValue<uint32_t>(&data_[start]),
+                                   utils::fixedString(&data_[start + 4],
+                                                      size - 4)});
+        }
+        position = start + size + size % 2;
+      }
+      return result;
+    }
+
+    std::vector<char> data_;
+  };
+
+  /**
+   * @brief Class representation of a BextChunk (Broadcast Audio Extension)
+   *
+   * The fixed fields are always available. The CodingHistory, which may be
+   * large, is only held if it has been loaded or set; size() and write()
+   * cover the fixed fields and the CodingHistory held.
+   */
+  class BextChunk : public Chunk {
+   public:
+    static uint32_t Id() { return utils::fourCC("bext"); }
+
+    /// @brief Size of the fields before the CodingHistory
+    static uint64_t fixedSize() { return 602; }
+
+    uint32_t id() const override { return BextChunk::Id(); }
+    /// @brief Size of the chunk, including a CodingHistory which is not
+    /// loaded
+    uint64_t size() const override { return fixedSize() + codingHistorySize_; }
+
+    /**
+     * @brief Write the BextChunk to a stream
+     *
+     * Throws if the CodingHistory is not loaded (see hasCodingHistory()), as
+     * the chunk would lose it; load it with Bw64Reader::readBextCodingHistory()
+     * or clear it with `codingHistory("")` first.
+     */
+    void write(std::ostream& stream) const override {
+      if (!hasCodingHistory())
+        throw std::runtime_error(
+            "bext CodingHistory is not loaded; read it before writing");
+      writeString(stream, description_, 256);
+      writeString(stream, originator_, 32);
+      writeString(stream, originatorReference_, 32);
+      writeString(stream, originationDate_, 10);
+      writeString(stream, originationTime_, 8);
+      utils::writeValue(stream, static_cast<uint32_t>(timeReference_));
+      utils::writeValue(stream, static_cast<uint32_t>(timeReference_ >> 32));
+      utils::writeValue(stream, version_);
+      stream.write(umid_, sizeof(umid_));
+      utils::writeValue(stream, loudnessValue_);
+      utils::writeValue(stream, loudnessRange_);
+      utils::writeValue(stream, maxTruePeakLevel_);
+      utils::writeValue(stream, maxMomentaryLoudness_);
+      utils::writeValue(stream, maxShortTermLoudness_);
+      writeString(stream, "", 180);
+      stream << codingHistory_;
+    }
+
+    /// @brief Description getter
+    const std::string& description() const { return description_; }
+    /// @brief Originator getter
+    const std::string& originator() const { return originator_; }
+    /// @brief OriginatorReference getter
+    const std::string& originatorReference() const {
+      return originatorReference_;
+    }
+    /// @brief OriginationDate getter (yyyy-mm-dd)
+    const std::string& originationDate() const { return originationDate_; }
+    /// @brief OriginationTime getter (hh-mm-ss)
+    const std::string& originationTime() const { return originationTime_; }
+    /// @brief TimeReference getter; first sample count since midnight
+    uint64_t timeReference() const { return timeReference_; }
+    /// @brief Version getter
+    uint16_t version() const { return version_; }
+    /// @brief UMID getter; 64 bytes
+    const char* umid() const { return umid_; }
+    /// @brief LoudnessValue getter, in 0.01 LUFS
+    int16_t loudnessValue() const { return loudnessValue_; }
+    /// @brief LoudnessRange getter, in 0.01 LU
+    int16_t loudnessRange() const { return loudnessRange_; }
+    /// @brief MaxTruePeakLevel getter, in 0.01 dBTP
+    int16_t maxTruePeakLevel() const { return maxTruePeakLevel_; }
+    /// @brief MaxMomentaryLoudness getter, in 0.01 LUFS
+    int16_t maxMomentaryLoudness() const { return maxMomentaryLoudness_; }
+    /// @brief MaxShortTermLoudness getter, in 0.01 LUFS
+    int16_t maxShortTermLoudness() const { return maxShortTermLoudness_; }
+    /// @brief CodingHistory getter; empty if it has not been loaded
+    const std::string& codingHistory() const { return codingHistory_; }
+    /// @brief Size of the CodingHistory, loaded or not
+    uint64_t codingHistorySize() const { return codingHistorySize_; }
+    /// @brief Check if the CodingHistory has been loaded or set
+    bool hasCodingHistory() const {
+      return codingHistory_.size() == codingHistorySize_;
+    }
+
+    /// @brief Description setter; at most 256 characters
+    void description(std::string value) {
+      description_ = checkedString(std::move(value), 256, "Description");
+    }
+    /// @brief Originator setter; at most 32 characters
+    void originator(std::string value) {
+      originator_ = checkedString(std::move(value), 32, "Originator");
+    }
+    /// @brief OriginatorReference setter; at most 32 characters
+    void originatorReference(std::string value) {
+      originatorReference_ =
+          checkedString(std::move(value), 32, "OriginatorReference");
+    }
+    /// @brief OriginationDate setter; at most 10 characters
+    void originationDate(std::string value) {
+      originationDate_ = checkedString(std::move(value), 10, "OriginationDate");
+    }
+    /// @brief OriginationTime setter; at most 8 characters
+    void originationTime(std::string value) {
+      originationTime_ = checkedString(std::move(value), 8, "OriginationTime");
+    }
+    /// @brief TimeReference setter
+    void timeReference(uint64_t value) { timeReference_ = value; }
+    /// @brief Version setter
+    void version(uint16_t value) { version_ = value; }
+    /// @brief UMID setter; copies 64 bytes
+    void umid(const char* value) { std::copy(value, value + 64, umid_); }
+    /// @brief LoudnessValue setter
+    void loudnessValue(int16_t value) { loudnessValue_ = value; }
+    /// @brief LoudnessRange setter
+    void loudnessRange(int16_t value) { loudnessRange_ = value; }
+    /// @brief MaxTruePeakLevel setter
+    void maxTruePeakLevel(int16_t value) { maxTruePeakLevel_ = value; }
+    /// @brief MaxMomentaryLoudness setter
+    void maxMomentaryLoudness(int16_t value) { maxMomentaryLoudness_ = value; }
+    /// @brief MaxShortTermLoudness setter
+    void maxShortTermLoudness(int16_t value) { maxShortTermLoudness_ = value; }
+    /// @brief CodingHistory setter
+    void codingHistory(std::string value) {
+      codingHistory_ = std::move(value);
+      codingHistorySize_ = codingHistory_.size();
+    }
+    /// @brief Set the size of a CodingHistory which is not loaded
+    void codingHistorySize(uint64_t size) {
+      codingHistory_.clear();
+      codingHistorySize_ = size;
+    }
+
+   private:
+    static std::string checkedString(std::string value, size_t maxSize,
+                                     const char* field) {
+      if (value.size() > maxSize) {
+        std::stringstream errorString;
+        errorString << "bext " << field << " is too long (" << value.size()
+                    << " > " << maxSize << ")";
+        throw std::runtime_error(errorString.str());
+      }
+      return value;
+    }
+
+    static void writeString(std::ostream& stream, const std::string& value,
+                            size_t size) {
+      stream.write(value.data(), value.size());
+      for (size_t i = value.size(); i < size; ++i) {
+        utils::writeValue(stream, '\0');
+      }
+    }
+
+    std::string description_;
+    std::string originator_;
+    std::string originatorReference_;
+    std::string originationDate_;
+    std::string originationTime_;
+    uint64_t timeReference_{0};
+    uint16_t version_{2};
+    char umid_[64] = {};
+    // 0x7fff marks loudness values as not set
+    int16_t loudnessValue_{0x7fff};
+    int16_t loudnessRange_{0x7fff};
+    int16_t maxTruePeakLevel_{0x7fff};
+    int16_t maxMomentaryLoudness_{0x7fff};
+    int16_t maxShortTermLoudness_{0x7fff};
+    std::string codingHistory_;
+    uint64_t codingHistorySize_{0};
+  };
+
   /**
    * @brief Class representation of an AudioId field
    */
@@ -0,0 +1,263 @@
+/**
+ * @file group_writer.hpp
+ *
+ * Multi-producer front end for Bw64Writer.
+ */
+#pragma once
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <stdint.h>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "writer.hpp"
+
+namespace bw64 {
+
+  /**
+   * @brief Contiguous range of channels which is produced by one thread
+   */
+  struct ChannelGroup {
+    ChannelGroup(uint16_t firstChannel = 0, uint16_t channels = 0)
+        : firstChannel(firstChannel), channels(channels) {}
+    uint16_t firstChannel;
+    uint16_t channels;
+  };
+
+  /**
+   * @brief Write one file from several producer threads
+   *
+   * Every producer owns one ChannelGroup and submits the samples of its
+   * channels block by block, independently of the other producers. The
+   * samples are encoded straight into their interleaved position of a shared
+   * staging block, so neither an interleave barrier nor an extra copy of the
+   * full frame buffer is needed. Whichever producer completes a block hands it
+   * over to the Bw64Writer; blocks are always written in order.
+   *
+   * The handoff is lock-free: a producer which runs more than
+   * `numberOfSlots` blocks ahead of the slowest group yields until a staging
+   * slot becomes free.
+   *
+   * Each group must only be submitted to by one thread at a time. The
+   * Bw64Writer must not be used directly while producers are active.
+   *
+   * If a submit fails in a way which would leave the other producers waiting
+   * for a block that is never completed (a frame count mismatch, or an error
+   * while writing), or if abort() is called, the writer fails: no further
+   * blocks are written, and all waiting and later submits throw the first
+   * error.
+   */
+  class ChannelGroupWriter {
+   public:
+    /**
+     * @brief Create a new ChannelGroupWriter
+     *
+     * @param writer Bw64Writer which the assembled blocks are written to
+     * @param groups channel groups; these must not overlap, channels not
+     * covered by any group are written as silence
+     * @param blockFrames maximum number of frames per submitted block
+     * @param numberOfSlots number of blocks which can be in flight at once
+     */
+    ChannelGroupWriter(Bw64Writer& writer, std::vector<ChannelGroup> groups,
+                       uint64_t blockFrames, size_t numberOfSlots = 4)
+        : writer_(writer),
+          groups_(std::move(groups)),
+          nextBlock_(groups_.size(), 0),
+          blockFrames_(blockFrames),
+          numberOfSlots_(numberOfSlots),
+          nextWrite_(0),
+          writing_(false),
+          failing_(false),
+          failed_(false) {
+      if (groups_.empty()) {
+        throw std::runtime_error("at least one channel group is required");
+      }
+      if (blockFrames_ == 0 || numberOfSlots_ == 0) {
+        throw std::runtime_error("blockFrames and numberOfSlots must be > 0");
+      }
+      std::vector<bool> used(writer_.channels(), false);
+      for (auto& group : groups_) {
+        if (group.channels == 0 ||
+            group.firstChannel + group.channels > writer_.channels()) {
+          std::stringstream errorString;
+          errorString << "channel group [" << group.firstChannel << ", "
+                      << group.firstChannel + group.channels
+                      << ") is out of range";
+          throw std::runtime_error(errorString.str());
+        }
+        for (uint16_t c = 0; c < group.channels; ++c) {
+          if (used[group.firstChannel + c]) {
+            throw std::runtime_error("channel groups must not overlap");
+          }
+          used[group.firstChannel + c] = true;
+        }
+      }
+
+      const uint64_t blockBytes =
+          blockFrames_ * writer_.formatChunk()->blockAlignment();
+      slots_.reset(new Slot[numberOfSlots_]);
+      for (size_t i = 0; i < numberOfSlots_; ++i) {
+        slots_[i].data.resize(utils::safeCast<size_t>(blockBytes), '\0');
+        slots_[i].block = i;
+        slots_[i].pending = groups_.size();
+        slots_[i].frames = 0;
+      }
+    }
+
+    ChannelGroupWriter(const ChannelGroupWriter&) = delete;
+    ChannelGroupWriter& operator=(const ChannelGroupWriter&) = delete;
+
+    /// @brief Get number of channel groups
+    size_t groups() const { return groups_.size(); }
+    /// @brief Get maximum number of frames per block
+    uint64_t blockFrames() const { return blockFrames_; }
+    /// @brief Get number of blocks which have been written to the file
+    uint64_t blocksWritten() const { return nextWrite_; }
+    /// @brief Check if the writer has failed or was aborted
+    bool failed() const { return failed_.load(); }
+
+    /**
+     * @brief Make all waiting and later submits throw
+     *
+     * Call this from a producer which stops before it has submitted all of its
+     * blocks, so that the others do not wait for it forever.
+     */
+    void abort() {
+      fail(std::make_exception_ptr(
+          std::runtime_error("channel group writer was aborted")));
+    }
+
+    /**
+     * @brief Submit the next block of one channel group
+     *
+     * Blocks are numbered per group, i.e. the n-th call for a group delivers
+     * its channels for the n-th block of the file. All groups must submit the
+     * same number of frames for a given block; only the last block of a file
+     * may be shorter than `blockFrames`.
+     *
+     * @param[in] group    index of the channel group
+     * @param[in] inBuffer interleaved samples of the group's channels
+     * @param[in] frames   number of frames in inBuffer
+     *
+     * @throws std::runtime_error if the arguments are invalid, and the first
+     * error of the writer if it has failed (see failed())
+     */
+    template <typename T, typename std::enable_if<
+                              std::is_floating_point<T>::value, int>::type = 0>
+    void submit(size_t group, const T* inBuffer, uint64_t frames) {
+      if (group >= groups_.size()) {
+        throw std::runtime_error("channel group index out of range");
+      }
+      if (frames == 0 || frames > blockFrames_) {
+        std::stringstream errorString;
+        errorString << "number of frames must be in [1, " << blockFrames_
+                    << "], but is " << frames;
+        throw std::runtime_error(errorString.str());
+      }
+
+      const uint64_t block = nextBlock_[group];
+      Slot& slot = slots_[block % numberOfSlots_];
+      throwIfFailed();
+      while (slot.block.load() != block) {
+        throwIfFailed();
+        std::this_thread::yield();
+      }
+
+      uint64_t expectedFrames = 0;
+      if (!slot.frames.compare_exchange_strong(expectedFrames, frames) &&
+          expectedFrames != frames) {
+        // the other groups wait for this block, which is never completed
+        std::stringstream errorString;
+        errorString << "block " << block << " was submitted with "
+                    << expectedFrames << " frames by another group, but with "
+                    << frames << " frames by group " << group;
+        fail(std::make_exception_ptr(std::runtime_error(errorString.str())));
+        throw std::runtime_error(errorString.str());
+      }
+
+      const ChannelGroup& channelGroup = groups_[group];
+      const uint16_t bitDepth = writer_.bitDepth();
+      const uint64_t blockAlignment = writer_.formatChunk()->blockAlignment();
+      const uint64_t offset = channelGroup.firstChannel * (bitDepth / 8u);
+      for (uint64_t frame = 0; frame < frames; ++frame) {
+        utils::encodePcmSamples(
+            inBuffer + frame * channelGroup.channels,
+            &slot.data[frame * blockAlignment + offset],
+            channelGroup.channels, bitDepth);
+      }
+      nextBlock_[group] = block + 1;
+
+      if (slot.pending.fetch_sub(1) == 1) {
+        writeCompleteBlocks();
+      }
+    }
+
+   private:
+    struct Slot {
+      std::vector<char> data;
+      std::atomic<uint64_t> block;
+      std::atomic<size_t> pending;
+      std::atomic<uint64_t> frames;
+    };
+
+    /// record the first error, and make waiting submits throw it
+    void fail(std::exception_ptr error) {
+      if (failing_.exchange(true)) return;
+      error_ = error;
+      failed_ = true;
+    }
+
+    void throwIfFailed() const {
+      if (failed_.load()) std::rethrow_exception(error_);
+    }
+
+    bool nextBlockComplete() const {
+      if (failed_.load()) return false;
+      const uint64_t block = nextWrite_.load();
+      const Slot& slot = slots_[block % numberOfSlots_];
+      return slot.block.load() == block && slot.pending.load() == 0;
+    }
+
+    /// write all blocks which are complete, in order. Only one thread writes
+    /// at a time; a thread which completes a block while another one is
+    /// writing leaves it to that thread, which checks again after releasing
+    /// the write flag.
+    void writeCompleteBlocks() {
+      while (nextBlockComplete()) {
+        if (writing_.exchange(true)) return;
+        try {
+          while (nextBlockComplete()) {
+            const uint64_t block = nextWrite_.load();
+            Slot& slot = slots_[block % numberOfSlots_];
+            writer_.writeRaw(slot.data.data(), slot.frames.load());
+            slot.frames = 0;
+            slot.pending = groups_.size();
+            nextWrite_ = block + 1;
+            slot.block = block + numberOfSlots_;
+          }
+        } catch (...) {
+          fail(std::current_exception());
+          writing_ = false;
+          throw;
+        }
+        writing_ = false;
+      }
+    }
+
+    Bw64Writer& writer_;
+    std::vector<ChannelGroup> groups_;
+    std::vector<uint64_t> nextBlock_;
+    uint64_t blockFrames_;
+    size_t numberOfSlots_;
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<uint64_t> nextWrite_;
+    std::atomic<bool> writing_;
+    std::atomic<bool> failing_;
+    std::atomic<bool> failed_;
+    std::exception_ptr error_;
+  };
+
+}  // namespace bw64
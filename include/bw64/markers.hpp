@@ -0,0 +1,130 @@
+/// @file markers.hpp
+#pragma once
+#include <algorithm>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include "chunks.hpp"
+
+namespace bw64 {
+
+  /**
+   * @brief Marker of a file, from a cue point and its label
+   */
+  struct Marker {
+    /// frame position in the data chunk
+    uint64_t frame;
+    /// id of the cue point
+    uint32_t cueId;
+    /// label of the cue point; empty if it has none
+    std::string label;
+  };
+
+  /**
+   * @brief Markers of a file, sorted by frame
+   *
+   * Built once from the 'cue ' chunk and the labels of the 'LIST' chunks of
+   * type 'adtl'. All queries are binary searches.
+   */
+  class MarkerIndex {
+   public:
+    MarkerIndex() = default;
+
+    /**
+     * @brief Build the index
+     *
+     * Cue points which are not in the data chunk (e.g. in a playlist) or
+     * which are after its end are ignored, so that seeking to a marker never
+     * has to clamp its frame. A marker at `numberOfFrames` marks the end of
+     * the file.
+     * Markers at the same frame keep the order of the cue chunk.
+     *
+     * @param cueChunk cue points of the file
+     * @param adtlChunks chunks with labels of the cue points
+     * @param numberOfFrames number of frames in the data chunk
+     */
+    MarkerIndex(const CueChunk& cueChunk,
+                const std::vector<std::shared_ptr<AdtlChunk>>& adtlChunks,
+                uint64_t numberOfFrames) {
+      for (auto& cuePoint : cueChunk.cuePoints()) {
+        if (cuePoint.dataChunkId != utils::fourCC("data") &&
+            cuePoint.dataChunkId != 0)
+          continue;
+        if (cuePoint.sampleOffset > numberOfFrames) continue;
+        markers_.push_back(
+            Marker{cuePoint.sampleOffset, cuePoint.id, std::string()});
+      }
+      std::stable_sort(markers_.begin(), markers_.end(),
+                       [](const Marker& lhs, const Marker& rhs) {
+                         return lhs.frame < rhs.frame;
+                       });
+
+      for (size_t i = 0; i < markers_.size(); ++i)
+        byCueId_.push_back(std::make_pair(markers_[i].cueId, i));
+      std::sort(byCueId_.begin(), byCueId_.end());
+
+      for (auto& adtlChunk : adtlChunks) {
+        for (auto& label : adtlChunk->labels()) {
+          auto it = findCueId(label.cueId);
+          if (it != byCueId_.end() && markers_[it->second].label.empty())
+            markers_[it->second].label = std::move(label.text);
+        }
+      }
+    }
+
+    /// @brief Get number of markers
+    size_t size() const { return markers_.size(); }
+    /// @brief Check if there are no markers
+    bool empty() const { return markers_.empty(); }
+    /// @brief Get the marker with an index in frame order
+    const Marker& operator[](size_t index) const { return markers_[index]; }
+    /// @brief Get all markers in frame order
+    const std::vector<Marker>& markers() const { return markers_; }
+
+    /// @brief First marker after `frame`, or nullptr
+    const Marker* next(uint64_t frame) const {
+      auto it = std::upper_bound(
+          markers_.begin(), markers_.end(), frame,
+          [](uint64_t frame, const Marker& marker) {
+            return frame < marker.frame;
+          });
+      return it == markers_.end() ? nullptr : &*it;
+    }
+
+    /// @brief Last marker before `frame`, or nullptr
+    const Marker* previous(uint64_t frame) const {
+      auto it = std::lower_bound(
+          markers_.begin(), markers_.end(), frame,
+          [](const Marker& marker, uint64_t frame) {
+            return marker.frame < frame;
+          });
+      return it == markers_.begin() ? nullptr : &*(it - 1);
+    }
+
+    /// @brief Marker with a cue point id, or nullptr
+    const Marker* find(uint32_t cueId) const {
+      auto it = findCueId(cueId);
+      return it == byCueId_.end() ? nullptr : &markers_[it->second];
+    }
+
+   private:
+    using CueIdTable = std::vector<std::pair<uint32_t, size_t>>;
+
+    CueIdTable::const_iterator findCueId(uint32_t cueId) const {
+      auto it = std::lower_bound(
+          byCueId_.begin(), byCueId_.end(), cueId,
+          [](const std::pair<uint32_t, size_t>& entry, uint32_t cueId) {
+            return entry.first < cueId;
+          });
+      if (it != byCueId_.end() && it->first != cueId) return byCueId_.end();
+      return it;
+    }
+
+    std::vector<Marker> markers_;
+    /// (cue id, marker index), sorted by cue id
+    CueIdTable byCueId_;
+  };
+
+}  // namespace bw64
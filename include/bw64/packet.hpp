@@ -0,0 +1,129 @@
+/**
+ * @file packet.hpp
+ *
+ * Helpers to read big-endian L16/L24 packet payloads, as used by RTP based
+ * network audio such as AES67.
+ */
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <stdexcept>
+#include <stdint.h>
+#include <vector>
+#include "reader.hpp"
+#include "utils.hpp"
+
+namespace bw64 {
+
+  /**
+   * @brief Get the number of frames in a packet of a given duration
+   *
+   * Throws if the packet time is not a whole number of frames, e.g. 333 us
+   * at 44.1 kHz.
+   */
+  inline uint64_t framesPerPacket(uint32_t sampleRate,
+                                  std::chrono::microseconds packetTime) {
+    const uint64_t product =
+        static_cast<uint64_t>(sampleRate) * packetTime.count();
+    if (packetTime.count() <= 0 || product % 1000000 != 0) {
+      std::stringstream errorString;
+      errorString << "packet time of " << packetTime.count()
+                  << " us is not a whole number of frames at " << sampleRate
+                  << " Hz";
+      throw std::runtime_error(errorString.str());
+    }
+    return product / 1000000;
+  }
+
+  /**
+   * @brief Read a file as fixed size big-endian packet payloads
+   *
+   * Frames for several packets are read from the file at once, and converted
+   * from the PCM data of the file straight into the payloads, which may be
+   * spaced apart to leave room for packet headers. The last packet is padded
+   * with silence.
+   */
+  class PacketReader {
+   public:
+    /**
+     * @brief Create a PacketReader
+     *
+     * @param reader file to read from, starting at its current position
+     * @param bitDepth bit depth of the payload samples; 16 or 24
+     * @param framesPerPacket number of frames per packet
+     */
+    PacketReader(Bw64Reader& reader, uint16_t bitDepth,
+                 uint64_t framesPerPacket)
+        : reader_(reader),
+          bitDepth_(bitDepth),
+          framesPerPacket_(framesPerPacket) {
+      if (bitDepth != 16 && bitDepth != 24) {
+        std::stringstream errorString;
+        errorString << "unsupported payload bit depth: " << bitDepth;
+        throw std::runtime_error(errorString.str());
+      }
+      if (framesPerPacket == 0)
+        throw std::runtime_error("framesPerPacket must be > 0");
+    }
+
+    /// @brief Get bit depth of the payload samples
+    uint16_t bitDepth() const { return bitDepth_; }
+    /// @brief Get number of frames per packet
+    uint64_t framesPerPacket() const { return framesPerPacket_; }
+    /// @brief Get size of one payload in bytes
+    uint64_t payloadSize() const {
+      return framesPerPacket_ * reader_.channels() * (bitDepth_ / 8u);
+    }
+
+    /**
+     * @brief Read the payloads of several packets
+     *
+     * @param[out] outBuffer buffer holding the payloads; payload `i` is
+     * written to `outBuffer + i * stride`
+     * @param[in] packets maximum number of packets to read
+     * @param[in] stride distance between payloads in bytes; at least
+     * payloadSize()
+     *
+     * @returns number of packets written; less than `packets` at the end of
+     * the file
+     */
+    size_t readPackets(char* outBuffer, size_t packets, uint64_t stride) {
+      if (stride < payloadSize())
+        throw std::runtime_error("stride is smaller than the payload size");
+      const uint64_t packetBytes = framesPerPacket_ * reader_.blockAlignment();
+      const uint64_t samplesPerPacket = framesPerPacket_ * reader_.channels();
+      raw_.resize(utils::safeCast<size_t>(packets * packetBytes));
+      const uint64_t frames =
+          reader_.readRaw(raw_.data(), packets * framesPerPacket_);
+      const size_t written = utils::safeCast<size_t>(
+          (frames + framesPerPacket_ - 1) / framesPerPacket_);
+
+      // pad the last packet with silence
+      std::fill(raw_.begin() + frames * reader_.blockAlignment(),
+                raw_.begin() + written * packetBytes, 0);
+      for (size_t i = 0; i < written; ++i) {
+        utils::convertPcmSamplesToBigEndian(
+            raw_.data() + i * packetBytes, outBuffer + i * stride,
+            samplesPerPacket, reader_.bitDepth(), bitDepth_);
+      }
+      return written;
+    }
+
+    /**
+     * @brief Read the payload of one packet
+     *
+     * @returns false at the end of the file
+     */
+    bool readPacket(char* outBuffer) {
+      return readPackets(outBuffer, 1, payloadSize()) == 1;
+    }
+
+   private:
+    Bw64Reader& reader_;
+    uint16_t bitDepth_;
+    uint64_t framesPerPacket_;
+    std::vector<char> raw_;
+  };
+
+}  // namespace bw64
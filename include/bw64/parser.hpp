@@ -4,6 +4,11 @@
  * Collection of parser functions, which construct chunk objects from istreams.
  */
 #pragma once
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
 #include "chunks.hpp"
 #include "utils.hpp"
 
@@ -127,6 +132,148 @@ namespace bw64 {
     return std::make_shared<AxmlChunk>(std::move(data));
   }
 
+  /**
+   * @brief Parse BextChunk from input stream
+   *
+   * The fixed fields are decoded from a single read; the CodingHistory is
+   * skipped, and can be loaded with Bw64Reader::readBextCodingHistory().
+   */
+  inline std::shared_ptr<BextChunk> parseBextChunk(std::istream& stream,
+                                                   uint32_t id, uint64_t size) {
+    if (id != utils::fourCC("bext")) {
+      std::stringstream errorString;
+      errorString << "chunkId != 'bext'";
+      throw std::runtime_error(errorString.str());
+    }
+    if (size < BextChunk::fixedSize()) {
+      std::stringstream errorString;
+      errorString << "bext chunk is too small: " << size << " < "
+                  << BextChunk::fixedSize();
+      throw std::runtime_error(errorString.str());
+    }
+    char fields[602];  // BextChunk::fixedSize()
+    utils::readChunk(stream, fields, sizeof(fields));
+
+    auto bextChunk = std::make_shared<BextChunk>();
+    bextChunk->description(utils::fixedString(fields, 256));
+    bextChunk->originator(utils::fixedString(fields + 256, 32));
+    bextChunk->originatorReference(utils::fixedString(fields + 288, 32));
+    bextChunk->originationDate(utils::fixedString(fields + 320, 10));
+    bextChunk->originationTime(utils::fixedString(fields + 330, 8));
+    bextChunk->timeReference(
+        utils::loadValue<uint32_t>(fields + 338) |
+        static_cast<uint64_t>(utils::loadValue<uint32_t>(fields + 342))
+            << 32);
+    bextChunk->version(utils::loadValue<uint16_t>(fields + 346));
+    bextChunk->umid(fields + 348);
+    bextChunk->loudnessValue(utils::loadValue<int16_t>(fields + 412));
+    bextChunk->loudnessRange(utils::loadValue<int16_t>(fields + 414));
+    bextChunk->maxTruePeakLevel(
+        utils::loadValue<int16_t>(fields + 416));
+    bextChunk->maxMomentaryLoudness(
+        utils::loadValue<int16_t>(fields + 418));
+    bextChunk->maxShortTermLoudness(
+        utils::loadValue<int16_t>(fields + 420));
+    bextChunk->codingHistorySize(size - BextChunk::fixedSize());
+    return bextChunk;
+  }
+
+  /// @brief Parse BextChunk from input stream, including the CodingHistory
+  inline std::shared_ptr<BextChunk> parseBextChunkWithCodingHistory(
+      std::istream& stream, uint32_t id, uint64_t size) {
+    auto bextChunk = parseBextChunk(stream, id, size);
+    std::string codingHistory(
+        utils::safeCast<size_t>(bextChunk->codingHistorySize()), 0);
+    utils::readChunk(stream, &codingHistory[0], codingHistory.size());
+    bextChunk->codingHistory(std::move(codingHistory));
+    return bextChunk;
+  }
+
+  /**
+   * @brief Parse BextChunk from input stream, or load it as UnknownChunk if it
+   * is too small to hold the fixed fields
+   *
+   * This is the parser in the default ChunkParserRegistry, so that files with
+   * malformed bext chunks can still be opened.
+   */
+  inline std::shared_ptr<Chunk> parseBextChunkOrUnknown(std::istream& stream,
+                                                        uint32_t id,
+                                                        uint64_t size) {
+    if (size < BextChunk::fixedSize())
+      return std::make_shared<UnknownChunk>(stream, id, size);
+    return parseBextChunk(stream, id, size);
+  }
+
+  ///@brief Parse CueChunk from input stream
+  inline std::shared_ptr<CueChunk> parseCueChunk(std::istream& stream,
+                                                 uint32_t id, uint64_t size) {
+    if (id != utils::fourCC("cue ")) {
+      std::stringstream errorString;
+      errorString << "chunkId != 'cue '";
+      throw std::runtime_error(errorString.str());
+    }
+    if (size < 4) {
+      throw std::runtime_error("illegal cue chunk size");
+    }
+    uint32_t numCuePoints;
+    utils::readValue(stream, numCuePoints);
+    if (numCuePoints > (size - 4) / sizeof(CuePoint)) {
+      std::stringstream errorString;
+      errorString << "cue chunk is too small for " << numCuePoints
+                  << " cue points";
+      throw std::runtime_error(errorString.str());
+    }
+    std::vector<CuePoint> cuePoints(numCuePoints);
+    utils::readChunk(stream, reinterpret_cast<char*>(cuePoints.data()),
+                     cuePoints.size() * sizeof(CuePoint));
+    return std::make_shared<CueChunk>(std::move(cuePoints));
+  }
+
+  /**
+   * @brief Parse CueChunk from input stream, or load it as UnknownChunk if it
+   * is too small for its cue points
+   *
+   * This is the parser in the default ChunkParserRegistry, so that files with
+   * malformed cue chunks can still be opened, without markers.
+   */
+  inline std::shared_ptr<Chunk> parseCueChunkOrUnknown(std::istream& stream,
+                                                       uint32_t id,
+                                                       uint64_t size) {
+    if (size >= 4) {
+      uint32_t numCuePoints;
+      utils::readValue(stream, numCuePoints);
+      stream.seekg(-4, std::ios::cur);
+      if (numCuePoints <= (size - 4) / sizeof(CuePoint))
+        return parseCueChunk(stream, id, size);
+    }
+    return std::make_shared<UnknownChunk>(stream, id, size);
+  }
+
+  /**
+   * @brief Parse LIST chunk from input stream
+   *
+   * @returns AdtlChunk for associated data lists, and UnknownChunk for all
+   * other list types and for chunks too small to hold a list type
+   */
+  inline std::shared_ptr<Chunk> parseListChunk(std::istream& stream,
+                                               uint32_t id, uint64_t size) {
+    if (id != utils::fourCC("LIST")) {
+      std::stringstream errorString;
+      errorString << "chunkId != 'LIST'";
+      throw std::runtime_error(errorString.str());
+    }
+    if (size < 4) return std::make_shared<UnknownChunk>(stream, id, size);
+    uint32_t listType;
+    utils::readValue(stream, listType);
+    if (listType != utils::fourCC("adtl")) {
+      stream.seekg(-4, std::ios::cur);
+      return std::make_shared<UnknownChunk>(stream, id, size);
+    }
+    std::vector<char> subChunks(utils::safeCast<size_t>(size - 4));
+    utils::readChunk(stream, subChunks.data(), subChunks.size());
+    return std::make_shared<AdtlChunk>(std::move(subChunks));
+  }
+
   ///@brief Parse AudioId from input stream
   inline AudioId parseAudioId(std::istream& stream) {
     uint16_t trackIndex;
@@ -240,27 +387,152 @@ namespace bw64 {
     return dataChunk;
   }
 
+  ///@brief Parse UnknownChunk from input stream
+  inline std::shared_ptr<UnknownChunk> parseUnknownChunk(std::istream& stream,
+                                                         uint32_t id,
+                                                         uint64_t size) {
+    return std::make_shared<UnknownChunk>(stream, id, size);
+  }
+
+  /**
+   * @brief Function constructing a chunk from a stream
+   *
+   * The stream is positioned at the start of the chunk payload. The function
+   * may return a nullptr to drop the chunk.
+   */
+  using ChunkParser = std::function<std::shared_ptr<Chunk>(
+      std::istream& stream, uint32_t id, uint64_t size)>;
+
+  /// @brief When a chunk is parsed
+  enum class ChunkParsing {
+    /// when the file is opened
+    eager,
+    /// when the chunk is first accessed; until then it is not read at all
+    lazy
+  };
+
+  /**
+   * @brief Table of parsers for chunk ids
+   *
+   * A default constructed registry contains the parsers for all chunks known
+   * to this library, which are parsed eagerly. All other chunks are eagerly
+   * loaded as UnknownChunk, as are bext and cue chunks which are too small
+   * for their contents (see parseBextChunkOrUnknown() and
+   * parseCueChunkOrUnknown()); register parseBextChunk() or parseCueChunk()
+   * to reject these instead.
+   *
+   * Applications can add parsers for further chunk ids, replace built-in
+   * ones, and choose which chunks are parsed lazily. Lookups use a table
+   * sorted by chunk id.
+   */
+  class ChunkParserRegistry {
+   public:
+    /// @brief Parser and parsing mode of one chunk id
+    struct Entry {
+      ChunkParser parser;
+      ChunkParsing parsing;
+    };
+
+    ChunkParserRegistry()
+        : defaultEntry_{ChunkParser(parseUnknownChunk), ChunkParsing::eager} {
+      add(utils::fourCC("ds64"), parseDataSize64Chunk);
+      add(utils::fourCC("fmt "), parseFormatInfoChunk);
+      add(utils::fourCC("axml"), parseAxmlChunk);
+      add(utils::fourCC("bext"), parseBextChunkOrUnknown);
+      add(utils::fourCC("chna"), parseChnaChunk);
+      add(utils::fourCC("cue "), parseCueChunkOrUnknown);
+      add(utils::fourCC("LIST"), parseListChunk);
+      add(utils::fourCC("data"), parseDataChunk);
+    }
+
+    /// @brief Add or replace the parser for a chunk id
+    void add(uint32_t id, ChunkParser parser,
+             ChunkParsing parsing = ChunkParsing::eager) {
+      auto entry = lowerBound(id);
+      if (entry != entries_.end() && entry->first == id) {
+        entry->second = Entry{std::move(parser), parsing};
+      } else {
+        entries_.insert(entry,
+                        std::make_pair(id, Entry{std::move(parser), parsing}));
+      }
+    }
+
+    /// @brief Change when chunks with an id are parsed
+    ///
+    /// If no parser is registered for the id, the default parser is
+    /// registered for it.
+    void setParsing(uint32_t id, ChunkParsing parsing) {
+      add(id, find(id).parser, parsing);
+    }
+
+    /// @brief Set parser and parsing mode for all chunk ids without an entry
+    void setDefault(ChunkParser parser,
+                    ChunkParsing parsing = ChunkParsing::eager) {
+      defaultEntry_ = Entry{std::move(parser), parsing};
+    }
+
+    /// @brief Set parsing mode for all chunk ids without an entry
+    void setDefaultParsing(ChunkParsing parsing) {
+      defaultEntry_.parsing = parsing;
+    }
+
+    /// @brief Get the entry for a chunk id, or the default entry
+    const Entry& find(uint32_t id) const {
+      auto entry = lowerBound(id);
+      if (entry != entries_.end() && entry->first == id) return entry->second;
+      return defaultEntry_;
+    }
+
+    /// @brief Check if a parser has been added for a chunk id
+    bool has(uint32_t id) const {
+      auto entry = lowerBound(id);
+      return entry != entries_.end() && entry->first == id;
+    }
+
+    /// @brief Parse the chunk described by header from a stream
+    std::shared_ptr<Chunk> parse(std::istream& stream,
+                                 const ChunkHeader& header) const {
+      return parse(stream, header, find(header.id).parser);
+    }
+
+    /// @brief Parse the chunk described by header with a given parser
+    static std::shared_ptr<Chunk> parse(std::istream& stream,
+                                        const ChunkHeader& header,
+                                        const ChunkParser& parser) {
+      stream.clear();
+      stream.seekg(header.position + 8u);
+      if (!stream.good())
+        throw std::runtime_error(
+            "file error while seeking past chunk header chunk");
+      return parser(stream, header.id, header.size);
+    }
+
+   private:
+    using Entries = std::vector<std::pair<uint32_t, Entry>>;
+
+    static bool idLess(const std::pair<uint32_t, Entry>& entry, uint32_t id) {
+      return entry.first < id;
+    }
+    Entries::iterator lowerBound(uint32_t id) {
+      return std::lower_bound(entries_.begin(), entries_.end(), id, idLess);
+    }
+    Entries::const_iterator lowerBound(uint32_t id) const {
+      return std::lower_bound(entries_.begin(), entries_.end(), id, idLess);
+    }
+
+    Entries entries_;
+    Entry defaultEntry_;
+  };
+
+  /// @brief Registry with the parsers of all chunks known to this library
+  inline const ChunkParserRegistry& defaultChunkParserRegistry() {
+    static const ChunkParserRegistry registry;
+    return registry;
+  }
+
   inline std::shared_ptr<Chunk> parseChunk(std::istream& stream,
                                            ChunkHeader header) {
-    stream.clear();
-    stream.seekg(header.position + 8u);
-    if (!stream.good())
-      throw std::runtime_error(
-          "file error while seeking past chunk header chunk");
-
-    if (header.id == utils::fourCC("ds64")) {
-      return parseDataSize64Chunk(stream, header.id, header.size);
-    } else if (header.id == utils::fourCC("fmt ")) {
-      return parseFormatInfoChunk(stream, header.id, header.size);
-    } else if (header.id == utils::fourCC("axml")) {
-      return parseAxmlChunk(stream, header.id, header.size);
-    } else if (header.id == utils::fourCC("chna")) {
-      return parseChnaChunk(stream, header.id, header.size);
-    } else if (header.id == utils::fourCC("data")) {
-      return parseDataChunk(stream, header.id, header.size);
-    } else {
-      return std::make_shared<UnknownChunk>(stream, header.id, header.size);
-    }
+    return defaultChunkParserRegistry().parse(stream, header);
   }
 
 }  // namespace bw64
@@ -0,0 +1,675 @@
+/**
+ * @file pipeline.hpp
+ *
+ * Pull-based block processing pipelines built from a Bw64Reader, processing
+ * stages and a Bw64Writer.
+ */
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+#include "reader.hpp"
+#include "utils.hpp"
+#include "writer.hpp"
+
+namespace bw64 {
+
+  class BlockPool;
+
+  /**
+   * @brief Buffer of interleaved float frames, owned by a BlockPool
+   *
+   * A block can hold up to `BlockPool::blockFrames()` frames with up to
+   * `BlockPool::maxChannels()` channels.
+   */
+  class Block {
+   public:
+    Block(const Block&) = delete;
+    Block& operator=(const Block&) = delete;
+
+    /// @brief Get the interleaved samples
+    float* data() { return data_.data(); }
+    const float* data() const { return data_.data(); }
+    /// @brief Get number of channels
+    uint16_t channels() const { return channels_; }
+    /// @brief Get number of valid frames
+    uint64_t frames() const { return frames_; }
+    /// @brief Get maximum number of frames with the current channel count
+    uint64_t frameCapacity() const {
+      return channels_ ? data_.size() / channels_ : 0u;
+    }
+
+    /// @brief Set the channel count and number of valid frames
+    void resize(uint16_t channels, uint64_t frames) {
+      if (static_cast<uint64_t>(channels) * frames > data_.size()) {
+        std::stringstream errorString;
+        errorString << "block can not hold " << frames << " frames with "
+                    << channels << " channels";
+        throw std::runtime_error(errorString.str());
+      }
+      channels_ = channels;
+      frames_ = frames;
+    }
+
+   private:
+    friend class BlockPool;
+    explicit Block(size_t samples) : data_(samples) {}
+
+    std::vector<float> data_;
+    uint16_t channels_{0};
+    uint64_t frames_{0};
+  };
+
+  /// @brief Returns a Block to its BlockPool when it is released
+  struct BlockReturner {
+    BlockPool* pool;
+    void operator()(Block* block) const;
+  };
+
+  /**
+   * @brief Owning pointer to a Block from a BlockPool
+   *
+   * Blocks are passed between stages by moving these pointers; the block is
+   * returned to the pool when the pointer is destroyed.
+   */
+  using BlockPtr = std::unique_ptr<Block, BlockReturner>;
+
+  /**
+   * @brief Fixed set of equally sized blocks
+   *
+   * All blocks are allocated up front. acquire() waits until a block is
+   * returned if all are in use, which also limits how far threaded stages
+   * can run ahead. The pool must outlive all blocks acquired from it.
+   *
+   * A pipeline whose stages all use one pool needs at least
+   * `last.poolBlocks()` blocks, where `last` is its last stage (see
+   * BlockSource::poolBlocks()); more blocks let threaded stages run further
+   * ahead. Stages which hold a block while acquiring another one check this
+   * when they are constructed, as the pipeline could otherwise wait forever.
+   */
+  class BlockPool {
+   public:
+    /**
+     * @brief Allocate a pool
+     *
+     * @param blockFrames number of frames per block
+     * @param maxChannels maximum number of channels of a block
+     * @param blocks number of blocks
+     */
+    BlockPool(uint64_t blockFrames, uint16_t maxChannels, size_t blocks)
+        : blockFrames_(blockFrames), maxChannels_(maxChannels) {
+      if (blockFrames == 0 || maxChannels == 0 || blocks == 0)
+        throw std::runtime_error(
+            "blockFrames, maxChannels and blocks must be > 0");
+      const size_t samples =
+          utils::safeCast<size_t>(blockFrames * maxChannels);
+      for (size_t i = 0; i < blocks; ++i) {
+        blocks_.emplace_back(new Block(samples));
+        free_.push_back(blocks_.back().get());
+      }
+    }
+
+    BlockPool(const BlockPool&) = delete;
+    BlockPool& operator=(const BlockPool&) = delete;
+
+    /// @brief Get number of frames per block
+    uint64_t blockFrames() const { return blockFrames_; }
+    /// @brief Get maximum number of channels of a block
+    uint16_t maxChannels() const { return maxChannels_; }
+    /// @brief Get total number of blocks
+    size_t size() const { return blocks_.size(); }
+    /// @brief Get number of blocks not in use
+    size_t available() const {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return free_.size();
+    }
+
+    /// @brief Take a block, waiting until one is free
+    ///
+    /// The block is resized to `channels` channels and blockFrames() frames.
+    BlockPtr acquire(uint16_t channels) {
+      if (channels > maxChannels_) {
+        std::stringstream errorString;
+        errorString << "blocks of this pool can not hold " << channels
+                    << " channels";
+        throw std::runtime_error(errorString.str());
+      }
+      std::unique_lock<std::mutex> lock(mutex_);
+      returned_.wait(lock, [this]() { return !free_.empty(); });
+      Block* block = free_.back();
+      free_.pop_back();
+      lock.unlock();
+      block->resize(channels, blockFrames_);
+      return BlockPtr(block, BlockReturner{this});
+    }
+
+   private:
+    friend struct BlockReturner;
+
+    void release(Block* block) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.push_back(block);
+      }
+      returned_.notify_one();
+    }
+
+    uint64_t blockFrames_;
+    uint16_t maxChannels_;
+    std::vector<std::unique_ptr<Block>> blocks_;
+    mutable std::mutex mutex_;
+    std::condition_variable returned_;
+    std::vector<Block*> free_;
+  };
+
+  inline void BlockReturner::operator()(Block* block) const {
+    pool->release(block);
+  }
+
+  /**
+   * @brief Stage producing blocks
+   *
+   * Sources and the transforms built on them are pulled from downstream:
+   * each pull() returns the next block, or a nullptr at the end of the
+   * stream. Stages refer to their upstream stage, which must outlive them.
+   */
+  class BlockSource {
+   public:
+    virtual ~BlockSource() = default;
+
+    /// @brief Get number of channels of the produced blocks
+    virtual uint16_t channels() const = 0;
+    /// @brief Get sample rate of the stream
+    virtual uint32_t sampleRate() const = 0;
+    /// @brief Get the next block, or nullptr at the end of the stream
+    virtual BlockPtr pull() = 0;
+
+    /**
+     * @brief Get the number of blocks held at once by this stage
+     *
+     * This is the largest number of blocks which this stage and the stages
+     * upstream of it may hold at the same time, including the block returned
+     * by pull(), if they all use the same pool. Sources which acquire one
+     * block for each pull() hold 1.
+     */
+    virtual size_t poolBlocks() const { return 1; }
+  };
+
+  /// throw if `pool` can not hold the blocks needed by a stage
+  inline void checkPoolBlocks(const BlockPool& pool, size_t blocks) {
+    if (pool.size() < blocks) {
+      std::stringstream errorString;
+      errorString << "block pool of " << pool.size()
+                  << " blocks is too small; the pipeline needs " << blocks;
+      throw std::runtime_error(errorString.str());
+    }
+  }
+
+  /**
+   * @brief Stage consuming blocks
+   */
+  class BlockSink {
+   public:
+    virtual ~BlockSink() = default;
+
+    /// @brief Consume a block
+    virtual void push(BlockPtr block) = 0;
+    /// @brief Called once after the last block
+    virtual void finish() {}
+  };
+
+  /**
+   * @brief Base of stages transforming the blocks of an upstream stage
+   *
+   * Derived classes implement process(), which may modify the block in
+   * place or return a different one.
+   */
+  class BlockTransform : public BlockSource {
+   public:
+    explicit BlockTransform(BlockSource& upstream) : upstream_(upstream) {}
+
+    uint16_t channels() const override { return upstream_.channels(); }
+    uint32_t sampleRate() const override { return upstream_.sampleRate(); }
+    /// in-place transforms hold only the blocks of their upstream stages
+    size_t poolBlocks() const override { return upstream_.poolBlocks(); }
+
+    BlockPtr pull() override {
+      BlockPtr block = upstream_.pull();
+      if (!block) return block;
+      return process(std::move(block));
+    }
+
+   protected:
+    virtual BlockPtr process(BlockPtr block) = 0;
+
+    BlockSource& upstream_;
+  };
+
+  /**
+   * @brief Source reading decoded frames from a Bw64Reader
+   *
+   * Reads from the current position of the reader until its end.
+   */
+  class ReaderSource : public BlockSource {
+   public:
+    ReaderSource(Bw64Reader& reader, BlockPool& pool)
+        : reader_(reader), pool_(pool) {}
+
+    uint16_t channels() const override { return reader_.channels(); }
+    uint32_t sampleRate() const override { return reader_.sampleRate(); }
+
+    BlockPtr pull() override {
+      if (reader_.eof()) return nullptr;
+      BlockPtr block = pool_.acquire(channels());
+      const uint64_t frames = reader_.read(block->data(), block->frames());
+      if (frames == 0) return nullptr;
+      block->resize(channels(), frames);
+      return block;
+    }
+
+   private:
+    Bw64Reader& reader_;
+    BlockPool& pool_;
+  };
+
+  /**
+   * @brief Sink writing blocks to a Bw64Writer
+   *
+   * The writer must have the same number of channels as the blocks.
+   */
+  class WriterSink : public BlockSink {
+   public:
+    explicit WriterSink(Bw64Writer& writer) : writer_(writer) {}
+
+    void push(BlockPtr block) override {
+      if (block->channels() != writer_.channels()) {
+        std::stringstream errorString;
+        errorString << "can not write block with " << block->channels()
+                    << " channels to file with " << writer_.channels()
+                    << " channels";
+        throw std::runtime_error(errorString.str());
+      }
+      writer_.write(block->data(), block->frames());
+    }
+
+   private:
+    Bw64Writer& writer_;
+  };
+
+  /**
+   * @brief Apply a function to every block in place
+   */
+  class ProcessBlock : public BlockTransform {
+   public:
+    ProcessBlock(BlockSource& upstream, std::function<void(Block&)> function)
+        : BlockTransform(upstream), function_(std::move(function)) {}
+
+   protected:
+    BlockPtr process(BlockPtr block) override {
+      function_(*block);
+      return block;
+    }
+
+   private:
+    std::function<void(Block&)> function_;
+  };
+
+  /**
+   * @brief Convert samples to the resolution and range of a PCM bit depth
+   *
+   * Samples are clipped to [-1, 1) and rounded to the nearest value which
+   * can be stored with `bitDepth` bits, i.e. exactly what writing and
+   * reading a file with that bit depth would do.
+   */
+  class ConvertBitDepth : public BlockTransform {
+   public:
+    ConvertBitDepth(BlockSource& upstream, uint16_t bitDepth)
+        : BlockTransform(upstream), bitDepth_(bitDepth) {
+      if (bitDepth != 16 && bitDepth != 24 && bitDepth != 32) {
+        std::stringstream errorString;
+        errorString << "unsupported bit depth: " << bitDepth;
+        throw std::runtime_error(errorString.str());
+      }
+    }
+
+   protected:
+    BlockPtr process(BlockPtr block) override {
+      const uint64_t samples = block->frames() * block->channels();
+      encoded_.resize(utils::safeCast<size_t>(samples * (bitDepth_ / 8)));
+      utils::encodePcmSamples(block->data(), encoded_.data(), samples,
+                              bitDepth_);
+      utils::decodePcmSamples(encoded_.data(), block->data(), samples,
+                              bitDepth_);
+      return block;
+    }
+
+   private:
+    uint16_t bitDepth_;
+    std::vector<char> encoded_;
+  };
+
+  /**
+   * @brief Select and reorder channels
+   *
+   * Output channel `i` is input channel `channels[i]`; channels can be
+   * repeated. If there are no more output than input channels, blocks are
+   * rearranged in place; otherwise a new block is taken from `pool` while
+   * holding the input block, so `pool` needs one block more than upstream
+   * (see BlockSource::poolBlocks()).
+   */
+  class ChannelSelect : public BlockTransform {
+   public:
+    ChannelSelect(BlockSource& upstream, std::vector<uint16_t> channels,
+                  BlockPool& pool)
+        : BlockTransform(upstream),
+          channels_(std::move(channels)),
+          pool_(pool),
+          frame_(channels_.size()) {
+      if (channels_.empty())
+        throw std::runtime_error("at least one channel must be selected");
+      if (channels_.size() > pool_.maxChannels())
+        throw std::runtime_error("too many channels for block pool");
+      for (uint16_t channel : channels_) {
+        if (channel >= upstream.channels()) {
+          std::stringstream errorString;
+          errorString << "channel " << channel << " out of range; upstream has "
+                      << upstream.channels() << " channels";
+          throw std::runtime_error(errorString.str());
+        }
+      }
+      checkPoolBlocks(pool_, poolBlocks());
+    }
+
+    uint16_t channels() const override {
+      return static_cast<uint16_t>(channels_.size());
+    }
+    size_t poolBlocks() const override {
+      return upstream_.poolBlocks() +
+             (channels() > upstream_.channels() ? 1u : 0u);
+    }
+
+   protected:
+    BlockPtr process(BlockPtr block) override {
+      const uint16_t in = block->channels();
+      const uint16_t out = channels();
+      const uint64_t frames = block->frames();
+      if (out > in) {
+        BlockPtr output = pool_.acquire(out);
+        output->resize(out, frames);
+        for (uint64_t f = 0; f < frames; ++f)
+          for (uint16_t c = 0; c < out; ++c)
+            output->data()[f * out + c] = block->data()[f * in + channels_[c]];
+        return output;
+      }
+      // compacting in place is safe, as frame f is written at or before
+      // where it is read from
+      float* data = block->data();
+      for (uint64_t f = 0; f < frames; ++f) {
+        for (uint16_t c = 0; c < out; ++c)
+          frame_[c] = data[f * in + channels_[c]];
+        std::copy(frame_.begin(), frame_.end(), data + f * out);
+      }
+      block->resize(out, frames);
+      return block;
+    }
+
+   private:
+    std::vector<uint16_t> channels_;
+    BlockPool& pool_;
+    std::vector<float> frame_;
+  };
+
+  /**
+   * @brief Mix channels with a matrix, e.g. to downmix
+   *
+   * Output channel `o` is the sum of the input channels `i` weighted by
+   * `matrix[o * upstream.channels() + i]`. Only the non-zero weights are
+   * applied. Like ChannelSelect, blocks are mixed in place unless there are
+   * more output than input channels, in which case `pool` needs one block
+   * more than upstream.
+   */
+  class MatrixMix : public BlockTransform {
+   public:
+    MatrixMix(BlockSource& upstream, uint16_t channels,
+              const std::vector<float>& matrix, BlockPool& pool)
+        : BlockTransform(upstream),
+          channels_(channels),
+          pool_(pool),
+          terms_(channels),
+          frame_(channels) {
+      if (channels == 0)
+        throw std::runtime_error("at least one channel must be mixed");
+      if (channels > pool_.maxChannels())
+        throw std::runtime_error("too many channels for block pool");
+      const uint16_t in = upstream.channels();
+      if (matrix.size() != static_cast<size_t>(channels) * in) {
+        std::stringstream errorString;
+        errorString << "mix matrix must have " << channels << " x " << in
+                    << " weights, got " << matrix.size();
+        throw std::runtime_error(errorString.str());
+      }
+      for (uint16_t o = 0; o < channels; ++o)
+        for (uint16_t i = 0; i < in; ++i)
+          if (matrix[o * in + i] != 0.f)
+            terms_[o].push_back(Term{i, matrix[o * in + i]});
+      checkPoolBlocks(pool_, poolBlocks());
+    }
+
+    uint16_t channels() const override { return channels_; }
+    size_t poolBlocks() const override {
+      return upstream_.poolBlocks() +
+             (channels_ > upstream_.channels() ? 1u : 0u);
+    }
+
+   protected:
+    BlockPtr process(BlockPtr block) override {
+      const uint16_t in = block->channels();
+      const uint16_t out = channels_;
+      const uint64_t frames = block->frames();
+      BlockPtr output;
+      if (out > in) {
+        output = pool_.acquire(out);
+        output->resize(out, frames);
+      }
+      // as for ChannelSelect, mixing in place is safe when out <= in
+      const float* inData = block->data();
+      float* outData = output ? output->data() : block->data();
+      for (uint64_t f = 0; f < frames; ++f) {
+        const float* x = inData + f * in;
+        for (uint16_t o = 0; o < out; ++o) {
+          float sum = 0.f;
+          for (const Term& term : terms_[o]) sum += term.weight * x[term.input];
+          frame_[o] = sum;
+        }
+        std::copy(frame_.begin(), frame_.end(), outData + f * out);
+      }
+      if (output) return output;
+      block->resize(out, frames);
+      return block;
+    }
+
+   private:
+    struct Term {
+      uint16_t input;
+      float weight;
+    };
+
+    uint16_t channels_;
+    BlockPool& pool_;
+    std::vector<std::vector<Term>> terms_;
+    std::vector<float> frame_;
+  };
+
+  /**
+   * @brief Pass blocks through unchanged while measuring peak and RMS level
+   * of every channel
+   */
+  class Meter : public BlockTransform {
+   public:
+    explicit Meter(BlockSource& upstream)
+        : BlockTransform(upstream),
+          peak_(upstream.channels(), 0.f),
+          sumOfSquares_(upstream.channels(), 0.0) {}
+
+    /// @brief Get number of frames measured
+    uint64_t frames() const { return frames_; }
+    /// @brief Get the largest absolute sample value of a channel
+    float peak(uint16_t channel) const { return peak_.at(channel); }
+    /// @brief Get the root mean square of the samples of a channel
+    double rms(uint16_t channel) const {
+      if (frames_ == 0) return 0.0;
+      return std::sqrt(sumOfSquares_.at(channel) / frames_);
+    }
+    /// @brief Reset all measurements
+    void reset() {
+      std::fill(peak_.begin(), peak_.end(), 0.f);
+      std::fill(sumOfSquares_.begin(), sumOfSquares_.end(), 0.0);
+      frames_ = 0;
+    }
+
+   protected:
+    BlockPtr process(BlockPtr block) override {
+      const uint16_t channels = block->channels();
+      const float* data = block->data();
+      for (uint64_t f = 0; f < block->frames(); ++f) {
+        for (uint16_t c = 0; c < channels; ++c) {
+          const float sample = data[f * channels + c];
+          peak_[c] = std::max(peak_[c], std::abs(sample));
+          sumOfSquares_[c] += static_cast<double>(sample) * sample;
+        }
+      }
+      frames_ += block->frames();
+      return block;
+    }
+
+   private:
+    std::vector<float> peak_;
+    std::vector<double> sumOfSquares_;
+    uint64_t frames_{0};
+  };
+
+  /**
+   * @brief Run the upstream stages on their own thread
+   *
+   * A background thread pulls blocks from the upstream stage into a queue of
+   * at most `queueSize` blocks, from which pull() takes them. Exceptions
+   * thrown upstream are rethrown by pull() once the blocks produced before
+   * them have been taken.
+   *
+   * The upstream stages are only used by the background thread, so they can
+   * run concurrently with the stages downstream of this one. While the
+   * block returned by pull() is in use, the queue holds up to `queueSize -
+   * 1` further blocks, and the upstream stages their own blocks, so
+   * poolBlocks() is `queueSize + upstream.poolBlocks()`.
+   *
+   * All blocks pulled from this stage must have been released before it is
+   * destroyed: the background thread may be waiting for a block of the
+   * pool, and is only stopped once it has one.
+   */
+  class ThreadedStage : public BlockSource {
+   public:
+    ThreadedStage(BlockSource& upstream, size_t queueSize)
+        : upstream_(upstream), queueSize_(queueSize) {
+      if (queueSize == 0) throw std::runtime_error("queueSize must be > 0");
+      thread_ = std::thread(&ThreadedStage::run, this);
+    }
+
+    ThreadedStage(const ThreadedStage&) = delete;
+    ThreadedStage& operator=(const ThreadedStage&) = delete;
+
+    /// stop the thread; queued blocks are returned to their pool
+    ~ThreadedStage() {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        queue_.clear();
+      }
+      changed_.notify_all();
+      thread_.join();
+    }
+
+    uint16_t channels() const override { return upstream_.channels(); }
+    uint32_t sampleRate() const override { return upstream_.sampleRate(); }
+    size_t poolBlocks() const override {
+      return queueSize_ + upstream_.poolBlocks();
+    }
+
+    BlockPtr pull() override {
+      std::unique_lock<std::mutex> lock(mutex_);
+      changed_.wait(lock, [this]() { return !queue_.empty() || done_; });
+      if (queue_.empty()) {
+        if (error_) std::rethrow_exception(error_);
+        return nullptr;
+      }
+      BlockPtr block = std::move(queue_.front());
+      queue_.pop_front();
+      lock.unlock();
+      changed_.notify_all();
+      return block;
+    }
+
+   private:
+    void run() {
+      try {
+        while (true) {
+          {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [this]() {
+              return stop_ || queue_.size() < queueSize_;
+            });
+            if (stop_) break;
+          }
+          BlockPtr block = upstream_.pull();
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (!block || stop_) break;
+          queue_.push_back(std::move(block));
+          changed_.notify_all();
+        }
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        error_ = std::current_exception();
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_ = true;
+      }
+      changed_.notify_all();
+    }
+
+    BlockSource& upstream_;
+    size_t queueSize_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::deque<BlockPtr> queue_;
+    bool stop_{false};
+    bool done_{false};
+    std::exception_ptr error_;
+    std::thread thread_;
+  };
+
+  /**
+   * @brief Pull all blocks from a source and push them into a sink
+   *
+   * @returns number of frames passed to the sink
+   */
+  inline uint64_t runPipeline(BlockSource& source, BlockSink& sink) {
+    uint64_t frames = 0;
+    while (BlockPtr block = source.pull()) {
+      frames += block->frames();
+      sink.push(std::move(block));
+    }
+    sink.finish();
+    return frames;
+  }
+
+}  // namespace bw64
@@ -0,0 +1,281 @@
+/**
+ * @file preload.hpp
+ *
+ * Bulk preloading of the first frames of many files for instant-start
+ * playback.
+ */
+#pragma once
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "reader.hpp"
+#include "thread_pool.hpp"
+
+namespace bw64 {
+
+  /// @brief Storage format of preloaded frames
+  enum class PreloadFormat {
+    /// keep the PCM samples as stored in the file; decoded on read
+    raw,
+    /// store decoded float samples
+    decoded
+  };
+
+  /**
+   * @brief Information about one file in a PreloadCache
+   */
+  struct PreloadEntry {
+    std::string filename;
+    uint16_t channels = 0;
+    uint32_t sampleRate = 0;
+    uint16_t bitDepth = 0;
+    /// number of frames in the file
+    uint64_t numberOfFrames = 0;
+    /// number of frames held in the cache
+    uint64_t preloadedFrames = 0;
+    /// start of the preloaded frames in the arena
+    const char* data = nullptr;
+  };
+
+  class PreloadCache;
+
+  /**
+   * @brief Read cursor which starts in a PreloadCache and continues from the
+   * file
+   *
+   * The preloaded frames are served from memory. Once they run out, reading
+   * continues seamlessly from a Bw64Reader positioned behind the preloaded
+   * frames. The reader is opened by openReader(), or on the first read which
+   * needs it; call openReader() ahead of time from a non real-time thread to
+   * keep file access off the audio thread.
+   */
+  class PreloadCursor {
+   public:
+    PreloadCursor(const PreloadEntry& entry, PreloadFormat format)
+        : entry_(&entry), format_(format), position_(0) {}
+
+    /// @brief Get number of channels
+    uint16_t channels() const { return entry_->channels; }
+    /// @brief Get sample rate
+    uint32_t sampleRate() const { return entry_->sampleRate; }
+    /// @brief Get number of frames
+    uint64_t numberOfFrames() const { return entry_->numberOfFrames; }
+    /// @brief Tell the current frame position
+    uint64_t tell() const { return position_; }
+    /// @brief Check if end of data is reached
+    bool eof() const { return position_ == numberOfFrames(); }
+    /// @brief Check if the cursor is still served from memory
+    bool inPreload() const { return position_ < entry_->preloadedFrames; }
+
+    /// @brief Open the file for reading behind the preloaded frames
+    void openReader() {
+      if (reader_ || entry_->preloadedFrames == entry_->numberOfFrames) return;
+      reader_.reset(new Bw64Reader(entry_->filename.c_str()));
+      if (reader_->numberOfFrames() != entry_->numberOfFrames ||
+          reader_->channels() != entry_->channels ||
+          reader_->bitDepth() != entry_->bitDepth) {
+        reader_.reset();
+        throw std::runtime_error("file '" + entry_->filename +
+                                 "' changed since it was preloaded");
+      }
+      reader_->seek(utils::safeCast<int64_t>(entry_->preloadedFrames));
+    }
+
+    /**
+     * @brief Read frames, first from the cache and then from the file
+     *
+     * @param[out] outBuffer Buffer to write the samples to
+     * @param[in]  frames    Number of frames to read
+     *
+     * @returns number of frames read
+     */
+    template <typename T, typename std::enable_if<
+                              std::is_floating_point<T>::value, int>::type = 0>
+    uint64_t read(T* outBuffer, uint64_t frames) {
+      uint64_t done = 0;
+      if (inPreload()) {
+        done = std::min(frames, entry_->preloadedFrames - position_);
+        const uint64_t first = position_ * channels();
+        const uint64_t samples = done * channels();
+        if (format_ == PreloadFormat::decoded) {
+          const float* data = reinterpret_cast<const float*>(entry_->data);
+          std::copy(data + first, data + first + samples, outBuffer);
+        } else {
+          const char* data = entry_->data + first * (entry_->bitDepth / 8);
+          utils::decodePcmSamples(data, outBuffer, samples, entry_->bitDepth);
+        }
+        position_ += done;
+      }
+      if (done < frames && !eof()) {
+        openReader();
+        const uint64_t n =
+            reader_->read(outBuffer + done * channels(), frames - done);
+        position_ += n;
+        done += n;
+      }
+      return done;
+    }
+
+   private:
+    const PreloadEntry* entry_;
+    PreloadFormat format_;
+    uint64_t position_;
+    std::unique_ptr<Bw64Reader> reader_;
+  };
+
+  /**
+   * @brief Cache of the first frames of many files
+   *
+   * Files are opened and their first `preloadFrames` frames read in parallel.
+   * The frames of all files are stored back to back in a few large arena
+   * blocks rather than in one allocation per file.
+   */
+  class PreloadCache {
+   public:
+    /**
+     * @brief Create an empty PreloadCache
+     *
+     * @param preloadFrames number of frames to preload of every file
+     * @param format whether to store the frames as in the file or decoded
+     * @param arenaBlockSize size of the memory blocks of the arena in bytes
+     */
+    PreloadCache(uint64_t preloadFrames,
+                 PreloadFormat format = PreloadFormat::raw,
+                 size_t arenaBlockSize = 64u << 20)
+        : preloadFrames_(preloadFrames),
+          format_(format),
+          arenaBlockSize_(arenaBlockSize),
+          blockSize_(0),
+          blockUsed_(0),
+          arenaUsed_(0),
+          arenaSize_(0) {}
+
+    PreloadCache(const PreloadCache&) = delete;
+    PreloadCache& operator=(const PreloadCache&) = delete;
+
+    /// @brief Get number of frames preloaded per file
+    uint64_t preloadFrames() const { return preloadFrames_; }
+    /// @brief Get storage format
+    PreloadFormat format() const { return format_; }
+    /// @brief Get number of files in the cache
+    size_t size() const { return entries_.size(); }
+    /// @brief Get the entry of one file
+    const PreloadEntry& entry(size_t index) const {
+      return *entries_.at(index);
+    }
+    /// @brief Get number of arena bytes holding preloaded frames
+    size_t memoryUsed() const { return arenaUsed_; }
+    /// @brief Get number of bytes allocated for the arena
+    size_t memoryReserved() const { return arenaSize_; }
+
+    /**
+     * @brief Preload files in parallel
+     *
+     * The files are appended to the cache in the given order, so the first
+     * file gets the index `size()` before the call.
+     *
+     * If any file can not be loaded, the first error is thrown once all files
+     * have been processed, and none of the files are added; the arena memory
+     * taken by the files of the call is given back.
+     *
+     * @param filenames paths of the files to preload
+     * @param threads number of threads to read the files with
+     */
+    void load(const std::vector<std::string>& filenames, size_t threads = 8) {
+      std::vector<std::unique_ptr<PreloadEntry>> entries(filenames.size());
+      const size_t blocks = arena_.size();
+      const size_t blockSize = blockSize_;
+      const size_t blockUsed = blockUsed_;
+      const size_t arenaUsed = arenaUsed_;
+      const size_t arenaSize = arenaSize_;
+      try {
+        ThreadPool pool(std::min(threads, filenames.size()));
+        std::vector<std::future<void>> results;
+        for (size_t i = 0; i < filenames.size(); ++i) {
+          results.push_back(pool.submit([this, &filenames, &entries, i]() {
+            entries[i] = loadFile(filenames[i]);
+          }));
+        }
+        for (auto& result : results) result.get();
+      } catch (...) {
+        // the pool has finished with all files; allocations are only made
+        // by load(), so everything after the saved state belongs to them
+        arena_.resize(blocks);
+        blockSize_ = blockSize;
+        blockUsed_ = blockUsed;
+        arenaUsed_ = arenaUsed;
+        arenaSize_ = arenaSize;
+        throw;
+      }
+      for (auto& entry : entries) entries_.push_back(std::move(entry));
+    }
+
+    /// @brief Create a cursor to read one file from its first frame
+    PreloadCursor cursor(size_t index) const {
+      return PreloadCursor(entry(index), format_);
+    }
+
+   private:
+    std::unique_ptr<PreloadEntry> loadFile(const std::string& filename) {
+      Bw64Reader reader(filename.c_str());
+      std::unique_ptr<PreloadEntry> entry(new PreloadEntry);
+      entry->filename = filename;
+      entry->channels = reader.channels();
+      entry->sampleRate = reader.sampleRate();
+      entry->bitDepth = reader.bitDepth();
+      entry->numberOfFrames = reader.numberOfFrames();
+      entry->preloadedFrames =
+          std::min(preloadFrames_, reader.numberOfFrames());
+
+      const uint64_t sampleSize = format_ == PreloadFormat::decoded
+                                      ? sizeof(float)
+                                      : reader.bitDepth() / 8u;
+      char* data = allocate(utils::safeCast<size_t>(
+          entry->preloadedFrames * reader.channels() * sampleSize));
+      if (format_ == PreloadFormat::decoded) {
+        reader.read(reinterpret_cast<float*>(data), entry->preloadedFrames);
+      } else {
+        reader.readRaw(data, entry->preloadedFrames);
+      }
+      entry->data = data;
+      reader.close();
+      return entry;
+    }
+
+    /// bump allocation from the arena; blocks never move, so pointers stay
+    /// valid for the lifetime of the cache
+    char* allocate(size_t size) {
+      const size_t alignment = alignof(float);
+      std::lock_guard<std::mutex> lock(arenaMutex_);
+      size_t offset = (blockUsed_ + alignment - 1) / alignment * alignment;
+      if (arena_.empty() || offset + size > blockSize_) {
+        blockSize_ = std::max(size, arenaBlockSize_);
+        arena_.emplace_back(new char[blockSize_]);
+        arenaSize_ += blockSize_;
+        offset = 0;
+      }
+      blockUsed_ = offset + size;
+      arenaUsed_ += size;
+      return arena_.back().get() + offset;
+    }
+
+    uint64_t preloadFrames_;
+    PreloadFormat format_;
+    size_t arenaBlockSize_;
+    std::vector<std::unique_ptr<PreloadEntry>> entries_;
+
+    std::mutex arenaMutex_;
+    std::vector<std::unique_ptr<char[]>> arena_;
+    size_t blockSize_;
+    size_t blockUsed_;
+    size_t arenaUsed_;
+    size_t arenaSize_;
+  };
+
+}  // namespace bw64
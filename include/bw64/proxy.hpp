@@ -0,0 +1,164 @@
+/**
+ * @file proxy.hpp
+ *
+ * Generation of proxy files: downmixed, resampled and requantised copies of
+ * a file, e.g. for previews.
+ */
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "bw64.hpp"
+#include "pipeline.hpp"
+#include "resampler.hpp"
+
+namespace bw64 {
+
+  /**
+   * @brief Options for writeProxy()
+   */
+  struct ProxyOptions {
+    /// number of channels of the proxy
+    uint16_t channels = 2;
+    /// sample rate of the proxy; 0 to keep the sample rate
+    uint32_t sampleRate = 24000;
+    /// bit depth of the proxy
+    uint16_t bitDepth = 16;
+    /// `channels` x input channels mix matrix, row by row; empty to use
+    /// defaultMixMatrix()
+    std::vector<float> mixMatrix;
+    /// filter length of the resampler; see Resampler
+    unsigned zeroCrossings = 16;
+    /// number of frames processed at a time
+    uint64_t blockFrames = 8192;
+    /// number of blocks queued between the threads
+    size_t queueBlocks = 4;
+    /// copy the axml chunk, unless none of the chna entries of the input
+    /// are copied
+    bool copyAxml = true;
+    /// copy the chna entries of channels which are copied unchanged
+    bool copyChna = true;
+  };
+
+  /**
+   * @brief Get a default mix matrix from `in` to `out` channels
+   *
+   * - if `in == out`, every channel is copied
+   * - 5.1 (L, R, C, LFE, Ls, Rs) to stereo mixes C, Ls and Rs at -3 dB into
+   *   L and R, as in ITU-R BS.775, and drops the LFE
+   * - to mono, all channels are averaged
+   * - otherwise, input channel `i` goes to output channel `i % out`, and
+   *   every output channel is divided by the number of inputs mixed into it
+   *
+   * @returns `out` x `in` weights, row by row
+   */
+  inline std::vector<float> defaultMixMatrix(uint16_t in, uint16_t out) {
+    if (in == 0 || out == 0)
+      throw std::runtime_error("channel counts must be > 0");
+    std::vector<float> matrix(static_cast<size_t>(out) * in, 0.f);
+    auto weight = [&matrix, in](uint16_t o, uint16_t i) -> float& {
+      return matrix[static_cast<size_t>(o) * in + i];
+    };
+    if (in == 6 && out == 2) {
+      const float minus3dB = static_cast<float>(1.0 / std::sqrt(2.0));
+      for (uint16_t o = 0; o < 2; ++o) {
+        weight(o, o) = 1.f;
+        weight(o, 2) = minus3dB;
+        weight(o, static_cast<uint16_t>(4 + o)) = minus3dB;
+      }
+      return matrix;
+    }
+    std::vector<int> inputs(out, 0);
+    for (uint16_t i = 0; i < in; ++i) ++inputs[i % out];
+    for (uint16_t i = 0; i < in; ++i)
+      weight(i % out, i) = 1.f / static_cast<float>(inputs[i % out]);
+    return matrix;
+  }
+
+  /**
+   * @brief Write a proxy of a file
+   *
+   * The file is decoded, mixed, resampled and encoded at the bit depth of
+   * the proxy in a single pass over blocks of `options.blockFrames` frames.
+   * Reading, decoding and mixing run on one thread, resampling on another,
+   * and encoding and writing on the calling thread, connected by queues of
+   * `options.queueBlocks` blocks. Mixing comes first, so that only the proxy
+   * channels are resampled.
+   *
+   * Samples are clipped and rounded to the proxy bit depth when encoding.
+   *
+   * As the track indices of the chna chunk refer to channels of the input,
+   * only the entries of input channels which are copied unchanged to a
+   * proxy channel (a mix matrix row with a single weight of 1) are kept,
+   * with the index of the proxy channel. The axml chunk is copied unchanged
+   * if some of these entries are kept, or if the input has no chna entries;
+   * otherwise it would describe tracks which the proxy does not have, so it
+   * is dropped. This is the case for the default downmixes.
+   *
+   * @returns number of frames written to the proxy
+   */
+  inline uint64_t writeProxy(const std::string& inputFilename,
+                             const std::string& proxyFilename,
+                             const ProxyOptions& options = ProxyOptions()) {
+    auto reader = readFile(inputFilename);
+    const uint16_t in = reader->channels();
+    const uint16_t out = options.channels;
+    const std::vector<float> matrix = options.mixMatrix.empty()
+                                          ? defaultMixMatrix(in, out)
+                                          : options.mixMatrix;
+    const uint32_t sampleRate =
+        options.sampleRate ? options.sampleRate : reader->sampleRate();
+
+    std::shared_ptr<ChnaChunk> chna;
+    auto inputChna = reader->chnaChunk();
+    if (options.copyChna && inputChna && matrix.size() == size_t{out} * in) {
+      for (uint16_t o = 0; o < out; ++o) {
+        const auto row = matrix.begin() + static_cast<size_t>(o) * in;
+        if (std::count(row, row + in, 0.f) != in - 1) continue;
+        const auto one = std::find(row, row + in, 1.f);
+        if (one == row + in) continue;
+        const uint16_t input = static_cast<uint16_t>(one - row);
+        for (const AudioId& id : inputChna->audioIds()) {
+          if (id.trackIndex() != input + 1) continue;
+          if (!chna) chna = std::make_shared<ChnaChunk>();
+          chna->addAudioId(AudioId(static_cast<uint16_t>(o + 1), id.uid(),
+                                   id.trackRef(), id.packRef()));
+        }
+      }
+    }
+    const bool inputHasTracks = inputChna && inputChna->numUids() > 0;
+    std::shared_ptr<AxmlChunk> axml =
+        options.copyAxml && (chna || !inputHasTracks) ? reader->axmlChunk()
+                                                      : nullptr;
+
+    auto writer = writeFile(proxyFilename, out, sampleRate, options.bitDepth,
+                            chna, axml);
+
+    // poolBlocks() of the last stage: the reader and an upmix hold up to 2
+    // blocks, and each threaded stage adds its queue
+    const size_t blocks = 2 * options.queueBlocks + 2;
+    BlockPool pool(options.blockFrames, std::max(in, out), blocks);
+    ReaderSource source(*reader, pool);
+    MatrixMix mix(source, out, matrix, pool);
+    ThreadedStage mixThread(mix, options.queueBlocks);
+    std::unique_ptr<ResampleBlocks> resample;
+    std::unique_ptr<ThreadedStage> resampleThread;
+    BlockSource* last = &mixThread;
+    if (sampleRate != reader->sampleRate()) {
+      resample.reset(new ResampleBlocks(mixThread, sampleRate, pool,
+                                        options.zeroCrossings));
+      resampleThread.reset(new ThreadedStage(*resample, options.queueBlocks));
+      last = resampleThread.get();
+    }
+
+    WriterSink sink(*writer);
+    const uint64_t frames = runPipeline(*last, sink);
+    writer->close();
+    return frames;
+  }
+
+}  // namespace bw64
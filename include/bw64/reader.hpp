@@ -2,6 +2,7 @@
 #pragma once
 #include <algorithm>
 #include <fstream>
+#include <limits>
 #include <memory>
 #include <sstream>
 #include <stdexcept>
@@ -9,14 +10,30 @@
 #include <string>
 #include <type_traits>
 #include <vector>
+#include "block_cache.hpp"
 #include "chunks.hpp"
 #include "utils.hpp"
 #include "parser.hpp"
+#include "markers.hpp"
+#include "tiles.hpp"
 
 #include <iostream>
 
 namespace bw64 {
 
+  /**
+   * @brief Range of frames to read with Bw64Reader::readRanges()
+   */
+  template <typename T>
+  struct FrameRange {
+    /// first frame to read
+    uint64_t frame;
+    /// number of frames to read
+    uint64_t frames;
+    /// buffer for `frames` interleaved frames
+    T* buffer;
+  };
+
   /**
    * @brief Representation of a BW64 file
    *
@@ -26,45 +43,88 @@ namespace bw64 {
    * [RAII](https://en.wikipedia.org/wiki/Resource_acquisition_is_initialization)
    * class, meaning that the file will be openend and initialized (parse header,
    * format etc.) on construction, and closed on destruction.
+   *
+   * @note A reader must not be used from several threads at once without
+   * synchronisation, even through const methods: the getters of lazily
+   * parsed chunks (see ChunkParserRegistry) read them from the file on first
+   * access, which changes the file stream and the parsed chunks.
    */
   class Bw64Reader {
    public:
+    /// number of bytes read at once when opening a file
+    static const size_t DEFAULT_HEADER_WINDOW_SIZE = 65536;
+
     /**
      * @brief Open a new BW64 file for reading
      *
      * Opens a new BW64 file for reading, parses the whole file to read the
      * format and identify all chunks in it.
      *
+     * The first `headerWindowSize` bytes of the file are fetched with a single
+     * read, and all chunk headers and chunks within them are parsed from
+     * memory. Only chunks behind this window, usually those following the
+     * data chunk, need further reads. This keeps the number of requests low
+     * on network file systems.
+     *
      * @note For convenience, you might consider using the `readFile` helper
      * function.
      */
-    Bw64Reader(const char* filename) {
+    Bw64Reader(const char* filename,
+               size_t headerWindowSize = DEFAULT_HEADER_WINDOW_SIZE)
+        : Bw64Reader(filename, defaultChunkParserRegistry(), headerWindowSize) {
+    }
+
+    /**
+     * @brief Open a new BW64 file for reading with custom chunk parsers
+     *
+     * Chunks are parsed with the parsers in `registry`. Chunks registered for
+     * lazy parsing are not read while opening the file, but when they are
+     * first accessed through chunk() or one of the typed getters. The
+     * registry is only used during construction.
+     */
+    Bw64Reader(const char* filename, const ChunkParserRegistry& registry,
+               size_t headerWindowSize = DEFAULT_HEADER_WINDOW_SIZE)
+        : filename_(filename) {
       fileStream_.open(filename, std::fstream::in | std::fstream::binary);
       if (!fileStream_.is_open()) {
         std::stringstream errorString;
         errorString << "Could not open file: " << filename;
         throw std::runtime_error(errorString.str());
       }
+      readHeaderWindow(headerWindowSize);
       readRiffChunk();
+      uint64_t position = 12u;
       if (fileFormat_ == utils::fourCC("BW64") ||
           fileFormat_ == utils::fourCC("RF64")) {
-        auto chunkHeader = parseHeader();
+        auto chunkHeader = parseHeader(position);
         if (chunkHeader.id != utils::fourCC("ds64")) {
           throw std::runtime_error(
               "mandatory ds64 chunk for BW64 or RF64 file not found");
         }
-        auto ds64Chunk =
-            parseDataSize64Chunk(fileStream_, chunkHeader.id, chunkHeader.size);
+        auto ds64Chunk = parseDataSize64Chunk(
+            streamAt(position + 8u, chunkHeader.size), chunkHeader.id,
+            chunkHeader.size);
         chunks_.push_back(ds64Chunk);
         chunkHeaders_.push_back(chunkHeader);
+        position = chunkEnd(chunkHeader);
       }
-      parseChunkHeaders();
+      parseChunkHeaders(position);
       for (auto chunkHeader : chunkHeaders_) {
-        if (chunkHeader.id != utils::fourCC("ds64")) {
-          auto chunk = parseChunk(fileStream_, chunkHeader);
-          chunks_.push_back(chunk);
+        if (chunkHeader.id == utils::fourCC("ds64")) continue;
+        const ChunkParserRegistry::Entry& entry = registry.find(chunkHeader.id);
+        if (entry.parsing == ChunkParsing::lazy) {
+          lazyChunks_.push_back(LazyChunk{chunkHeader, entry.parser});
+          continue;
         }
+        // the data chunk itself is not read while parsing
+        const uint64_t size =
+            chunkHeader.id == utils::fourCC("data") ? 0u : chunkHeader.size;
+        auto chunk = ChunkParserRegistry::parse(
+            streamAt(chunkHeader.position + 8u, size), chunkHeader,
+            entry.parser);
+        if (chunk) chunks_.push_back(chunk);
       }
+      releaseHeaderWindow();
 
       auto fmtChunk = formatChunk();
       if (!fmtChunk) {
@@ -77,6 +137,9 @@ namespace bw64 {
 
       if (!dataChunk())
         throw std::runtime_error("mandatory data chunk not found");
+      dataStart_ = getChunkHeader(utils::fourCC("data")).position + 8u;
+      numberOfFrames_ = dataChunk()->size() / blockAlignment();
+      buildMarkerIndex();
 
       seek(0);
     }
@@ -111,8 +174,13 @@ namespace bw64 {
     /// @brief Get bit depth
     uint16_t bitDepth() const { return bitsPerSample_; };
     /// @brief Get number of frames
-    uint64_t numberOfFrames() const {
-      return dataChunk()->size() / blockAlignment();
+    uint64_t numberOfFrames() const { return numberOfFrames_; }
+    /// @brief Get the file offset of the first sample in bytes
+    uint64_t dataOffset() const { return dataStart_; }
+    /// @brief Check if the first sample is at a multiple of `alignment` bytes
+    /// in the file, e.g. for page or sector aligned access
+    bool isDataAligned(uint64_t alignment = 4096) const {
+      return alignment != 0 && dataStart_ % alignment == 0;
     }
     /// @brief Get block alignment
     uint16_t blockAlignment() const {
@@ -141,7 +209,7 @@ namespace bw64 {
                                   return chunk->id() == chunkId;
                                 });
       if (chunk != chunks.end()) {
-        return std::static_pointer_cast<ChunkType>(*chunk);
+        return std::dynamic_pointer_cast<ChunkType>(*chunk);
       } else {
         return nullptr;
       }
@@ -154,7 +222,7 @@ namespace bw64 {
      * a nullptr.
      */
     std::shared_ptr<DataSize64Chunk> ds64Chunk() const {
-      return chunk<DataSize64Chunk>(chunks_, utils::fourCC("ds64"));
+      return chunk<DataSize64Chunk>(utils::fourCC("ds64"));
     }
     /**
      * @brief Get 'fmt ' chunk
@@ -163,7 +231,7 @@ namespace bw64 {
      * a nullptr.
      */
     std::shared_ptr<FormatInfoChunk> formatChunk() const {
-      return chunk<FormatInfoChunk>(chunks_, utils::fourCC("fmt "));
+      return chunk<FormatInfoChunk>(utils::fourCC("fmt "));
     }
     /**
      * @brief Get 'data' chunk
@@ -175,7 +243,7 @@ namespace bw64 {
      * a nullptr.
      */
     std::shared_ptr<DataChunk> dataChunk() const {
-      return chunk<DataChunk>(chunks_, utils::fourCC("data"));
+      return chunk<DataChunk>(utils::fourCC("data"));
     }
     /**
      * @brief Get 'chna' chunk
@@ -184,7 +252,7 @@ namespace bw64 {
      * nullptr.
      */
     std::shared_ptr<ChnaChunk> chnaChunk() const {
-      return chunk<ChnaChunk>(chunks_, utils::fourCC("chna"));
+      return chunk<ChnaChunk>(utils::fourCC("chna"));
     }
     /**
      * @brief Get 'axml' chunk
@@ -193,7 +261,145 @@ namespace bw64 {
      * nullptr.
      */
     std::shared_ptr<AxmlChunk> axmlChunk() const {
-      return chunk<AxmlChunk>(chunks_, utils::fourCC("axml"));
+      return chunk<AxmlChunk>(utils::fourCC("axml"));
+    }
+
+    /**
+     * @brief Get 'bext' chunk
+     *
+     * The CodingHistory is not loaded when parsing the chunk with the default
+     * parser; use readBextCodingHistory() to load it.
+     *
+     * @returns `std::shared_ptr` to BextChunk if present and otherwise a
+     * nullptr.
+     */
+    std::shared_ptr<BextChunk> bextChunk() const {
+      return chunk<BextChunk>(utils::fourCC("bext"));
+    }
+
+    /**
+     * @brief Load the CodingHistory of the 'bext' chunk from the file
+     *
+     * The CodingHistory is stored in the chunk returned by bextChunk(), so it
+     * is only read once.
+     *
+     * @returns CodingHistory, or an empty string if there is no bext chunk
+     */
+    std::string readBextCodingHistory() {
+      auto bext = bextChunk();
+      if (!bext) return std::string();
+      if (!bext->hasCodingHistory()) {
+        auto header = getChunkHeader(utils::fourCC("bext"));
+        std::string codingHistory(
+            utils::safeCast<size_t>(bext->codingHistorySize()), 0);
+        readAt(header.position + 8u + BextChunk::fixedSize(), &codingHistory[0],
+               codingHistory.size());
+        bext->codingHistory(std::move(codingHistory));
+      }
+      return bext->codingHistory();
+    }
+
+    /**
+     * @brief Get the TimeReference of the first frame
+     *
+     * @returns the TimeReference of the 'bext' chunk, i.e. the number of
+     * samples since midnight, or 0 if there is no bext chunk
+     */
+    uint64_t timeReference() const {
+      auto bext = bextChunk();
+      return bext ? bext->timeReference() : 0u;
+    }
+
+    /**
+     * @brief Convert a TimeReference to a frame offset in this file
+     *
+     * @returns frame offset of `timeReference` relative to the first frame;
+     * negative if it is before the start of the file, and greater than or
+     * equal to numberOfFrames() if it is after the end.
+     */
+    int64_t frameAtTimeReference(uint64_t timeReference) const {
+      const uint64_t start = this->timeReference();
+      const uint64_t max = (std::numeric_limits<int64_t>::max)();
+      if (timeReference >= start)
+        return static_cast<int64_t>(std::min(timeReference - start, max));
+      return -static_cast<int64_t>(std::min(start - timeReference, max));
+    }
+
+    /**
+     * @brief Seek to the frame with a TimeReference
+     *
+     * Like seek(), positions before the start or after the end of the file
+     * are clamped to the first frame or the end of the file.
+     *
+     * @returns true if `timeReference` lies within the file
+     */
+    bool seekTimeReference(uint64_t timeReference) {
+      const int64_t frame = frameAtTimeReference(timeReference);
+      seek(frame);
+      return frame >= 0 && static_cast<uint64_t>(frame) < numberOfFrames();
+    }
+
+    /**
+     * @brief Get 'cue ' chunk
+     *
+     * @returns `std::shared_ptr` to CueChunk if present and otherwise a
+     * nullptr.
+     */
+    std::shared_ptr<CueChunk> cueChunk() const {
+      return std::dynamic_pointer_cast<CueChunk>(findChunk(CueChunk::Id()));
+    }
+
+    /**
+     * @brief Get the markers of the file, sorted by frame
+     *
+     * The index is built when opening the file from the 'cue ' chunk and the
+     * labels of all eagerly parsed 'LIST' chunks of type 'adtl'. Cue points
+     * after the end of the data chunk are left out.
+     */
+    const MarkerIndex& markers() const { return markers_; }
+
+    /**
+     * @brief Seek to the frame of a marker
+     *
+     * @param cueId id of the cue point of the marker
+     */
+    void seekToMarker(uint32_t cueId) {
+      const Marker* marker = markers_.find(cueId);
+      if (!marker) {
+        std::stringstream errorMsg;
+        errorMsg << "no marker with cue point id " << cueId << " found";
+        throw std::runtime_error(errorMsg.str());
+      }
+      seek(utils::safeCast<int64_t>(marker->frame));
+    }
+
+    /**
+     * @brief Get the first chunk with an id
+     *
+     * Lazily parsed chunks are read from the file on first access, which
+     * moves the file position of this reader; see the note on thread safety
+     * of Bw64Reader.
+     *
+     * This and the typed getters such as formatChunk() and chnaChunk() check
+     * the type of the chunk, which depends on the parser registered for its
+     * id (see ChunkParserRegistry).
+     *
+     * @returns `std::shared_ptr` to the chunk if present and of type
+     * ChunkType, and otherwise a nullptr.
+     */
+    template <typename ChunkType = Chunk>
+    std::shared_ptr<ChunkType> chunk(uint32_t id) const {
+      return std::dynamic_pointer_cast<ChunkType>(findChunk(id));
+    }
+
+    /**
+     * @brief Check if the chunk with an id has been parsed
+     *
+     * This is false for chunks which are not present, and for lazily parsed
+     * chunks which have not been accessed yet.
+     */
+    bool isChunkParsed(uint32_t id) const {
+      return chunk<Chunk>(chunks_, id) != nullptr;
     }
 
     /**
@@ -215,39 +421,55 @@ namespace bw64 {
       }
     }
 
+    /**
+     * @brief Read the contents of the first chunk with an id, as stored in
+     * the file
+     *
+     * The chunk is not parsed, so this also works for chunks which were
+     * dropped by their parser or only partly loaded, such as a bext chunk
+     * whose CodingHistory has not been read.
+     *
+     * @throws std::runtime_error if there is no such chunk
+     */
+    std::string readChunkData(uint32_t id) {
+      ChunkHeader header = getChunkHeader(id);
+      std::string data(utils::safeCast<size_t>(header.size), 0);
+      if (!data.empty()) readAt(header.position + 8u, &data[0], data.size());
+      return data;
+    }
+
     /**
      * @brief Seek a frame position in the DataChunk
+     *
+     * The file itself is only repositioned by the next read which needs it.
      */
-    void seek(int32_t offset, std::ios_base::seekdir way = std::ios::beg) {
+    void seek(int64_t offset, std::ios_base::seekdir way = std::ios::beg) {
       auto numberOfFramesInt = utils::safeCast<int64_t>(numberOfFrames());
 
       // where to seek relative to according to way
       int64_t startFrame = 0;
       if (way == std::ios::cur) {
-        startFrame = tell();
+        startFrame = utils::safeCast<int64_t>(tell());
       } else if (way == std::ios::beg) {
         startFrame = 0;
       } else if (way == std::ios::end) {
         startFrame = numberOfFramesInt;
       }
 
-      // requested frame number, clamped to a frame within the data chunk
-      int64_t frame = startFrame + offset;
+      // requested frame number, clamped to a frame within the data chunk;
+      // startFrame is within [0, INT64_MAX], so only positive offsets can
+      // overflow
+      int64_t frame;
+      if (offset > (std::numeric_limits<int64_t>::max)() - startFrame)
+        frame = numberOfFramesInt;
+      else
+        frame = startFrame + offset;
       if (frame < 0)
         frame = 0;
       else if (frame > numberOfFramesInt)
         frame = numberOfFramesInt;
 
-      // the position in the file of the frame
-      const int64_t dataStartPos =
-          getChunkHeader(utils::fourCC("data")).position + 8;
-      const int64_t framePos =
-          dataStartPos + frame * static_cast<int64_t>(blockAlignment());
-
-      fileStream_.seekg(framePos);
-
-      if (!fileStream_.good())
-        throw std::runtime_error("file error while seeking");
+      position_ = static_cast<uint64_t>(frame);
     }
 
     /**
@@ -261,49 +483,555 @@ namespace bw64 {
     template <typename T, typename std::enable_if<
                               std::is_floating_point<T>::value, int>::type = 0>
     uint64_t read(T* outBuffer, uint64_t frames) {
-      if (tell() + frames > numberOfFrames()) {
-        frames = numberOfFrames() - tell();
+      uint64_t done = 0;
+      while (done < frames) {
+        const bool inLoop = looping() && tell() < loopEnd_;
+        const uint64_t end = inLoop ? loopEnd_ : numberOfFrames();
+        uint64_t n = std::min(frames - done, end - tell());
+        if (n == 0) break;
+
+        T* out = outBuffer + done * channels();
+        const uint64_t residentEnd = loopStart_ + loopResidentFrames_;
+        if (tell() >= loopStart_ && tell() < residentEnd) {
+          n = std::min(n, residentEnd - tell());
+          utils::decodePcmSamples(
+              &loopBuffer_[(tell() - loopStart_) * blockAlignment()], out,
+              n * channels(), bitDepth());
+          position_ += n;
+        } else if (!readFromBlockCache(out, n)) {
+          rawDataBuffer_.resize(n * blockAlignment());
+          readRaw(rawDataBuffer_.data(), n);
+          if (nonTemporalStores_)
+            utils::decodePcmSamplesNonTemporal(rawDataBuffer_.data(), out,
+                                               n * channels(), bitDepth());
+          else
+            utils::decodePcmSamples(rawDataBuffer_.data(), out,
+                                    n * channels(), bitDepth());
+        }
+        done += n;
+
+        if (inLoop && tell() == loopEnd_) position_ = loopStart_;
+      }
+
+      return done;
+    }
+
+    /**
+     * @brief Read many ranges of frames in one batch
+     *
+     * Every range is decoded into its own buffer. The ranges are read in file
+     * order, and ranges which overlap or are separated by no more than
+     * `maxGapBytes` bytes are fetched with a single read, so that many short
+     * windows spread over a file need far fewer seeks and reads than
+     * individual seek() and read() calls. A batch is not extended beyond
+     * 16 MiB. The current position is not changed.
+     *
+     * Frames of a range which lie behind the end of the data chunk are set to
+     * zero.
+     *
+     * @param ranges    ranges to read, in any order
+     * @param count     number of ranges
+     * @param maxGapBytes largest gap between two ranges which is read rather
+     * than skipped
+     *
+     * @returns total number of frames read
+     */
+    template <typename T, typename std::enable_if<
+                              std::is_floating_point<T>::value, int>::type = 0>
+    uint64_t readRanges(const FrameRange<T>* ranges, size_t count,
+                        uint64_t maxGapBytes = 65536) {
+      std::vector<size_t> order(count);
+      for (size_t i = 0; i < count; ++i) order[i] = i;
+      std::sort(order.begin(), order.end(), [ranges](size_t a, size_t b) {
+        return ranges[a].frame < ranges[b].frame;
+      });
+
+      const uint64_t maxGapFrames = maxGapBytes / blockAlignment();
+      uint64_t framesRead = 0;
+      size_t first = 0;
+      while (first < count) {
+        // extend the group as long as the next range is close enough
+        const uint64_t groupStart =
+            std::min(ranges[order[first]].frame, numberOfFrames());
+        uint64_t groupEnd = clampedRangeEnd(ranges[order[first]]);
+        size_t last = first + 1;
+        for (; last < count; ++last) {
+          const FrameRange<T>& range = ranges[order[last]];
+          if (range.frame > groupEnd + maxGapFrames ||
+              (groupEnd - groupStart) * blockAlignment() >= MAX_BATCH_BYTES)
+            break;
+          groupEnd = std::max(groupEnd, clampedRangeEnd(range));
+        }
+
+        rawDataBuffer_.resize((groupEnd - groupStart) * blockAlignment());
+        readFramesAt(groupStart, rawDataBuffer_.data(), groupEnd - groupStart);
+
+        for (size_t i = first; i < last; ++i) {
+          const FrameRange<T>& range = ranges[order[i]];
+          const uint64_t available = clampedRangeEnd(range) -
+                                     std::min(range.frame, numberOfFrames());
+          if (available) {
+            utils::decodePcmSamples(
+                &rawDataBuffer_[(range.frame - groupStart) * blockAlignment()],
+                range.buffer, available * channels(), bitDepth());
+          }
+          std::fill(range.buffer + available * channels(),
+                    range.buffer + range.frames * channels(), T{0});
+          framesRead += available;
+        }
+        first = last;
+      }
+      return framesRead;
+    }
+
+    /// @brief Read many ranges of frames in one batch
+    ///
+    /// See readRanges(const FrameRange<T>*, size_t, uint64_t).
+    template <typename T, typename std::enable_if<
+                              std::is_floating_point<T>::value, int>::type = 0>
+    uint64_t readRanges(const std::vector<FrameRange<T>>& ranges,
+                        uint64_t maxGapBytes = 65536) {
+      return readRanges(ranges.data(), ranges.size(), maxGapBytes);
+    }
+
+    /**
+     * @brief Loop a region of the dataChunk
+     *
+     * When read() reaches `loopEnd` from a position before it, it continues
+     * at `loopStart`, also within a single call, so the region is played
+     * indefinitely. Reading from positions at or after `loopEnd` is not
+     * affected.
+     *
+     * If the region takes at most `residentBytes` bytes, it is read once and
+     * kept in memory, so that looping does not access the file at all.
+     * Otherwise only the beginning of the region is kept, so that reads can
+     * continue across each wrap without waiting for the file.
+     *
+     * @param loopStart first frame of the loop
+     * @param loopEnd frame after the last frame of the loop
+     * @param residentBytes memory budget for the loop region
+     */
+    void setLoop(uint64_t loopStart, uint64_t loopEnd,
+                 size_t residentBytes = 16u << 20) {
+      if (loopStart >= loopEnd || loopEnd > numberOfFrames()) {
+        std::stringstream errorString;
+        errorString << "invalid loop region [" << loopStart << ", " << loopEnd
+                    << ") for " << numberOfFrames() << " frames";
+        throw std::runtime_error(errorString.str());
+      }
+      clearLoop();
+      const uint64_t residentFrames = std::min<uint64_t>(
+          loopEnd - loopStart, residentBytes / blockAlignment());
+      loopBuffer_.resize(residentFrames * blockAlignment());
+      readFramesAt(loopStart, loopBuffer_.data(), residentFrames);
+      loopStart_ = loopStart;
+      loopEnd_ = loopEnd;
+      loopResidentFrames_ = residentFrames;
+    }
+
+    /// @brief Stop looping and release the resident loop region
+    void clearLoop() {
+      loopStart_ = 0;
+      loopEnd_ = 0;
+      loopResidentFrames_ = 0;
+      std::vector<char>().swap(loopBuffer_);
+    }
+
+    /// @brief Check if a loop region is set
+    bool looping() const { return loopEnd_ != 0; }
+    /// @brief Get first frame of the loop region
+    uint64_t loopStart() const { return loopStart_; }
+    /// @brief Get frame after the last frame of the loop region
+    uint64_t loopEnd() const { return loopEnd_; }
+    /// @brief Get number of frames of the loop region kept in memory
+    uint64_t loopResidentFrames() const { return loopResidentFrames_; }
+
+    /**
+     * @brief Read frames from dataChunk without decoding them
+     *
+     * The interleaved PCM samples are copied as stored in the file, i.e. the
+     * buffer must hold at least `frames * blockAlignment()` bytes.
+     *
+     * @param[out] outBuffer Buffer to write the encoded frames to
+     * @param[in]  frames    Number of frames to read
+     *
+     * @returns number of frames read
+     */
+    uint64_t readRaw(char* outBuffer, uint64_t frames) {
+      frames = std::min(frames, numberOfFrames() - tell());
+      readFramesAt(position_, outBuffer, frames);
+      position_ += frames;
+      return frames;
+    }
+
+    /**
+     * @brief Read the frames of one channel
+     *
+     * If a tiled sidecar is in use (see useTiledSidecar()), the samples are
+     * read from it, which reads only the data of this channel. Otherwise the
+     * sidecar at tiledSidecarPath() is used if it exists and was built from
+     * this file, or else the frames are read from the data chunk in blocks.
+     * A sidecar which fails to be read is no longer used. The current
+     * position is not changed.
+     *
+     * @param[in]  channel   channel to read
+     * @param[in]  frame     first frame to read
+     * @param[out] outBuffer buffer for `frames` samples
+     * @param[in]  frames    number of frames to read
+     *
+     * @returns number of frames read
+     */
+    template <typename T, typename std::enable_if<
+                              std::is_floating_point<T>::value, int>::type = 0>
+    uint64_t readChannel(uint16_t channel, uint64_t frame, T* outBuffer,
+                         uint64_t frames) {
+      if (channel >= channels()) {
+        std::stringstream errorString;
+        errorString << "channel " << channel << " out of range for "
+                    << channels() << " channels";
+        throw std::runtime_error(errorString.str());
+      }
+      if (!tiledSidecarChecked_) {
+        tiledSidecarChecked_ = true;
+        try {
+          useTiledSidecar(tiledSidecarPath(filename_));
+        } catch (const std::runtime_error&) {
+          // missing or stale; read from the data chunk
+        }
+      }
+      if (tiledSidecar_) {
+        try {
+          return tiledSidecar_->readChannel(channel, frame, outBuffer, frames);
+        } catch (const std::runtime_error&) {
+          // e.g. truncated since it was opened; read from the data chunk
+          tiledSidecar_.reset();
+        }
+      }
+
+      if (frame >= numberOfFrames()) return 0;
+      frames = std::min(frames, numberOfFrames() - frame);
+      const uint64_t blockFrames =
+          std::max<uint64_t>(1, MAX_BATCH_BYTES / blockAlignment());
+      for (uint64_t done = 0; done < frames; done += blockFrames) {
+        const uint64_t n = std::min(blockFrames, frames - done);
+        rawDataBuffer_.resize(n * blockAlignment());
+        readFramesAt(frame + done, rawDataBuffer_.data(), n);
+        utils::decodePcmChannel(rawDataBuffer_.data(), outBuffer + done, n,
+                                channels(), channel, bitDepth());
       }
+      return frames;
+    }
+
+    /**
+     * @brief Use a tiled sidecar for readChannel()
+     *
+     * Throws if the sidecar cannot be read or was not built from this file.
+     * Besides the format, length, file size and data offset, the sidecar
+     * records a checksum of 16 evenly spaced runs of about 4 KiB of the
+     * data chunk, including its first and last frames, which is compared
+     * with the data of this file. Edits which keep the length of the file
+     * and touch none of these runs are not detected; rebuild the sidecar
+     * with writeTiledSidecar() after such edits.
+     */
+    void useTiledSidecar(const std::string& filename) {
+      std::unique_ptr<TiledSidecar> sidecar(new TiledSidecar(filename));
+      const TiledSidecarHeader& header = sidecar->header();
+      if (header.channels != channels() || header.bitDepth != bitDepth() ||
+          header.numberOfFrames != numberOfFrames() ||
+          header.sourceFileSize != fileEnd_ ||
+          header.sourceDataStart != dataStart_ ||
+          header.sourceChecksum != sampledDataChecksum()) {
+        std::stringstream errorString;
+        errorString << "tiled sidecar " << filename
+                    << " was not built from this file";
+        throw std::runtime_error(errorString.str());
+      }
+      tiledSidecar_ = std::move(sidecar);
+      tiledSidecarChecked_ = true;
+    }
+
+    /// @brief Check if readChannel() reads from a tiled sidecar
+    bool hasTiledSidecar() const { return tiledSidecar_ != nullptr; }
+
+    /**
+     * @brief Build a tiled sidecar of this file
+     *
+     * The data chunk is read once, one tile of all channels at a time. The
+     * current position is not changed, and the sidecar is not used until
+     * passed to useTiledSidecar() or found by readChannel().
+     *
+     * @param filename   sidecar file; tiledSidecarPath() of this file if empty
+     * @param tileFrames number of frames per tile
+     */
+    void writeTiledSidecar(const std::string& filename = "",
+                           uint32_t tileFrames = 65536) {
+      TiledSidecarHeader header;
+      header.channels = channels();
+      header.bitDepth = bitDepth();
+      header.tileFrames = tileFrames;
+      header.numberOfFrames = numberOfFrames();
+      header.sourceFileSize = fileEnd_;
+      header.sourceDataStart = dataStart_;
+      header.sourceChecksum = sampledDataChecksum();
+      TiledSidecarWriter writer(
+          filename.empty() ? tiledSidecarPath(filename_) : filename, header);
+      std::vector<char> tile;
+      for (uint64_t t = 0; t < writer.tiles(); ++t) {
+        const uint64_t frames = header.framesInTile(t);
+        tile.resize(utils::safeCast<size_t>(frames * blockAlignment()));
+        readFramesAt(t * tileFrames, tile.data(), frames);
+        writer.writeTile(tile.data());
+      }
+      writer.close();
+    }
+
+    /**
+     * @brief Read frames into one buffer per channel
+     *
+     * Like readRaw(), this reads from the current position up to the end of
+     * the dataChunk and ignores any loop set with setLoop().
+     *
+     * @param[out] outBuffers `channels()` buffers of at least `frames`
+     * samples each
+     * @param[in]  frames     Number of frames to read
+     *
+     * @returns number of frames read
+     */
+    template <typename T, typename std::enable_if<
+                              std::is_floating_point<T>::value, int>::type = 0>
+    uint64_t readPlanar(T* const* outBuffers, uint64_t frames) {
+      frames = std::min(frames, numberOfFrames() - tell());
+      rawDataBuffer_.resize(frames * blockAlignment());
+      readFramesAt(position_, rawDataBuffer_.data(), frames);
+      utils::decodePcmFramesPlanar(rawDataBuffer_.data(), outBuffers, frames,
+                                   channels(), bitDepth());
+      position_ += frames;
+      return frames;
+    }
 
-      if (frames) {
+    /**
+     * @brief Read frames as big-endian PCM samples
+     *
+     * The samples are converted from the PCM data of the file without
+     * decoding to float, as used by the L16 and L24 RTP payload formats. See
+     * utils::convertPcmSamplesToBigEndian for the conversion rules. If the
+     * bit depths match, frames are read straight into `outBuffer` and byte
+     * swapped in place.
+     *
+     * @param[out] outBuffer Buffer for `frames * channels()` samples
+     * @param[in]  frames    Number of frames to read
+     * @param[in]  bitDepth  Bit depth of the output samples; 16 or 24
+     *
+     * @returns number of frames read
+     */
+    uint64_t readBigEndian(char* outBuffer, uint64_t frames,
+                           uint16_t bitDepth) {
+      if (bitDepth != 16 && bitDepth != 24) {
+        std::stringstream errorString;
+        errorString << "unsupported bit depth for big-endian output: "
+                    << bitDepth;
+        throw std::runtime_error(errorString.str());
+      }
+      frames = std::min(frames, numberOfFrames() - tell());
+      const uint64_t samples = frames * channels();
+      if (bitDepth == bitsPerSample_) {
+        readFramesAt(position_, outBuffer, frames);
+        utils::convertPcmSamplesToBigEndian(outBuffer, outBuffer, samples,
+                                            bitsPerSample_, bitDepth);
+      } else {
         rawDataBuffer_.resize(frames * blockAlignment());
-        fileStream_.read(rawDataBuffer_.data(), frames * blockAlignment());
-        if (fileStream_.eof())
-          throw std::runtime_error("file ended while reading frames");
-        if (!fileStream_.good())
-          throw std::runtime_error("file error while reading frames");
+        readFramesAt(position_, rawDataBuffer_.data(), frames);
+        utils::convertPcmSamplesToBigEndian(rawDataBuffer_.data(), outBuffer,
+                                            samples, bitsPerSample_, bitDepth);
+      }
+      position_ += frames;
+      return frames;
+    }
 
-        utils::decodePcmSamples(rawDataBuffer_.data(), outBuffer,
-                                frames * channels(), bitDepth());
+    /**
+     * @brief Read frames backwards from dataChunk
+     *
+     * Reads the `frames` frames *before* the current position and writes them
+     * to `outBuffer` in reverse order, i.e. the frame directly before the
+     * current position comes first. Afterwards the current position is moved
+     * to the first of these frames, so that successive calls play the file
+     * backwards.
+     *
+     * Frames are fetched from the file in blocks of at least
+     * reverseReadahead() frames, which are then served from memory by the
+     * following calls, so that small reverse reads do not each need a seek
+     * and a read.
+     *
+     * @param[out] outBuffer Buffer to write the samples to
+     * @param[in]  frames    Number of frames to read
+     *
+     * @returns number of frames read
+     */
+    template <typename T, typename std::enable_if<
+                              std::is_floating_point<T>::value, int>::type = 0>
+    uint64_t readReverse(T* outBuffer, uint64_t frames) {
+      frames = std::min(frames, tell());
+      if (frames == 0) return 0;
+
+      const uint64_t end = tell();
+      const uint64_t start = end - frames;
+      if (start < reverseStart_ || end > reverseStart_ + reverseFrames_) {
+        const uint64_t blockFrames = std::max(frames, reverseReadahead_);
+        const uint64_t blockStart = end > blockFrames ? end - blockFrames : 0;
+        reverseFrames_ = 0;
+        reverseBuffer_.resize((end - blockStart) * blockAlignment());
+        readFramesAt(blockStart, reverseBuffer_.data(), end - blockStart);
+        reverseStart_ = blockStart;
+        reverseFrames_ = end - blockStart;
       }
 
+      utils::decodePcmFramesReversed(
+          &reverseBuffer_[(start - reverseStart_) * blockAlignment()],
+          outBuffer, frames, channels(), bitDepth());
+      position_ = start;
       return frames;
     }
 
+    /// @brief Get the minimum number of frames fetched by readReverse()
+    uint64_t reverseReadahead() const { return reverseReadahead_; }
+    /// @brief Set the minimum number of frames fetched by readReverse()
+    void setReverseReadahead(uint64_t frames) {
+      reverseReadahead_ = std::max<uint64_t>(frames, 1u);
+    }
+
+    /**
+     * @brief Share decoded blocks with other readers through a cache
+     *
+     * read() into float buffers then reads whole blocks of
+     * `cache->blockBytes()` bytes, taking them from the cache where possible,
+     * and offers the blocks it decodes to the cache. Reads of the in-memory
+     * part of a loop, and all other read functions, are not affected.
+     *
+     * The file is identified with `cache->identify()` by its name now, not
+     * through the open file, so the cache should not be attached before the
+     * file is complete, and should be attached right after opening it.
+     * Throws if the file at the name of this reader no longer has the size
+     * it had when it was opened; other replacements of the file after it
+     * was opened are not detected, and would share the blocks of the opened
+     * file under the identity of the new one.
+     *
+     * The last block decoded by this reader is kept, so that reads of parts
+     * of it do not decode it again if the cache dropped it.
+     *
+     * @param cache cache to use, e.g. a SharedBlockCache to share blocks with
+     * other processes; nullptr to stop using a cache
+     */
+    void useBlockCache(std::shared_ptr<BlockCache> cache) {
+      if (cache) {
+        const FileIdentity identity = cache->identify(filename_);
+        if (identity.size != fileEnd_) {
+          std::stringstream errorString;
+          errorString << "file " << filename_ << " changed since it was opened";
+          throw std::runtime_error(errorString.str());
+        }
+        fileIdentity_ = identity;
+      }
+      blockCache_ = std::move(cache);
+      cacheBlockIndex_ = NO_BLOCK;
+    }
+    /// @brief Get the block cache in use, if any
+    std::shared_ptr<BlockCache> blockCache() const { return blockCache_; }
+
+    /**
+     * @brief Allocate the buffers for encoded frames from huge pages
+     *
+     * Reads of many megabytes at a time, e.g. for bulk conversion, then use
+     * buffers backed by transparent huge pages (see utils::HugePageAllocator),
+     * which reduces TLB misses. This frees the current buffers.
+     */
+    void useHugePages(bool state) {
+      rawDataBuffer_ = utils::RawBuffer(utils::HugePageAllocator<char>(state));
+      reverseBuffer_ = utils::RawBuffer(utils::HugePageAllocator<char>(state));
+      reverseFrames_ = 0;
+    }
+    /// @brief Check if buffers are allocated from huge pages
+    bool usesHugePages() const {
+      return rawDataBuffer_.get_allocator().enabled();
+    }
+
+    /**
+     * @brief Decode frames read from the file with non-temporal stores
+     *
+     * read() then writes its output past the cache (see
+     * utils::decodePcmSamplesNonTemporal()). This only pays off for reads
+     * much larger than the cache whose output is not used again soon, e.g.
+     * bulk conversion, so it is off by default.
+     */
+    void useNonTemporalStores(bool state) { nonTemporalStores_ = state; }
+    /// @brief Check if read() uses non-temporal stores
+    bool usesNonTemporalStores() const { return nonTemporalStores_; }
+
     /**
      * @brief Tell the current frame position of the dataChunk
      *
      * @returns current frame position of the dataChunk
      */
-    uint64_t tell() {
-      return ((uint64_t)fileStream_.tellg() -
-              getChunkHeader(utils::fourCC("data")).position - 8u) /
-             formatChunk()->blockAlignment();
-    }
+    uint64_t tell() const { return position_; }
 
     /**
      * @brief Check if end of data is reached
      *
      * @returns `true` if end of data is reached and otherwise `false`
      */
-    bool eof() { return tell() == numberOfFrames(); }
+    bool eof() const { return tell() == numberOfFrames(); }
 
    private:
+    /// read the beginning of the file into headerWindow_, and determine the
+    /// file size
+    void readHeaderWindow(size_t size) {
+      headerWindow_.resize(size);
+      fileStream_.read(headerWindow_.data(), size);
+      headerWindow_.resize(static_cast<size_t>(fileStream_.gcount()));
+      if (fileStream_.eof()) {
+        // the whole file is in the window
+        fileStream_.clear();
+        fileEnd_ = headerWindow_.size();
+      } else {
+        if (!fileStream_.good())
+          throw std::runtime_error("file error while reading header");
+        fileStream_.seekg(0, std::ios::end);
+        fileEnd_ = utils::safeCast<uint64_t>(
+            static_cast<std::streamoff>(fileStream_.tellg()));
+        if (!fileStream_.good())
+          throw std::runtime_error("file error while seeking to end of file");
+      }
+      headerWindowBuffer_.reset(headerWindow_.data(), headerWindow_.size());
+      streamFrame_ = UNKNOWN_POSITION;
+    }
+
+    void releaseHeaderWindow() {
+      headerWindowBuffer_.reset(nullptr, 0);
+      std::vector<char>().swap(headerWindow_);
+    }
+
+    /// get a stream positioned at an absolute file position, from which
+    /// size bytes can be read. This is the header window if they are within
+    /// it, and the file otherwise.
+    std::istream& streamAt(uint64_t position, uint64_t size) {
+      std::istream* stream = &fileStream_;
+      if (position <= headerWindow_.size() &&
+          size <= headerWindow_.size() - position) {
+        stream = &headerWindowStream_;
+      } else {
+        streamFrame_ = UNKNOWN_POSITION;
+      }
+      stream->clear();
+      stream->seekg(utils::safeCast<std::streamoff>(position));
+      if (!stream->good()) throw std::runtime_error("file error while seeking");
+      return *stream;
+    }
+
     void readRiffChunk() {
       uint32_t riffType;
-      utils::readValue(fileStream_, fileFormat_);
-      utils::readValue(fileStream_, fileSize_);
-      utils::readValue(fileStream_, riffType);
+      std::istream& stream = streamAt(0u, 12u);
+      utils::readValue(stream, fileFormat_);
+      utils::readValue(stream, fileSize_);
+      utils::readValue(stream, riffType);
 
       if (fileFormat_ != utils::fourCC("RIFF") &&
           fileFormat_ != utils::fourCC("BW64") &&
@@ -315,6 +1043,133 @@ namespace bw64 {
       }
     }
 
+    template <typename T>
+    uint64_t clampedRangeEnd(const FrameRange<T>& range) const {
+      const uint64_t start = std::min(range.frame, numberOfFrames());
+      return start + std::min(range.frames, numberOfFrames() - start);
+    }
+
+    /// read frames at the current position through the block cache, if one
+    /// is in use and holds float blocks; returns false otherwise
+    bool readFromBlockCache(float* outBuffer, uint64_t frames) {
+      if (!blockCache_) return false;
+      const uint64_t frameBytes = uint64_t{channels()} * sizeof(float);
+      const uint64_t blockFrames = blockCache_->blockBytes() / frameBytes;
+      if (blockFrames == 0) return false;
+
+      uint64_t done = 0;
+      while (done < frames) {
+        const uint64_t block = position_ / blockFrames;
+        const uint64_t blockStart = block * blockFrames;
+        const uint64_t framesInBlock =
+            std::min(blockFrames, numberOfFrames() - blockStart);
+        const uint64_t offset = position_ - blockStart;
+        const uint64_t n = std::min(frames - done, framesInBlock - offset);
+        float* out = outBuffer + done * channels();
+        const size_t size = utils::safeCast<size_t>(framesInBlock * frameBytes);
+        if (block == cacheBlockIndex_) {
+          std::copy(cacheBlock_.begin() + offset * channels(),
+                    cacheBlock_.begin() + (offset + n) * channels(), out);
+        } else if (!blockCache_->lookup(
+                       fileIdentity_, block, size,
+                       utils::safeCast<size_t>(offset * frameBytes),
+                       utils::safeCast<size_t>(n * frameBytes), out)) {
+          rawDataBuffer_.resize(framesInBlock * blockAlignment());
+          readFramesAt(blockStart, rawDataBuffer_.data(), framesInBlock);
+          cacheBlock_.resize(framesInBlock * channels());
+          utils::decodePcmSamples(rawDataBuffer_.data(), cacheBlock_.data(),
+                                  framesInBlock * channels(), bitDepth());
+          cacheBlockIndex_ = block;
+          blockCache_->insert(fileIdentity_, block, cacheBlock_.data(), size);
+          std::copy(cacheBlock_.begin() + offset * channels(),
+                    cacheBlock_.begin() + (offset + n) * channels(), out);
+        }
+        position_ += n;
+        done += n;
+      }
+      return true;
+    }
+    template <typename T>
+    bool readFromBlockCache(T*, uint64_t) {
+      return false;
+    }
+
+    /// read encoded frames from an absolute frame position in the data
+    /// chunk, repositioning the file only if it is not already there
+    void readFramesAt(uint64_t frame, char* outBuffer, uint64_t frames) {
+      if (frames == 0) return;
+      if (streamFrame_ != frame) {
+        streamFrame_ = UNKNOWN_POSITION;
+        fileStream_.clear();
+        fileStream_.seekg(utils::safeCast<std::streamoff>(
+            dataStart_ + frame * blockAlignment()));
+        if (!fileStream_.good())
+          throw std::runtime_error("file error while seeking");
+      }
+      streamFrame_ = UNKNOWN_POSITION;
+      fileStream_.read(outBuffer, frames * blockAlignment());
+      if (fileStream_.eof())
+        throw std::runtime_error("file ended while reading frames");
+      if (!fileStream_.good())
+        throw std::runtime_error("file error while reading frames");
+      streamFrame_ = frame + frames;
+    }
+
+    /// hash of 16 evenly spaced runs of about 4 KiB of the data chunk,
+    /// including the first and last frames; identifies the tiled sidecars
+    /// built from this file
+    uint64_t sampledDataChecksum() {
+      const uint64_t runs = 16;
+      const uint64_t runFrames = std::min<uint64_t>(
+          numberOfFrames(), std::max<uint64_t>(1, 4096 / blockAlignment()));
+      std::vector<char> run(runFrames * blockAlignment());
+      uint64_t checksum = utils::fnv1a(nullptr, 0);
+      for (uint64_t i = 0; i < runs && runFrames; ++i) {
+        const uint64_t frame = (numberOfFrames() - runFrames) * i / (runs - 1);
+        readFramesAt(frame, run.data(), runFrames);
+        checksum = utils::fnv1a(run.data(), run.size(), checksum);
+      }
+      return checksum;
+    }
+
+    void buildMarkerIndex() {
+      auto cue = cueChunk();
+      if (!cue) return;
+      std::vector<std::shared_ptr<AdtlChunk>> adtlChunks;
+      for (auto& chunk : chunks_) {
+        auto adtlChunk = std::dynamic_pointer_cast<AdtlChunk>(chunk);
+        if (adtlChunk) adtlChunks.push_back(adtlChunk);
+      }
+      markers_ = MarkerIndex(*cue, adtlChunks, numberOfFrames());
+    }
+
+    /// read bytes at an absolute file position
+    void readAt(uint64_t position, char* outBuffer, size_t size) {
+      streamFrame_ = UNKNOWN_POSITION;
+      fileStream_.clear();
+      fileStream_.seekg(utils::safeCast<std::streamoff>(position));
+      if (!fileStream_.good())
+        throw std::runtime_error("file error while seeking");
+      utils::readChunk(fileStream_, outBuffer, size);
+    }
+
+    /// get a parsed chunk, parsing it first if it is lazily parsed
+    std::shared_ptr<Chunk> findChunk(uint32_t id) const {
+      auto parsed = chunk<Chunk>(chunks_, id);
+      if (parsed) return parsed;
+      auto lazy = std::find_if(
+          lazyChunks_.begin(), lazyChunks_.end(),
+          [id](const LazyChunk& lazy) { return lazy.header.id == id; });
+      if (lazy == lazyChunks_.end()) return nullptr;
+
+      streamFrame_ = UNKNOWN_POSITION;
+      auto chunk =
+          ChunkParserRegistry::parse(fileStream_, lazy->header, lazy->parser);
+      lazyChunks_.erase(lazy);
+      if (chunk) chunks_.push_back(chunk);
+      return chunk;
+    }
+
     ChunkHeader getChunkHeader(uint32_t id) {
       auto foundHeader = std::find_if(
           chunkHeaders_.begin(), chunkHeaders_.end(),
@@ -327,12 +1182,12 @@ namespace bw64 {
       throw std::runtime_error(errorMsg.str());
     }
 
-    ChunkHeader parseHeader() {
+    ChunkHeader parseHeader(uint64_t position) {
       uint32_t chunkId;
       uint32_t chunkSize;
-      uint64_t position = fileStream_.tellg();
-      utils::readValue(fileStream_, chunkId);
-      utils::readValue(fileStream_, chunkSize);
+      std::istream& stream = streamAt(position, 8u);
+      utils::readValue(stream, chunkId);
+      utils::readValue(stream, chunkSize);
       uint64_t chunkSize64 = getChunkSize64(chunkId, chunkSize);
       return ChunkHeader(chunkId, chunkSize64, position);
     }
@@ -352,39 +1207,29 @@ namespace bw64 {
       return chunkSize;
     }
 
-    void parseChunkHeaders() {
-      // get the absolute end of the file
-      const std::streamoff start = fileStream_.tellg();
-      fileStream_.seekg(0, std::ios::end);
-      const std::streamoff end = fileStream_.tellg();
-      fileStream_.seekg(start, std::ios::beg);
-
-      const std::streamoff header_size = 8;
-
-      while (fileStream_.tellg() + header_size <= end) {
-        auto chunkHeader = parseHeader();
+    /// position after a chunk, including its padding byte
+    uint64_t chunkEnd(const ChunkHeader& header) const {
+      uint64_t size = header.size;
+      if (size % 2 != 0) size = utils::safeAdd<uint64_t>(size, 1u);
+      return utils::safeAdd<uint64_t>(header.position + 8u, size);
+    }
 
-        // determine chunk size, skipping a padding byte
-        std::streamoff chunk_size =
-            utils::safeCast<std::streamoff>(chunkHeader.size);
-        if (chunk_size % 2 != 0)
-          chunk_size = utils::safeAdd<std::streamoff>(chunk_size, 1);
+    void parseChunkHeaders(uint64_t position) {
+      const uint64_t header_size = 8;
 
-        std::streamoff chunk_end =
-            utils::safeAdd<std::streamoff>(fileStream_.tellg(), chunk_size);
+      while (position + header_size <= fileEnd_) {
+        auto chunkHeader = parseHeader(position);
 
-        if (chunk_end > end)
+        position = chunkEnd(chunkHeader);
+        if (position > fileEnd_)
           throw std::runtime_error("chunk ends after end of file");
 
-        fileStream_.seekg(chunk_size, std::ios::cur);
-        if (!fileStream_.good())
-          throw std::runtime_error("file error while seeking past chunk");
-
         chunkHeaders_.push_back(chunkHeader);
       }
     }
 
-    std::ifstream fileStream_;
+    // mutable, as lazily parsed chunks are read by const getters
+    mutable std::ifstream fileStream_;
     uint32_t fileFormat_;
     uint32_t fileSize_;
     uint16_t channelCount_;
@@ -392,8 +1237,57 @@ namespace bw64 {
     uint16_t formatTag_;
     uint16_t bitsPerSample_;
 
-    std::vector<char> rawDataBuffer_;
-    std::vector<std::shared_ptr<Chunk>> chunks_;
+    /// streamFrame_ value if the file position is not a known frame
+    static const uint64_t UNKNOWN_POSITION = UINT64_MAX;
+    /// size after which readRanges stops coalescing ranges into one read
+    static const uint64_t MAX_BATCH_BYTES = 16u << 20;
+
+    // beginning of the file while parsing the header
+    std::vector<char> headerWindow_;
+    utils::MemoryStreamBuf headerWindowBuffer_;
+    std::istream headerWindowStream_{&headerWindowBuffer_};
+    uint64_t fileEnd_{0};
+
+    utils::RawBuffer rawDataBuffer_;
+    bool nonTemporalStores_{false};
+    /// chunk which is parsed on first access
+    struct LazyChunk {
+      ChunkHeader header;
+      ChunkParser parser;
+    };
+    mutable std::vector<std::shared_ptr<Chunk>> chunks_;
+    mutable std::vector<LazyChunk> lazyChunks_;
     std::vector<ChunkHeader> chunkHeaders_;
+    MarkerIndex markers_;
+
+    // current frame, and the frame the file is positioned at
+    uint64_t position_{0};
+    mutable uint64_t streamFrame_{UNKNOWN_POSITION};
+    uint64_t dataStart_{0};
+    uint64_t numberOfFrames_{0};
+
+    // frames buffered for readReverse
+    utils::RawBuffer reverseBuffer_;
+    uint64_t reverseStart_{0};
+    uint64_t reverseFrames_{0};
+    uint64_t reverseReadahead_{65536};
+
+    // loop region and the part of it kept in memory
+    uint64_t loopStart_{0};
+    uint64_t loopEnd_{0};
+    uint64_t loopResidentFrames_{0};
+    std::vector<char> loopBuffer_;
+
+    // shared decoded blocks for read(), and the last block decoded for it
+    static const uint64_t NO_BLOCK = UINT64_MAX;
+    std::shared_ptr<BlockCache> blockCache_;
+    FileIdentity fileIdentity_;
+    std::vector<float> cacheBlock_;
+    uint64_t cacheBlockIndex_{NO_BLOCK};
+
+    // sidecar for readChannel, and whether the default one was looked for
+    std::string filename_;
+    std::unique_ptr<TiledSidecar> tiledSidecar_;
+    bool tiledSidecarChecked_{false};
   };
 }  // namespace bw64
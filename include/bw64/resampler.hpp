@@ -0,0 +1,454 @@
+/**
+ * @file resampler.hpp
+ *
+ * Streaming polyphase sample rate conversion, and reader and writer
+ * adaptors using it.
+ */
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <stdint.h>
+#include <vector>
+#include "pipeline.hpp"
+#include "reader.hpp"
+#include "utils.hpp"
+#include "writer.hpp"
+
+namespace bw64 {
+
+  /**
+   * @brief Streaming polyphase sample rate converter for interleaved frames
+   *
+   * The conversion ratio is reduced to L/M (output/input rate over their
+   * greatest common divisor), and each output frame is computed with one of
+   * L phases of a Kaiser windowed sinc filter. The filter length scales
+   * with the downsampling ratio, so that the cutoff stays below the lower
+   * Nyquist frequency.
+   *
+   * Output frame `j` is aligned with input time `j * M / L`, i.e. the output
+   * is not delayed. Instead, output frames can only be pulled once
+   * latency() input frames beyond them have been pushed; at the end of the
+   * stream, flush() pads the input with silence.
+   *
+   * The inner loop runs over all channels of a frame for each filter tap, so
+   * that the compiler can vectorise across channels.
+   */
+  class Resampler {
+   public:
+    /**
+     * @brief Create a Resampler
+     *
+     * @param inputRate sample rate of the input
+     * @param outputRate sample rate of the output
+     * @param channels number of interleaved channels
+     * @param zeroCrossings number of zero crossings of the sinc on each side;
+     * higher values give a steeper cutoff at higher cost
+     */
+    Resampler(uint32_t inputRate, uint32_t outputRate, uint16_t channels,
+              unsigned zeroCrossings = 16)
+        : channels_(channels) {
+      if (inputRate == 0 || outputRate == 0 || channels == 0 ||
+          zeroCrossings == 0)
+        throw std::runtime_error(
+            "sample rates, channels and zeroCrossings must be > 0");
+      const uint32_t divisor = gcd(inputRate, outputRate);
+      up_ = outputRate / divisor;
+      down_ = inputRate / divisor;
+      makeFilter(zeroCrossings);
+      reset();
+    }
+
+    /// @brief Get number of channels
+    uint16_t channels() const { return channels_; }
+    /// @brief Get the interpolation factor L
+    uint32_t upFactor() const { return up_; }
+    /// @brief Get the decimation factor M
+    uint32_t downFactor() const { return down_; }
+    /// @brief Get number of filter taps per phase
+    uint32_t taps() const { return taps_; }
+
+    /// @brief Number of input frames needed beyond an output frame before it
+    /// can be computed
+    uint64_t latency() const { return taps_ / 2; }
+    /// @brief latency() in seconds of input
+    double latencySeconds(uint32_t inputRate) const {
+      return static_cast<double>(latency()) / inputRate;
+    }
+
+    /// @brief Number of output frames for a number of input frames
+    uint64_t outputFrames(uint64_t inputFrames) const {
+      return (inputFrames * up_ + down_ - 1) / down_;
+    }
+
+    /// @brief Clear all state, as if newly created
+    void reset() {
+      const uint64_t history = taps_ / 2 - 1;
+      buffer_.assign(utils::safeCast<size_t>(history * channels_), 0.f);
+      bufferStart_ = -static_cast<int64_t>(history);
+      inputFrame_ = 0;
+      phase_ = 0;
+    }
+
+    /**
+     * @brief Get space for input frames
+     *
+     * Write up to `frames` frames to the returned pointer, then call
+     * commitInput(); this avoids copying input which is produced in place,
+     * e.g. decoded from a file.
+     */
+    float* prepareInput(uint64_t frames) {
+      discardUsedInput();
+      committed_ = buffer_.size();
+      buffer_.resize(
+          utils::safeCast<size_t>(committed_ + frames * channels_));
+      return buffer_.data() + committed_;
+    }
+
+    /// @brief Commit frames written to the space from prepareInput()
+    void commitInput(uint64_t frames) {
+      buffer_.resize(committed_ + utils::safeCast<size_t>(frames * channels_));
+    }
+
+    /// @brief Add input frames
+    void push(const float* inBuffer, uint64_t frames) {
+      float* space = prepareInput(frames);
+      std::copy(inBuffer, inBuffer + frames * channels_, space);
+      commitInput(frames);
+    }
+
+    /// @brief Add latency() frames of silence, so that all output frames
+    /// aligned with input frames pushed so far can be pulled
+    void flush() {
+      float* space = prepareInput(latency());
+      std::fill(space, space + latency() * channels_, 0.f);
+      commitInput(latency());
+    }
+
+    /// @brief Number of output frames which can be pulled
+    uint64_t available() const {
+      const int64_t end =
+          bufferStart_ + static_cast<int64_t>(buffer_.size() / channels_);
+      // output frames at input frame n need inputs up to n + taps / 2
+      const int64_t lastFrame = end - static_cast<int64_t>(taps_ / 2) - 1;
+      if (lastFrame < static_cast<int64_t>(inputFrame_)) return 0;
+      // frames with input frame in [inputFrame_, lastFrame]
+      const uint64_t inputs = static_cast<uint64_t>(lastFrame) - inputFrame_;
+      return (inputs * up_ + (up_ - phase_) + down_ - 1) / down_;
+    }
+
+    /**
+     * @brief Compute output frames
+     *
+     * @returns number of frames written; at most available()
+     */
+    uint64_t pull(float* outBuffer, uint64_t frames) {
+      frames = std::min(frames, available());
+      const uint32_t halfTaps = taps_ / 2;
+      for (uint64_t j = 0; j < frames; ++j) {
+        const int64_t first =
+            static_cast<int64_t>(inputFrame_) - halfTaps + 1 - bufferStart_;
+        const float* in = buffer_.data() + first * channels_;
+        const float* h = coefficients_.data() + phase_ * taps_;
+        float* out = outBuffer + j * channels_;
+        std::fill(out, out + channels_, 0.f);
+        for (uint32_t t = 0; t < taps_; ++t) {
+          const float coefficient = h[t];
+          const float* x = in + t * channels_;
+          for (uint16_t c = 0; c < channels_; ++c) out[c] += x[c] * coefficient;
+        }
+        phase_ += down_;
+        inputFrame_ += phase_ / up_;
+        phase_ %= up_;
+      }
+      return frames;
+    }
+
+   private:
+    static uint32_t gcd(uint32_t a, uint32_t b) {
+      while (b) {
+        const uint32_t r = a % b;
+        a = b;
+        b = r;
+      }
+      return a;
+    }
+
+    /// zeroth order modified Bessel function of the first kind
+    static double besselI0(double x) {
+      double sum = 1.0, term = 1.0;
+      for (int k = 1; k < 50; ++k) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+        if (term < sum * 1e-12) break;
+      }
+      return sum;
+    }
+
+    void makeFilter(unsigned zeroCrossings) {
+      const double pi = 3.14159265358979323846;
+      const double beta = 8.6;
+      // cutoff relative to the input Nyquist frequency
+      const double cutoff =
+          0.94 * std::min(1.0, static_cast<double>(up_) / down_);
+      const double halfLength = std::ceil(zeroCrossings / cutoff);
+      taps_ = static_cast<uint32_t>(2 * halfLength);
+      coefficients_.resize(static_cast<size_t>(up_) * taps_);
+      for (uint32_t p = 0; p < up_; ++p) {
+        double sum = 0.0;
+        std::vector<double> phase(taps_);
+        for (uint32_t t = 0; t < taps_; ++t) {
+          // distance in input frames from the output time to the tap
+          const double d =
+              static_cast<double>(p) / up_ + halfLength - 1.0 - t;
+          const double r = d / halfLength;
+          double value = 0.0;
+          if (std::abs(r) < 1.0) {
+            const double x = pi * cutoff * d;
+            const double sinc = x == 0.0 ? 1.0 : std::sin(x) / x;
+            value = cutoff * sinc * besselI0(beta * std::sqrt(1.0 - r * r)) /
+                    besselI0(beta);
+          }
+          phase[t] = value;
+          sum += value;
+        }
+        for (uint32_t t = 0; t < taps_; ++t)
+          coefficients_[p * taps_ + t] = static_cast<float>(phase[t] / sum);
+      }
+    }
+
+    /// drop input frames before the first one needed by the next output
+    void discardUsedInput() {
+      const int64_t firstNeeded =
+          static_cast<int64_t>(inputFrame_) - taps_ / 2 + 1;
+      const int64_t unused = firstNeeded - bufferStart_;
+      if (unused <= 0) return;
+      const size_t samples = utils::safeCast<size_t>(unused * channels_);
+      buffer_.erase(buffer_.begin(),
+                    buffer_.begin() + std::min(samples, buffer_.size()));
+      bufferStart_ = firstNeeded;
+    }
+
+    uint16_t channels_;
+    uint32_t up_;
+    uint32_t down_;
+    uint32_t taps_;
+    /// taps_ coefficients per phase
+    std::vector<float> coefficients_;
+
+    /// buffered input frames, starting at input frame bufferStart_
+    std::vector<float> buffer_;
+    int64_t bufferStart_;
+    size_t committed_{0};
+    /// input frame and phase of the next output frame
+    uint64_t inputFrame_;
+    uint32_t phase_;
+  };
+
+  /**
+   * @brief Read a Bw64Reader at another sample rate
+   *
+   * Frames are decoded straight into the input buffer of a Resampler. The
+   * output is aligned with the file: it starts at the first frame, and has
+   * numberOfFrames() frames in total.
+   */
+  class ResamplingReader {
+   public:
+    /**
+     * @brief Create a ResamplingReader
+     *
+     * @param reader file to read from its current position
+     * @param sampleRate output sample rate
+     * @param zeroCrossings filter length; see Resampler
+     * @param blockFrames number of input frames read from the file at once
+     */
+    ResamplingReader(Bw64Reader& reader, uint32_t sampleRate,
+                     unsigned zeroCrossings = 16, uint64_t blockFrames = 4096)
+        : reader_(reader),
+          sampleRate_(sampleRate),
+          resampler_(reader.sampleRate(), sampleRate, reader.channels(),
+                     zeroCrossings),
+          blockFrames_(blockFrames),
+          numberOfFrames_(resampler_.outputFrames(reader.numberOfFrames() -
+                                                  reader.tell())) {
+      if (blockFrames == 0) throw std::runtime_error("blockFrames must be > 0");
+    }
+
+    /// @brief Get number of channels
+    uint16_t channels() const { return reader_.channels(); }
+    /// @brief Get output sample rate
+    uint32_t sampleRate() const { return sampleRate_; }
+    /// @brief Get number of output frames
+    uint64_t numberOfFrames() const { return numberOfFrames_; }
+    /// @brief Get number of output frames read so far
+    uint64_t tell() const { return position_; }
+    /// @brief Check if all output frames have been read
+    bool eof() const { return position_ == numberOfFrames_; }
+    /// @brief Get the number of input frames read ahead of the output
+    uint64_t latency() const { return resampler_.latency(); }
+    /// @brief Get the Resampler
+    const Resampler& resampler() const { return resampler_; }
+
+    /**
+     * @brief Read resampled frames
+     *
+     * @returns number of frames read
+     */
+    uint64_t read(float* outBuffer, uint64_t frames) {
+      frames = std::min(frames, numberOfFrames_ - position_);
+      uint64_t done = 0;
+      while (done < frames) {
+        if (resampler_.available() == 0) fill();
+        done += resampler_.pull(outBuffer + done * channels(), frames - done);
+      }
+      position_ += done;
+      return done;
+    }
+
+   private:
+    void fill() {
+      if (reader_.eof()) {
+        resampler_.flush();
+        return;
+      }
+      float* space = resampler_.prepareInput(blockFrames_);
+      resampler_.commitInput(reader_.read(space, blockFrames_));
+    }
+
+    Bw64Reader& reader_;
+    uint32_t sampleRate_;
+    Resampler resampler_;
+    uint64_t blockFrames_;
+    uint64_t numberOfFrames_;
+    uint64_t position_{0};
+  };
+
+  /**
+   * @brief Write to a Bw64Writer from another sample rate
+   *
+   * Frames are resampled to the sample rate of the writer. Call flush()
+   * after the last write to write the remaining frames, before closing the
+   * writer.
+   */
+  class ResamplingWriter {
+   public:
+    /**
+     * @brief Create a ResamplingWriter
+     *
+     * @param writer file to write to
+     * @param sampleRate sample rate of the frames passed to write()
+     * @param zeroCrossings filter length; see Resampler
+     */
+    ResamplingWriter(Bw64Writer& writer, uint32_t sampleRate,
+                     unsigned zeroCrossings = 16)
+        : writer_(writer),
+          sampleRate_(sampleRate),
+          resampler_(sampleRate, writer.sampleRate(), writer.channels(),
+                     zeroCrossings) {}
+
+    /// @brief Get number of channels
+    uint16_t channels() const { return writer_.channels(); }
+    /// @brief Get input sample rate
+    uint32_t sampleRate() const { return sampleRate_; }
+    /// @brief Get the number of input frames buffered before being written
+    uint64_t latency() const { return resampler_.latency(); }
+
+    /**
+     * @brief Resample and write frames
+     *
+     * @returns number of input frames consumed; always `frames`
+     */
+    uint64_t write(const float* inBuffer, uint64_t frames) {
+      resampler_.push(inBuffer, frames);
+      framesIn_ += frames;
+      writeAvailable(resampler_.outputFrames(framesIn_));
+      return frames;
+    }
+
+    /// @brief Write the frames remaining in the resampler
+    void flush() {
+      resampler_.flush();
+      writeAvailable(resampler_.outputFrames(framesIn_));
+    }
+
+   private:
+    /// write available output, up to a total of `total` frames
+    void writeAvailable(uint64_t total) {
+      const uint64_t frames =
+          std::min(resampler_.available(), total - framesOut_);
+      output_.resize(utils::safeCast<size_t>(frames * channels()));
+      resampler_.pull(output_.data(), frames);
+      writer_.write(output_.data(), frames);
+      framesOut_ += frames;
+    }
+
+    Bw64Writer& writer_;
+    uint32_t sampleRate_;
+    Resampler resampler_;
+    std::vector<float> output_;
+    uint64_t framesIn_{0};
+    uint64_t framesOut_{0};
+  };
+
+  /**
+   * @brief Pipeline stage converting the sample rate of blocks
+   *
+   * Like ResamplingReader, the output is aligned with the input and has
+   * `resampler().outputFrames()` frames for all input frames. Output blocks
+   * are taken from `pool`.
+   */
+  class ResampleBlocks : public BlockSource {
+   public:
+    ResampleBlocks(BlockSource& upstream, uint32_t sampleRate, BlockPool& pool,
+                   unsigned zeroCrossings = 16)
+        : upstream_(upstream),
+          pool_(pool),
+          sampleRate_(sampleRate),
+          resampler_(upstream.sampleRate(), sampleRate, upstream.channels(),
+                     zeroCrossings) {}
+
+    uint16_t channels() const override { return upstream_.channels(); }
+    uint32_t sampleRate() const override { return sampleRate_; }
+    /// input blocks are released before output blocks are acquired
+    size_t poolBlocks() const override { return upstream_.poolBlocks(); }
+    /// @brief Get the Resampler
+    const Resampler& resampler() const { return resampler_; }
+
+    BlockPtr pull() override {
+      while (true) {
+        // after flushing, available() includes frames of the padding
+        const uint64_t n =
+            std::min(resampler_.available(),
+                     resampler_.outputFrames(inputFrames_) - outputFrames_);
+        if (n > 0) {
+          BlockPtr block = pool_.acquire(channels());
+          const uint64_t frames =
+              resampler_.pull(block->data(), std::min(n, block->frames()));
+          block->resize(channels(), frames);
+          outputFrames_ += frames;
+          return block;
+        }
+        if (flushed_) return nullptr;
+        BlockPtr input = upstream_.pull();
+        if (input) {
+          resampler_.push(input->data(), input->frames());
+          inputFrames_ += input->frames();
+        } else {
+          resampler_.flush();
+          flushed_ = true;
+        }
+      }
+    }
+
+   private:
+    BlockSource& upstream_;
+    BlockPool& pool_;
+    uint32_t sampleRate_;
+    Resampler resampler_;
+    uint64_t inputFrames_{0};
+    uint64_t outputFrames_{0};
+    bool flushed_{false};
+  };
+
+}  // namespace bw64
@@ -0,0 +1,394 @@
+/**
+ * @file sampler.hpp
+ *
+ * Batched reading of many short windows from many files, e.g. for training
+ * data loaders.
+ */
+#pragma once
+#include <algorithm>
+#include <deque>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "reader.hpp"
+#include "thread_pool.hpp"
+#include "utils.hpp"
+
+namespace bw64 {
+
+  /// @brief Window of frames to read into a Batch
+  struct WindowRequest {
+    std::string filename;
+    /// first frame of the window
+    uint64_t frame;
+    /// number of frames; at most the window size of the batch
+    uint64_t frames;
+  };
+
+  /// @brief Order of the samples of each window in a Batch
+  enum class BatchLayout {
+    /// `frames x channels`, as in the file
+    interleaved,
+    /// `channels x frames`
+    planar
+  };
+
+  /// @brief Sample format of a Batch
+  enum class BatchFormat {
+    /// 32 bit float
+    float32,
+    /// IEEE 754 half precision, stored as `uint16_t`
+    float16
+  };
+
+  /**
+   * @brief Contiguous buffer holding the windows of one batch
+   *
+   * Window `i` starts at sample `i * channels() * windowFrames()`. Frames of
+   * a window which were not requested, or lie behind the end of its file,
+   * are zero.
+   */
+  class Batch {
+   public:
+    Batch(std::vector<WindowRequest> requests, uint16_t channels,
+          uint64_t windowFrames, BatchLayout layout, BatchFormat format)
+        : requests_(std::move(requests)),
+          framesRead_(requests_.size(), 0),
+          channels_(channels),
+          windowFrames_(windowFrames),
+          layout_(layout),
+          format_(format),
+          bytes_(utils::safeCast<size_t>(requests_.size() * channels *
+                                         windowFrames * sampleSize())),
+          data_(new char[bytes_]()) {}
+
+    /// @brief Get number of windows
+    size_t size() const { return requests_.size(); }
+    /// @brief Get number of channels of each window
+    uint16_t channels() const { return channels_; }
+    /// @brief Get number of frames of each window
+    uint64_t windowFrames() const { return windowFrames_; }
+    /// @brief Get sample layout
+    BatchLayout layout() const { return layout_; }
+    /// @brief Get sample format
+    BatchFormat format() const { return format_; }
+    /// @brief Get size of one sample in bytes
+    size_t sampleSize() const {
+      return format_ == BatchFormat::float32 ? sizeof(float)
+                                             : sizeof(uint16_t);
+    }
+    /// @brief Get size of the whole buffer in bytes
+    size_t bytes() const { return bytes_; }
+
+    /// @brief Get the requests, in the order of the windows
+    const std::vector<WindowRequest>& requests() const { return requests_; }
+    /// @brief Get number of frames read from the file for a window
+    uint64_t framesRead(size_t index) const { return framesRead_.at(index); }
+
+    /// @brief Get the whole buffer
+    void* data() { return data_.get(); }
+    /// @brief Get the whole buffer
+    const void* data() const { return data_.get(); }
+
+    /**
+     * @brief Get the samples of a window
+     *
+     * @tparam T `float` for BatchFormat::float32, `uint16_t` for
+     * BatchFormat::float16
+     */
+    template <typename T>
+    T* window(size_t index) {
+      if (sizeof(T) != sampleSize())
+        throw std::runtime_error("sample type does not match batch format");
+      if (index >= size()) throw std::runtime_error("window out of range");
+      return reinterpret_cast<T*>(data_.get()) +
+             index * channels_ * windowFrames_;
+    }
+
+   private:
+    friend class BatchSampler;
+
+    std::vector<WindowRequest> requests_;
+    std::vector<uint64_t> framesRead_;
+    uint16_t channels_;
+    uint64_t windowFrames_;
+    BatchLayout layout_;
+    BatchFormat format_;
+    size_t bytes_;
+    std::unique_ptr<char[]> data_;
+  };
+
+  /**
+   * @brief Cache of open readers, shared between threads
+   *
+   * A reader is used by one thread at a time: acquire() takes an idle reader
+   * of a file out of the cache, or opens a new one, and release() puts it
+   * back. At most `maxOpenFiles` idle readers are kept; the least recently
+   * used are closed first.
+   */
+  class ReaderCache {
+   public:
+    explicit ReaderCache(size_t maxOpenFiles) : maxOpenFiles_(maxOpenFiles) {}
+
+    /// @brief Take a reader of a file out of the cache, or open it
+    std::unique_ptr<Bw64Reader> acquire(const std::string& filename) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = index_.find(filename);
+        if (found != index_.end()) {
+          std::unique_ptr<Bw64Reader> reader = std::move(found->second->second);
+          idle_.erase(found->second);
+          index_.erase(found);
+          ++hits_;
+          return reader;
+        }
+        ++opened_;
+      }
+      return std::unique_ptr<Bw64Reader>(new Bw64Reader(filename.c_str()));
+    }
+
+    /// @brief Return a reader from acquire() to the cache
+    void release(const std::string& filename,
+                 std::unique_ptr<Bw64Reader> reader) {
+      std::unique_ptr<Bw64Reader> evicted;
+      std::lock_guard<std::mutex> lock(mutex_);
+      idle_.emplace_front(filename, std::move(reader));
+      index_.emplace(filename, idle_.begin());
+      if (idle_.size() > maxOpenFiles_) {
+        auto last = std::prev(idle_.end());
+        auto range = index_.equal_range(last->first);
+        for (auto it = range.first; it != range.second; ++it) {
+          if (it->second == last) {
+            index_.erase(it);
+            break;
+          }
+        }
+        evicted = std::move(last->second);
+        idle_.erase(last);
+      }
+    }
+
+    /// @brief Get number of idle open readers
+    size_t size() const {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return idle_.size();
+    }
+    /// @brief Get number of files opened so far
+    uint64_t opened() const {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return opened_;
+    }
+    /// @brief Get number of acquire() calls served by an open reader
+    uint64_t hits() const {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return hits_;
+    }
+
+   private:
+    using Entry = std::pair<std::string, std::unique_ptr<Bw64Reader>>;
+
+    size_t maxOpenFiles_;
+    mutable std::mutex mutex_;
+    /// idle readers, most recently used first
+    std::list<Entry> idle_;
+    std::unordered_multimap<std::string, std::list<Entry>::iterator> index_;
+    uint64_t opened_{0};
+    uint64_t hits_{0};
+  };
+
+  /**
+   * @brief Read batches of windows from many files on a thread pool
+   *
+   * The windows of a batch are grouped by file, and each group is read by
+   * one task with a reader from a ReaderCache, so that files stay open
+   * between batches. Samples are decoded straight into the Batch buffer; for
+   * interleaved float batches, neighbouring windows of a file are fetched
+   * with a single read (see Bw64Reader::readRanges()).
+   *
+   * submit() returns immediately, and next() waits for the oldest submitted
+   * batch. Submitting the following batch before calling next() therefore
+   * prefetches it while the current one is consumed.
+   */
+  class BatchSampler {
+   public:
+    /**
+     * @brief Create a BatchSampler
+     *
+     * @param channels number of channels; all files must have this many
+     * @param windowFrames number of frames of each window in a batch
+     * @param layout sample layout of batches
+     * @param format sample format of batches
+     * @param threads number of reading threads
+     * @param maxOpenFiles number of idle readers kept open
+     */
+    BatchSampler(uint16_t channels, uint64_t windowFrames,
+                 BatchLayout layout = BatchLayout::interleaved,
+                 BatchFormat format = BatchFormat::float32,
+                 size_t threads = std::thread::hardware_concurrency(),
+                 size_t maxOpenFiles = 256)
+        : channels_(channels),
+          windowFrames_(windowFrames),
+          layout_(layout),
+          format_(format),
+          cache_(maxOpenFiles),
+          pool_(threads) {
+      if (channels == 0 || windowFrames == 0)
+        throw std::runtime_error("channels and windowFrames must be > 0");
+    }
+
+    /// @brief Get number of channels
+    uint16_t channels() const { return channels_; }
+    /// @brief Get number of frames per window
+    uint64_t windowFrames() const { return windowFrames_; }
+    /// @brief Get number of submitted batches not yet returned by next()
+    size_t pending() const { return pending_.size(); }
+    /// @brief Get the reader cache
+    const ReaderCache& cache() const { return cache_; }
+
+    /// @brief Start reading a batch
+    void submit(std::vector<WindowRequest> requests) {
+      for (const WindowRequest& request : requests) {
+        if (request.frames > windowFrames_) {
+          std::stringstream errorString;
+          errorString << "window of " << request.frames
+                      << " frames is larger than the batch window of "
+                      << windowFrames_ << " frames";
+          throw std::runtime_error(errorString.str());
+        }
+      }
+
+      Pending pending;
+      pending.batch.reset(new Batch(std::move(requests), channels_,
+                                    windowFrames_, layout_, format_));
+      std::map<std::string, std::vector<size_t>> groups;
+      const std::vector<WindowRequest>& all = pending.batch->requests();
+      for (size_t i = 0; i < all.size(); ++i)
+        groups[all[i].filename].push_back(i);
+
+      Batch* batch = pending.batch.get();
+      for (auto& group : groups) {
+        auto windows = std::make_shared<std::vector<size_t>>(
+            std::move(group.second));
+        const std::string& filename = all[windows->front()].filename;
+        pending.tasks.push_back(
+            pool_.submit([this, batch, filename, windows]() {
+              readGroup(*batch, filename, *windows);
+            }));
+      }
+      pending_.push_back(std::move(pending));
+    }
+
+    /**
+     * @brief Get the oldest submitted batch, waiting for it to be read
+     *
+     * Throws the first error encountered while reading the batch.
+     */
+    Batch next() {
+      if (pending_.empty()) throw std::runtime_error("no batch submitted");
+      Pending pending = std::move(pending_.front());
+      pending_.pop_front();
+      // wait for all tasks before throwing, as they write to the batch
+      for (auto& task : pending.tasks) task.wait();
+      for (auto& task : pending.tasks) task.get();
+      return std::move(*pending.batch);
+    }
+
+    /// @brief Read a batch; no other batches may be pending
+    Batch read(std::vector<WindowRequest> requests) {
+      if (!pending_.empty())
+        throw std::runtime_error("read() called with batches pending");
+      submit(std::move(requests));
+      return next();
+    }
+
+   private:
+    struct Pending {
+      std::unique_ptr<Batch> batch;
+      std::vector<std::future<void>> tasks;
+    };
+
+    void readGroup(Batch& batch, const std::string& filename,
+                   const std::vector<size_t>& windows) {
+      std::unique_ptr<Bw64Reader> reader = cache_.acquire(filename);
+      if (reader->channels() != channels_) {
+        std::stringstream errorString;
+        errorString << filename << " has " << reader->channels()
+                    << " channels, expected " << channels_;
+        throw std::runtime_error(errorString.str());
+      }
+
+      const uint64_t windowSamples = channels_ * windowFrames_;
+      if (layout_ == BatchLayout::interleaved &&
+          format_ == BatchFormat::float32) {
+        std::vector<FrameRange<float>> ranges;
+        ranges.reserve(windows.size());
+        for (size_t i : windows) {
+          const WindowRequest& request = batch.requests_[i];
+          ranges.push_back({request.frame, request.frames,
+                            batch.window<float>(i)});
+        }
+        reader->readRanges(ranges);
+        for (size_t i : windows)
+          batch.framesRead_[i] = available(*reader, batch.requests_[i]);
+      } else if (format_ == BatchFormat::float32) {
+        std::vector<float*> channels(channels_);
+        for (size_t i : windows) {
+          float* window = batch.window<float>(i);
+          for (uint16_t c = 0; c < channels_; ++c)
+            channels[c] = window + c * windowFrames_;
+          reader->seek(utils::safeCast<int64_t>(
+              std::min(batch.requests_[i].frame, reader->numberOfFrames())));
+          batch.framesRead_[i] =
+              reader->readPlanar(channels.data(), batch.requests_[i].frames);
+        }
+      } else {
+        std::vector<float> decoded(utils::safeCast<size_t>(windowSamples));
+        for (size_t i : windows) {
+          reader->seek(utils::safeCast<int64_t>(
+              std::min(batch.requests_[i].frame, reader->numberOfFrames())));
+          const uint64_t frames =
+              reader->read(decoded.data(), batch.requests_[i].frames);
+          batch.framesRead_[i] = frames;
+          uint16_t* window = batch.window<uint16_t>(i);
+          if (layout_ == BatchLayout::interleaved) {
+            for (uint64_t s = 0; s < frames * channels_; ++s)
+              window[s] = utils::floatToHalf(decoded[s]);
+          } else {
+            for (uint64_t f = 0; f < frames; ++f)
+              for (uint16_t c = 0; c < channels_; ++c)
+                window[c * windowFrames_ + f] =
+                    utils::floatToHalf(decoded[f * channels_ + c]);
+          }
+        }
+      }
+      cache_.release(filename, std::move(reader));
+    }
+
+    /// number of frames of a window within the file
+    static uint64_t available(const Bw64Reader& reader,
+                              const WindowRequest& request) {
+      if (request.frame >= reader.numberOfFrames()) return 0;
+      return std::min(request.frames, reader.numberOfFrames() - request.frame);
+    }
+
+    uint16_t channels_;
+    uint64_t windowFrames_;
+    BatchLayout layout_;
+    BatchFormat format_;
+    ReaderCache cache_;
+    std::deque<Pending> pending_;
+    // declared last, so that running tasks finish before the batches and the
+    // cache are destroyed
+    ThreadPool pool_;
+  };
+
+}  // namespace bw64
@@ -0,0 +1,363 @@
+/**
+ * @file shared_cache.hpp
+ *
+ * Cache of decoded blocks in POSIX shared memory, shared by all processes on
+ * a host which open it by the same name.
+ */
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "block_cache.hpp"
+
+namespace bw64 {
+
+  /**
+   * @brief Cache of decoded blocks in POSIX shared memory
+   *
+   * All processes which construct a SharedBlockCache with the same name use
+   * the same cache, so a block decoded by one of them can be read by all of
+   * them. The first process creates the shared memory object with room for
+   * `budgetBytes / blockBytes` blocks; later processes use its geometry and
+   * ignore their own. The object is only accessible to the same user, and
+   * persists until remove() is called or the host restarts.
+   *
+   * Blocks are stored in a fixed set of slots. A block may be in one of
+   * probeSlots() slots chosen by hashing its file identity and index; when
+   * inserting, the least recently used of these is replaced. Every slot is
+   * protected by a sequence number instead of a lock: writers claim a slot
+   * by making its sequence number odd with a compare-and-swap, and readers
+   * copy the block and then check that the sequence number did not change.
+   * Neither ever waits for the other, so a process which stops or crashes
+   * while using the cache cannot block the other processes; a crash while
+   * writing a block only leaves that slot unusable.
+   *
+   * See Bw64Reader::useBlockCache().
+   */
+  class SharedBlockCache : public BlockCache {
+   public:
+    /**
+     * @brief Open or create a shared cache
+     *
+     * @param name        name of the shared memory object; must start with a
+     * slash, e.g. `/bw64-cache`
+     * @param budgetBytes total size of the cached blocks, if creating the
+     * cache
+     * @param blockBytes  size of each block, if creating the cache; rounded
+     * up to a multiple of 64
+     */
+    explicit SharedBlockCache(const std::string& name,
+                              uint64_t budgetBytes = uint64_t{256} << 20,
+                              size_t blockBytes = size_t{1} << 20)
+        : name_(name) {
+      if (name.size() < 2 || name[0] != '/')
+        throw std::runtime_error("shared cache names must start with '/'");
+      if (blockBytes == 0 || blockBytes > (size_t{1} << 30))
+        throw std::runtime_error("invalid shared cache block size");
+      blockBytes = (blockBytes + 63) & ~size_t{63};
+      if (!std::atomic<uint64_t>{0}.is_lock_free())
+        throw std::runtime_error("shared cache needs lock-free atomics");
+
+      int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+      if (fd >= 0) {
+        created_ = true;
+        const uint64_t slots = std::max<uint64_t>(budgetBytes / blockBytes, 1);
+        create(fd, slots, blockBytes);
+      } else if (errno == EEXIST) {
+        fd = shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0) throwError("could not open shared cache");
+        attach(fd);
+      } else {
+        throwError("could not create shared cache");
+      }
+    }
+
+    SharedBlockCache(const SharedBlockCache&) = delete;
+    SharedBlockCache& operator=(const SharedBlockCache&) = delete;
+
+    ~SharedBlockCache() {
+      if (mapping_) munmap(mapping_, mappingBytes_);
+    }
+
+    /**
+     * @brief Remove a shared cache by name
+     *
+     * Processes which have it open can keep using it; processes which open
+     * it afterwards create a new one.
+     *
+     * @returns false if there was no cache with this name
+     */
+    static bool remove(const std::string& name) {
+      return shm_unlink(name.c_str()) == 0;
+    }
+
+    /// @brief Number of slots a block may be stored in
+    static size_t probeSlots() { return 4; }
+
+    /// @brief Get the name of the shared memory object
+    const std::string& name() const { return name_; }
+    /// @brief Check if this object created the shared memory object
+    bool created() const { return created_; }
+    /// @brief Get the number of slots
+    uint64_t slots() const { return header_->slots; }
+    size_t blockBytes() const override {
+      return static_cast<size_t>(header_->blockBytes);
+    }
+
+    /// @brief Get the number of lookups in this process which were found
+    uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+    /// @brief Get the number of lookups in this process which were not found
+    uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+    /// @brief Identify a file by device, inode, size and modification time
+    FileIdentity identify(const std::string& filename) override {
+      struct stat status;
+      if (stat(filename.c_str(), &status) != 0)
+        throwError("could not identify " + filename);
+      FileIdentity file;
+      file.device = static_cast<uint64_t>(status.st_dev);
+      file.inode = static_cast<uint64_t>(status.st_ino);
+      file.size = static_cast<uint64_t>(status.st_size);
+      file.modified = static_cast<uint64_t>(status.st_mtime) * 1000000000u;
+#if defined(__APPLE__)
+      file.modified += static_cast<uint64_t>(status.st_mtimespec.tv_nsec);
+#elif defined(__linux__)
+      file.modified += static_cast<uint64_t>(status.st_mtim.tv_nsec);
+#endif
+      return file;
+    }
+
+    bool lookup(const FileIdentity& file, uint64_t block, size_t size,
+                size_t offset, size_t bytes, void* out) override {
+      if (size == 0 || size > blockBytes() || offset > size ||
+          bytes > size - offset)
+        return false;
+      const uint64_t first = firstSlot(file, block);
+      for (size_t p = 0; p < probeSlots(); ++p) {
+        const uint64_t index = (first + p) % slots();
+        Slot& slot = slot_[index];
+        const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence % 2 != 0 || !slot.holds(file, block, size)) continue;
+        std::memcpy(out, data(index) + offset, bytes);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // replaced while copying
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+          continue;
+        slot.lastUse.store(tick(), std::memory_order_relaxed);
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+      misses_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    void insert(const FileIdentity& file, uint64_t block, const void* in,
+                size_t size) override {
+      if (size == 0 || size > blockBytes()) return;
+      const uint64_t first = firstSlot(file, block);
+      uint64_t victim = 0;
+      uint64_t victimSequence = 1;
+      uint64_t oldest = (std::numeric_limits<uint64_t>::max)();
+      for (size_t p = 0; p < probeSlots(); ++p) {
+        const uint64_t index = (first + p) % slots();
+        Slot& slot = slot_[index];
+        const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence % 2 != 0) continue;
+        if (slot.holds(file, block, size)) return;
+        const uint64_t lastUse = slot.lastUse.load(std::memory_order_relaxed);
+        if (lastUse < oldest) {
+          oldest = lastUse;
+          victim = index;
+          victimSequence = sequence;
+        }
+      }
+      // all candidate slots are being written
+      if (victimSequence % 2 != 0) return;
+
+      Slot& slot = slot_[victim];
+      if (!slot.sequence.compare_exchange_strong(victimSequence,
+                                                 victimSequence + 1,
+                                                 std::memory_order_acq_rel,
+                                                 std::memory_order_relaxed))
+        return;
+      slot.file = file;
+      slot.block = block;
+      slot.size = size;
+      std::memcpy(data(victim), in, size);
+      slot.lastUse.store(tick(), std::memory_order_relaxed);
+      slot.sequence.store(victimSequence + 2, std::memory_order_release);
+    }
+
+   private:
+    /// start of the shared memory object
+    struct Header {
+      char magic[8];
+      uint32_t version;
+      std::atomic<uint32_t> ready;
+      uint64_t slots;
+      uint64_t blockBytes;
+      std::atomic<uint64_t> clock;
+    };
+
+    /// key and state of one block; the key is written by the holder of an
+    /// odd sequence number, and only trusted by readers if the sequence
+    /// number is unchanged after reading the block
+    struct Slot {
+      std::atomic<uint64_t> sequence;
+      std::atomic<uint64_t> lastUse;
+      FileIdentity file;
+      uint64_t block;
+      uint64_t size;
+
+      bool holds(const FileIdentity& f, uint64_t b, uint64_t s) const {
+        return size == s && block == b && file == f;
+      }
+    };
+
+    static uint64_t headerBytes() {
+      static_assert(sizeof(Header) <= 64, "header must fit in 64 bytes");
+      static_assert(sizeof(Slot) % 8 == 0, "slots must be 8 byte aligned");
+      return 64;
+    }
+    static uint64_t mappingSize(uint64_t slots, uint64_t blockBytes) {
+      return headerBytes() + slots * (sizeof(Slot) + blockBytes);
+    }
+
+    void create(int fd, uint64_t slots, uint64_t blockBytes) {
+      const uint64_t size = mappingSize(slots, blockBytes);
+      if (size / (sizeof(Slot) + blockBytes) < slots ||
+          ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        const int error = errno;
+        close(fd);
+        remove(name_);
+        errno = error;
+        throwError("could not size shared cache");
+      }
+      try {
+        map(fd, size);
+      } catch (...) {
+        remove(name_);
+        throw;
+      }
+
+      header_ = new (mapping_) Header;
+      std::memcpy(header_->magic, "BW64SHMC", 8);
+      header_->version = 1;
+      header_->slots = slots;
+      header_->blockBytes = blockBytes;
+      header_->clock.store(0, std::memory_order_relaxed);
+      slot_ = reinterpret_cast<Slot*>(mapping_ + headerBytes());
+      for (uint64_t i = 0; i < slots; ++i) {
+        Slot* slot = new (&slot_[i]) Slot;
+        slot->sequence.store(0, std::memory_order_relaxed);
+        slot->lastUse.store(0, std::memory_order_relaxed);
+        slot->block = 0;
+        slot->size = 0;
+      }
+      header_->ready.store(1, std::memory_order_release);
+    }
+
+    void attach(int fd) {
+      // the creator may not have sized or initialised it yet
+      struct stat status;
+      for (int attempt = 0;; ++attempt) {
+        if (fstat(fd, &status) != 0) {
+          close(fd);
+          throwError("could not open shared cache");
+        }
+        if (status.st_size != 0) break;
+        waitForCreator(fd, attempt);
+      }
+      map(fd, static_cast<uint64_t>(status.st_size));
+      header_ = reinterpret_cast<Header*>(mapping_);
+      for (int attempt = 0;
+           header_->ready.load(std::memory_order_acquire) != 1; ++attempt)
+        waitForCreator(-1, attempt);
+
+      slot_ = reinterpret_cast<Slot*>(mapping_ + headerBytes());
+      if (std::memcmp(header_->magic, "BW64SHMC", 8) != 0 ||
+          header_->version != 1 || header_->slots == 0 ||
+          header_->blockBytes == 0 ||
+          mappingSize(header_->slots, header_->blockBytes) != mappingBytes_) {
+        std::stringstream errorString;
+        errorString << name_ << " is not a compatible shared cache";
+        throw std::runtime_error(errorString.str());
+      }
+    }
+
+    void waitForCreator(int fd, int attempt) {
+      if (attempt == 1000) {
+        if (fd >= 0) close(fd);
+        std::stringstream errorString;
+        errorString << "shared cache " << name_ << " was not initialised";
+        throw std::runtime_error(errorString.str());
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    /// map the object, and close fd
+    void map(int fd, uint64_t size) {
+      void* mapping = mmap(nullptr, static_cast<size_t>(size),
+                           PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      const int error = errno;
+      close(fd);
+      if (mapping == MAP_FAILED) {
+        errno = error;
+        throwError("could not map shared cache");
+      }
+      mapping_ = static_cast<char*>(mapping);
+      mappingBytes_ = size;
+    }
+
+    char* data(uint64_t slot) const {
+      return mapping_ + headerBytes() + slots() * sizeof(Slot) +
+             slot * header_->blockBytes;
+    }
+
+    uint64_t firstSlot(const FileIdentity& file, uint64_t block) const {
+      uint64_t hash = block;
+      for (uint64_t value :
+           {file.device, file.inode, file.size, file.modified}) {
+        hash ^= value + 0x9e3779b97f4a7c15u + (hash << 6) + (hash >> 2);
+      }
+      // finalise, so that neighbouring blocks spread over the slots
+      hash ^= hash >> 33;
+      hash *= 0xff51afd7ed558ccdu;
+      hash ^= hash >> 33;
+      return hash % slots();
+    }
+
+    uint64_t tick() {
+      return header_->clock.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    void throwError(const std::string& message) const {
+      std::stringstream errorString;
+      errorString << message << " (" << name_ << "): " << std::strerror(errno);
+      throw std::runtime_error(errorString.str());
+    }
+
+    std::string name_;
+    bool created_{false};
+    char* mapping_{nullptr};
+    uint64_t mappingBytes_{0};
+    Header* header_{nullptr};
+    Slot* slot_{nullptr};
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+  };
+
+}  // namespace bw64
@@ -0,0 +1,296 @@
+/**
+ * @file stems.hpp
+ *
+ * Reading a group of files in lockstep, e.g. the stems of a mix.
+ */
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <ios>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "reader.hpp"
+#include "utils.hpp"
+
+namespace bw64 {
+
+  /**
+   * @brief Read the same frames from a group of files
+   *
+   * The files are opened once, and must have the same sample rate; their bit
+   * depths and lengths may differ. The channels of all files are combined in
+   * file order, so the channels of file `i` start at channelOffset(i). Files
+   * shorter than numberOfFrames() read as silence after their end.
+   *
+   * Each read() or readPlanar() reads all files in parallel and decodes them
+   * straight into the combined output buffer. The reading threads are started
+   * once and take files from a shared counter, and the buffers for encoded
+   * frames are kept between reads, so that reading does not allocate once the
+   * largest read has been made.
+   */
+  class StemReader {
+   public:
+    /**
+     * @brief Open a group of files
+     *
+     * @param filenames files to read, in channel order
+     * @param threads number of reading threads, including the thread calling
+     * read(); 0 to use one per file
+     */
+    explicit StemReader(const std::vector<std::string>& filenames,
+                        size_t threads = 0) {
+      if (filenames.empty()) throw std::runtime_error("no files given");
+      for (const std::string& filename : filenames) {
+        Stem stem;
+        stem.reader.reset(new Bw64Reader(filename.c_str()));
+        if (!stems_.empty() &&
+            stem.reader->sampleRate() != stems_.front().reader->sampleRate()) {
+          std::stringstream errorString;
+          errorString << filename << " has a sample rate of "
+                      << stem.reader->sampleRate() << " Hz, expected "
+                      << stems_.front().reader->sampleRate() << " Hz";
+          throw std::runtime_error(errorString.str());
+        }
+        if (channels_ + stem.reader->channels() >
+            (std::numeric_limits<uint16_t>::max)())
+          throw std::runtime_error("too many channels");
+        stem.channelOffset = channels_;
+        channels_ = static_cast<uint16_t>(channels_ + stem.reader->channels());
+        numberOfFrames_ =
+            std::max(numberOfFrames_, stem.reader->numberOfFrames());
+        stems_.push_back(std::move(stem));
+      }
+      if (threads == 0) threads = stems_.size();
+      for (size_t i = 1; i < threads; ++i)
+        workers_.emplace_back(&StemReader::run, this);
+    }
+
+    StemReader(const StemReader&) = delete;
+    StemReader& operator=(const StemReader&) = delete;
+
+    /// stop the reading threads
+    ~StemReader() {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+      }
+      wakeup_.notify_all();
+      for (auto& worker : workers_) worker.join();
+    }
+
+    /// @brief Get number of files
+    size_t size() const { return stems_.size(); }
+    /// @brief Get the reader of a file
+    const Bw64Reader& reader(size_t stem) const {
+      return *stems_.at(stem).reader;
+    }
+    /// @brief Get the first combined channel of a file
+    uint16_t channelOffset(size_t stem) const {
+      return stems_.at(stem).channelOffset;
+    }
+
+    /// @brief Get total number of channels
+    uint16_t channels() const { return channels_; }
+    /// @brief Get sample rate
+    uint32_t sampleRate() const { return stems_.front().reader->sampleRate(); }
+    /// @brief Get number of frames of the longest file
+    uint64_t numberOfFrames() const { return numberOfFrames_; }
+    /// @brief Tell the current frame position
+    uint64_t tell() const { return position_; }
+    /// @brief Check if the end of the longest file is reached
+    bool eof() const { return position_ == numberOfFrames_; }
+
+    /// @brief Seek a frame position; clamped to [0, numberOfFrames()]
+    void seek(int64_t offset, std::ios_base::seekdir way = std::ios::beg) {
+      int64_t start = 0;
+      if (way == std::ios::cur)
+        start = utils::safeCast<int64_t>(position_);
+      else if (way == std::ios::end)
+        start = utils::safeCast<int64_t>(numberOfFrames_);
+      int64_t frame;
+      if (offset > (std::numeric_limits<int64_t>::max)() - start)
+        frame = utils::safeCast<int64_t>(numberOfFrames_);
+      else
+        frame = std::max<int64_t>(start + offset, 0);
+      position_ = std::min(static_cast<uint64_t>(frame), numberOfFrames_);
+    }
+
+    /**
+     * @brief Read interleaved frames of all channels
+     *
+     * @param[out] outBuffer buffer for `frames * channels()` samples
+     * @param[in]  frames    number of frames to read
+     *
+     * @returns number of frames read
+     */
+    template <typename T, typename std::enable_if<
+                              std::is_floating_point<T>::value, int>::type = 0>
+    uint64_t read(T* outBuffer, uint64_t frames) {
+      frames = std::min(frames, numberOfFrames_ - position_);
+      forEachStem(frames, [this, outBuffer](Stem& stem, uint64_t available,
+                                           uint64_t total) {
+        T* out = outBuffer + stem.channelOffset;
+        utils::decodePcmFramesStrided(stem.raw.get(), out, available,
+                                      stem.reader->channels(), channels_,
+                                      stem.reader->bitDepth());
+        for (uint64_t f = available; f < total; ++f)
+          std::fill(out + f * channels_,
+                    out + f * channels_ + stem.reader->channels(), T{0});
+      });
+      return frames;
+    }
+
+    /**
+     * @brief Read frames of all channels into one buffer per channel
+     *
+     * @param[out] outBuffers channels() buffers of at least `frames` samples
+     * @param[in]  frames     number of frames to read
+     *
+     * @returns number of frames read
+     */
+    template <typename T, typename std::enable_if<
+                              std::is_floating_point<T>::value, int>::type = 0>
+    uint64_t readPlanar(T* const* outBuffers, uint64_t frames) {
+      frames = std::min(frames, numberOfFrames_ - position_);
+      forEachStem(frames, [outBuffers](Stem& stem, uint64_t available,
+                                       uint64_t total) {
+        T* const* out = outBuffers + stem.channelOffset;
+        utils::decodePcmFramesPlanar(stem.raw.get(), out, available,
+                                     stem.reader->channels(),
+                                     stem.reader->bitDepth());
+        for (uint16_t c = 0; c < stem.reader->channels(); ++c)
+          std::fill(out[c] + available, out[c] + total, T{0});
+      });
+      return frames;
+    }
+
+   private:
+    struct Stem {
+      std::unique_ptr<Bw64Reader> reader;
+      uint16_t channelOffset = 0;
+      /// encoded frames; only grows
+      std::unique_ptr<char[]> raw;
+      size_t rawSize = 0;
+      std::exception_ptr error;
+    };
+
+    /// the read in progress; written by the calling thread before a new
+    /// generation is started, and only read by the reading threads
+    struct Job {
+      uint64_t position;
+      uint64_t frames;
+      void (*decode)(void* context, Stem& stem, uint64_t available,
+                     uint64_t total);
+      void* context;
+    };
+
+    template <typename Decode>
+    static void callDecode(void* context, Stem& stem, uint64_t available,
+                           uint64_t total) {
+      (*static_cast<Decode*>(context))(stem, available, total);
+    }
+
+    /// read `frames` frames of every stem in parallel, and call
+    /// `decode(stem, available, frames)` on the reading thread
+    template <typename Decode>
+    void forEachStem(uint64_t frames, Decode decode) {
+      job_ = Job{position_, frames, &callDecode<Decode>, &decode};
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        nextStem_ = 0;
+        remaining_ = stems_.size();
+        ++generation_;
+      }
+      wakeup_.notify_all();
+      readStems();
+      {
+        // wait for all stems before throwing, as they write to the output
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this]() { return remaining_ == 0; });
+      }
+
+      std::exception_ptr error;
+      for (Stem& stem : stems_) {
+        if (!error) error = stem.error;
+        stem.error = nullptr;
+      }
+      if (error) std::rethrow_exception(error);
+      position_ += frames;
+    }
+
+    /// read stems of the current job until none are left
+    void readStems() {
+      for (size_t i = nextStem_++; i < stems_.size(); i = nextStem_++) {
+        Stem& stem = stems_[i];
+        try {
+          readStem(stem);
+        } catch (...) {
+          stem.error = std::current_exception();
+        }
+        if (--remaining_ == 0) {
+          std::lock_guard<std::mutex> lock(mutex_);
+          done_.notify_one();
+        }
+      }
+    }
+
+    void readStem(Stem& stem) {
+      Bw64Reader& reader = *stem.reader;
+      const uint64_t available =
+          job_.position < reader.numberOfFrames()
+              ? std::min(job_.frames, reader.numberOfFrames() - job_.position)
+              : 0;
+      const size_t size =
+          utils::safeCast<size_t>(available * reader.blockAlignment());
+      if (size > stem.rawSize) {
+        stem.raw.reset(new char[size]);
+        stem.rawSize = size;
+      }
+      if (available) {
+        reader.seek(utils::safeCast<int64_t>(job_.position));
+        reader.readRaw(stem.raw.get(), available);
+      }
+      job_.decode(job_.context, stem, available, job_.frames);
+    }
+
+    void run() {
+      uint64_t generation = 0;
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (true) {
+        wakeup_.wait(lock, [this, generation]() {
+          return stop_ || generation_ != generation;
+        });
+        if (stop_) return;
+        generation = generation_;
+        lock.unlock();
+        readStems();
+        lock.lock();
+      }
+    }
+
+    std::vector<Stem> stems_;
+    uint16_t channels_{0};
+    uint64_t numberOfFrames_{0};
+    uint64_t position_{0};
+
+    Job job_{};
+    std::atomic<size_t> nextStem_{0};
+    std::atomic<size_t> remaining_{0};
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::condition_variable done_;
+    uint64_t generation_{0};
+    bool stop_{false};
+    std::vector<std::thread> workers_;
+  };
+
+}  // namespace bw64
@@ -0,0 +1,427 @@
+/**
+ * @file streaming.hpp
+ *
+ * Disk streaming engine for many concurrent voices.
+ */
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "reader.hpp"
+
+namespace bw64 {
+
+  class StreamingEngine;
+
+  /**
+   * @brief One voice which is streamed from disk by a StreamingEngine
+   *
+   * Each voice owns a ring buffer of decoded, interleaved frames. The ring
+   * buffer is filled by the I/O threads of the engine and drained by read(),
+   * which never blocks, allocates or touches the file, so it can be called from
+   * an audio thread. Once read() has freed enough of the ring buffer, it hands
+   * the voice to the engine with a lock-free push, so that the engine does not
+   * have to look at voices which don't need a refill.
+   *
+   * Voices are created with StreamingEngine::addVoice().
+   */
+  class StreamingVoice {
+   public:
+    StreamingVoice(const StreamingVoice&) = delete;
+    StreamingVoice& operator=(const StreamingVoice&) = delete;
+
+    /// @brief Get number of channels
+    uint16_t channels() const { return channels_; }
+    /// @brief Get sample rate
+    uint32_t sampleRate() const { return sampleRate_; }
+    /// @brief Get capacity of the ring buffer in frames
+    uint64_t bufferFrames() const { return capacity_; }
+    /// @brief Get number of decoded frames waiting in the ring buffer
+    uint64_t bufferedFrames() const { return written_.load() - read_.load(); }
+    /// @brief Time in seconds until this voice underruns if it is not refilled
+    double underrunMargin() const {
+      return static_cast<double>(bufferedFrames()) / sampleRate_;
+    }
+    /// @brief Lowest number of buffered frames seen by read() so far
+    uint64_t minimumBufferedFrames() const { return minimumBuffered_.load(); }
+    /// @brief Number of read() calls which could not be served completely
+    /// before the end of the file
+    uint64_t underruns() const { return underruns_.load(); }
+    /// @brief Check if the end of the file has been reached by the I/O threads
+    bool endOfFile() const { return endOfFile_.load(); }
+    /// @brief Check if all frames of the file have been read
+    bool finished() const { return endOfFile() && bufferedFrames() == 0; }
+    /// @brief Check if reading from the file failed
+    ///
+    /// A failed voice is treated like a voice at the end of its file.
+    bool failed() const { return failed_.load(); }
+
+    /**
+     * @brief Read frames from the ring buffer
+     *
+     * If less than `frames` frames are buffered, the remainder of `outBuffer`
+     * is filled with silence. This counts as an underrun, unless the end of
+     * the file has been reached.
+     *
+     * @param[out] outBuffer Buffer to write the interleaved samples to
+     * @param[in]  frames    Number of frames to read
+     *
+     * @returns number of frames read from the file
+     */
+    uint64_t read(float* outBuffer, uint64_t frames) {
+      const bool endOfFile = endOfFile_.load();
+      const uint64_t readPos = read_.load(std::memory_order_relaxed);
+      const uint64_t available = written_.load() - readPos;
+      if (available < minimumBuffered_.load(std::memory_order_relaxed)) {
+        minimumBuffered_.store(available, std::memory_order_relaxed);
+      }
+
+      const uint64_t n = std::min(frames, available);
+      uint64_t done = 0;
+      while (done < n) {
+        const uint64_t pos = (readPos + done) % capacity_;
+        const uint64_t chunk = std::min(n - done, capacity_ - pos);
+        std::copy(&buffer_[pos * channels_],
+                  &buffer_[(pos + chunk) * channels_],
+                  outBuffer + done * channels_);
+        done += chunk;
+      }
+      read_.store(readPos + n);
+      if (needsFill()) requestFill();
+
+      if (n < frames) {
+        std::fill(outBuffer + n * channels_, outBuffer + frames * channels_,
+                  0.f);
+        if (!endOfFile) ++underruns_;
+      }
+      return n;
+    }
+
+   private:
+    friend class StreamingEngine;
+
+    StreamingVoice(std::unique_ptr<Bw64Reader> reader, uint64_t capacity,
+                   uint64_t minimumReadFrames,
+                   std::shared_ptr<std::atomic<StreamingVoice*>> pending)
+        : reader_(std::move(reader)),
+          channels_(reader_->channels()),
+          sampleRate_(reader_->sampleRate()),
+          capacity_(capacity),
+          minimumReadFrames_(minimumReadFrames),
+          pending_(std::move(pending)),
+          nextPending_(nullptr),
+          buffer_(utils::safeCast<size_t>(capacity * channels_)),
+          written_(0),
+          read_(0),
+          minimumBuffered_((std::numeric_limits<uint64_t>::max)()),
+          underruns_(0),
+          endOfFile_(reader_->eof()),
+          failed_(false),
+          queued_(false),
+          removed_(false) {}
+
+    uint64_t freeFrames() const { return capacity_ - bufferedFrames(); }
+
+    bool needsFill() const {
+      return !endOfFile() && freeFrames() >= minimumReadFrames_;
+    }
+
+    /// take the right to queue this voice; false if it is already queued
+    bool takeQueued() {
+      bool expected = false;
+      return queued_.compare_exchange_strong(expected, true);
+    }
+
+    /// push this voice onto the pending list of the engine unless it is
+    /// already queued; lock-free, so it may be called from read()
+    void requestFill() {
+      if (!takeQueued()) return;
+      StreamingVoice* head = pending_->load();
+      do {
+        nextPending_ = head;
+      } while (!pending_->compare_exchange_weak(head, this));
+    }
+
+    /// read all free frames from the file with as few reads as possible; only
+    /// called by one I/O thread at a time
+    uint64_t fill() {
+      const uint64_t writePos = written_.load(std::memory_order_relaxed);
+      const uint64_t toRead = capacity_ - (writePos - read_.load());
+      uint64_t done = 0;
+      bool endOfFile = false;
+      while (done < toRead) {
+        const uint64_t pos = (writePos + done) % capacity_;
+        const uint64_t chunk = std::min(toRead - done, capacity_ - pos);
+        const uint64_t got = reader_->read(&buffer_[pos * channels_], chunk);
+        done += got;
+        if (got < chunk) {
+          endOfFile = true;
+          break;
+        }
+      }
+      written_.store(writePos + done);
+      if (endOfFile || reader_->eof()) endOfFile_ = true;
+      return done;
+    }
+
+    std::unique_ptr<Bw64Reader> reader_;
+    uint16_t channels_;
+    uint32_t sampleRate_;
+    uint64_t capacity_;
+    uint64_t minimumReadFrames_;
+    /// head of the list of voices waiting to be queued by the engine; shared
+    /// so that a voice may outlive its engine
+    std::shared_ptr<std::atomic<StreamingVoice*>> pending_;
+    StreamingVoice* nextPending_;
+    std::vector<float> buffer_;
+    std::atomic<uint64_t> written_;
+    std::atomic<uint64_t> read_;
+    std::atomic<uint64_t> minimumBuffered_;
+    std::atomic<uint64_t> underruns_;
+    std::atomic<bool> endOfFile_;
+    std::atomic<bool> failed_;
+    /// set while the voice is on the pending list, in the queue or being
+    /// filled; whoever sets it owns the voice until it is cleared
+    std::atomic<bool> queued_;
+    std::atomic<bool> removed_;
+  };
+
+  /**
+   * @brief Stream many voices from BW64 files with a small I/O thread pool
+   *
+   * The engine keeps the ring buffer of every voice topped up. A voice is
+   * scheduled for refilling once at least `minimumReadFrames` frames of its
+   * buffer are free; all free frames are then read in one go, so that many
+   * small reads are coalesced into few large sequential ones. Voices request
+   * refills themselves from StreamingVoice::read(), and new requests are
+   * queued before every refill, so that pending refills are always served in
+   * order of their deadline, i.e. the voice which would underrun first is read
+   * first.
+   *
+   * With zero I/O threads no background work is done, and the caller has to
+   * call service() instead, e.g. for offline rendering.
+   */
+  class StreamingEngine {
+   public:
+    /**
+     * @brief Create a StreamingEngine
+     *
+     * @param ioThreads number of background I/O threads
+     * @param bufferFrames ring buffer size of each voice in frames
+     * @param minimumReadFrames minimum number of free frames before a voice
+     * is refilled
+     * @param pollInterval interval in which idle I/O threads check for
+     * refill requests; this only looks at a single atomic pointer
+     */
+    StreamingEngine(
+        size_t ioThreads = 2, uint64_t bufferFrames = 65536,
+        uint64_t minimumReadFrames = 16384,
+        std::chrono::microseconds pollInterval = std::chrono::milliseconds(2))
+        : bufferFrames_(bufferFrames),
+          minimumReadFrames_(minimumReadFrames),
+          pollInterval_(pollInterval),
+          pending_(std::make_shared<std::atomic<StreamingVoice*>>(nullptr)),
+          stop_(false) {
+      if (bufferFrames_ == 0) {
+        throw std::runtime_error("bufferFrames must be > 0");
+      }
+      if (minimumReadFrames_ == 0 || minimumReadFrames_ > bufferFrames_) {
+        throw std::runtime_error(
+            "minimumReadFrames must be in [1, bufferFrames]");
+      }
+      for (size_t i = 0; i < ioThreads; ++i) {
+        threads_.emplace_back(&StreamingEngine::run, this);
+      }
+    }
+
+    StreamingEngine(const StreamingEngine&) = delete;
+    StreamingEngine& operator=(const StreamingEngine&) = delete;
+
+    /// stop all I/O threads
+    ~StreamingEngine() {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+      }
+      wakeup_.notify_all();
+      for (auto& thread : threads_) thread.join();
+    }
+
+    /**
+     * @brief Add a voice streaming from a file
+     *
+     * The file is opened on the calling thread; the ring buffer is filled in
+     * the background.
+     *
+     * @param filename path of the file to stream
+     * @param startFrame frame to start streaming from
+     */
+    std::shared_ptr<StreamingVoice> addVoice(const std::string& filename,
+                                             uint64_t startFrame = 0) {
+      std::unique_ptr<Bw64Reader> reader(new Bw64Reader(filename.c_str()));
+      reader->seek(utils::safeCast<int64_t>(
+          std::min(startFrame, reader->numberOfFrames())));
+      std::shared_ptr<StreamingVoice> voice(new StreamingVoice(
+          std::move(reader), bufferFrames_, minimumReadFrames_, pending_));
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        voices_.push_back(voice);
+        if (voice->needsFill() && voice->takeQueued()) enqueue(voice.get());
+      }
+      wakeup_.notify_one();
+      return voice;
+    }
+
+    /// @brief Stop streaming a voice
+    void removeVoice(const std::shared_ptr<StreamingVoice>& voice) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      voice->removed_ = true;
+      voices_.erase(std::remove(voices_.begin(), voices_.end(), voice),
+                    voices_.end());
+      // taking the queued flag for good stops further refill requests; if it
+      // was already set, keep the voice alive until its request is dropped
+      if (voice->queued_.exchange(true)) retiring_.push_back(voice);
+    }
+
+    /// @brief Get number of active voices
+    size_t voices() const {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return voices_.size();
+    }
+
+    /// @brief Total number of underruns of all active voices
+    uint64_t underruns() const {
+      std::lock_guard<std::mutex> lock(mutex_);
+      uint64_t sum = 0;
+      for (auto& voice : voices_) sum += voice->underruns();
+      return sum;
+    }
+
+    /// @brief Smallest underrun margin in seconds of all active voices which
+    /// have not reached the end of their file
+    double minimumUnderrunMargin() const {
+      std::lock_guard<std::mutex> lock(mutex_);
+      double margin = std::numeric_limits<double>::infinity();
+      for (auto& voice : voices_) {
+        if (!voice->endOfFile())
+          margin = std::min(margin, voice->underrunMargin());
+      }
+      return margin;
+    }
+
+    /**
+     * @brief Perform all pending refills on the calling thread
+     *
+     * @returns number of refills performed
+     */
+    size_t service() {
+      size_t fills = 0;
+      std::unique_lock<std::mutex> lock(mutex_);
+      for (schedule(); !queue_.empty(); schedule()) {
+        if (performNextFill(lock)) ++fills;
+      }
+      return fills;
+    }
+
+   private:
+    struct FillRequest {
+      double deadline;
+      StreamingVoice* voice;
+      bool operator>(const FillRequest& rhs) const {
+        return deadline > rhs.deadline;
+      }
+    };
+
+    /// queue a voice whose queued flag has been taken; mutex_ must be held
+    void enqueue(StreamingVoice* voice) {
+      queue_.push(FillRequest{voice->underrunMargin(), voice});
+    }
+
+    /// queue the voices which requested a refill since the last call; mutex_
+    /// must be held
+    void schedule() {
+      StreamingVoice* voice = pending_->exchange(nullptr);
+      while (voice) {
+        StreamingVoice* next = voice->nextPending_;
+        enqueue(voice);
+        voice = next;
+      }
+    }
+
+    /**
+     * pop the most urgent request and fill it with mutex_ released
+     *
+     * @returns false if the voice has been removed and was not filled
+     */
+    bool performNextFill(std::unique_lock<std::mutex>& lock) {
+      StreamingVoice& voice = *queue_.top().voice;
+      queue_.pop();
+      // removed_ is only set with mutex_ held, and voices stay alive in
+      // voices_ or retiring_ while they are queued
+      const bool removed = voice.removed_;
+      if (!removed) {
+        lock.unlock();
+        try {
+          voice.fill();
+        } catch (...) {
+          voice.failed_ = true;
+          voice.endOfFile_ = true;
+        }
+        lock.lock();
+      }
+
+      if (voice.removed_) {
+        retiring_.erase(
+            std::find_if(retiring_.begin(), retiring_.end(),
+                         [&voice](const std::shared_ptr<StreamingVoice>& v) {
+                           return v.get() == &voice;
+                         }));
+      } else {
+        // requests made by read() during the fill were dropped, so check again
+        voice.queued_ = false;
+        if (voice.needsFill() && voice.takeQueued()) enqueue(&voice);
+      }
+      return !removed;
+    }
+
+    void run() {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (!stop_) {
+        schedule();
+        if (queue_.empty()) {
+          wakeup_.wait_for(lock, pollInterval_);
+          continue;
+        }
+        performNextFill(lock);
+      }
+    }
+
+    uint64_t bufferFrames_;
+    uint64_t minimumReadFrames_;
+    std::chrono::microseconds pollInterval_;
+    std::shared_ptr<std::atomic<StreamingVoice*>> pending_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wakeup_;
+    bool stop_;
+    std::vector<std::shared_ptr<StreamingVoice>> voices_;
+    /// removed voices which are still pending or queued
+    std::vector<std::shared_ptr<StreamingVoice>> retiring_;
+    std::priority_queue<FillRequest, std::vector<FillRequest>,
+                        std::greater<FillRequest>>
+        queue_;
+    std::vector<std::thread> threads_;
+  };
+
+}  // namespace bw64
@@ -0,0 +1,93 @@
+/**
+ * @file thread_pool.hpp
+ *
+ * Minimal thread pool used by the parallel I/O helpers.
+ */
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace bw64 {
+
+  /**
+   * @brief Fixed size pool of worker threads executing submitted tasks in
+   * FIFO order
+   */
+  class ThreadPool {
+   public:
+    /// @brief Start a pool with the given number of threads (at least one)
+    explicit ThreadPool(size_t threads = std::thread::hardware_concurrency())
+        : stop_(false) {
+      if (threads == 0) threads = 1;
+      for (size_t i = 0; i < threads; ++i) {
+        workers_.emplace_back(&ThreadPool::run, this);
+      }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// finish all queued tasks and stop the threads
+    ~ThreadPool() {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+      }
+      wakeup_.notify_all();
+      for (auto& worker : workers_) worker.join();
+    }
+
+    /// @brief Get number of worker threads
+    size_t size() const { return workers_.size(); }
+
+    /**
+     * @brief Queue a task
+     *
+     * @returns `std::future` for the result of the task; exceptions thrown by
+     * the task are rethrown by `get()`.
+     */
+    template <typename F>
+    std::future<decltype(std::declval<F&>()())> submit(F task) {
+      using ResultType = decltype(std::declval<F&>()());
+      auto packagedTask =
+          std::make_shared<std::packaged_task<ResultType()>>(std::move(task));
+      auto future = packagedTask->get_future();
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.emplace_back([packagedTask]() { (*packagedTask)(); });
+      }
+      wakeup_.notify_one();
+      return future;
+    }
+
+   private:
+    void run() {
+      while (true) {
+        std::function<void()> task;
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          wakeup_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+          if (tasks_.empty()) return;
+          task = std::move(tasks_.front());
+          tasks_.pop_front();
+        }
+        task();
+      }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    bool stop_;
+    std::deque<std::function<void()>> tasks_;
+    std::vector<std::thread> workers_;
+  };
+
+}  // namespace bw64
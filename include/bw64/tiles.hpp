@@ -0,0 +1,290 @@
+/**
+ * @file tiles.hpp
+ *
+ * Channel-major tiled sidecar files, for reading single channels of files
+ * with many channels.
+ */
+#pragma once
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "utils.hpp"
+
+namespace bw64 {
+
+  /// @brief Get the default path of the tiled sidecar of a file
+  inline std::string tiledSidecarPath(const std::string& filename) {
+    return filename + ".tiles";
+  }
+
+  /**
+   * @brief Header of a tiled sidecar file
+   *
+   * The sidecar holds the PCM samples of the data chunk of one file,
+   * regrouped in tiles of tileFrames frames. Within a tile, the samples of
+   * each channel are stored contiguously, channel after channel, so reading
+   * one channel reads `1 / channels` of the data in runs of `tileFrames`
+   * samples. The last tile holds the remaining frames.
+   *
+   * The source fields identify the file the sidecar was built from, so that
+   * a sidecar left behind by an older version of the file is not used. As
+   * a file re-rendered at the same length keeps its size and data offset,
+   * they include a checksum of some of the samples; see
+   * Bw64Reader::useTiledSidecar().
+   */
+  struct TiledSidecarHeader {
+    uint16_t channels = 0;
+    uint16_t bitDepth = 0;
+    uint32_t tileFrames = 0;
+    uint64_t numberOfFrames = 0;
+    /// size of the source file in bytes
+    uint64_t sourceFileSize = 0;
+    /// offset of the PCM data in the source file
+    uint64_t sourceDataStart = 0;
+    /// FNV-1a hash of sampled runs of the PCM data of the source file
+    uint64_t sourceChecksum = 0;
+
+    /// @brief Get size of the header in the file
+    static uint64_t size() { return 56; }
+    /// @brief Get bytes per sample
+    uint16_t sampleBytes() const { return bitDepth / 8; }
+    /// @brief Get number of frames in a tile
+    uint64_t framesInTile(uint64_t tile) const {
+      return std::min<uint64_t>(tileFrames, numberOfFrames - tile * tileFrames);
+    }
+    /// @brief Get the size of a complete sidecar file
+    uint64_t fileSize() const {
+      return size() + numberOfFrames * channels * sampleBytes();
+    }
+    /// @brief Get the file offset of the samples of a channel in a tile
+    uint64_t offset(uint64_t tile, uint16_t channel) const {
+      return size() + (tile * tileFrames * channels +
+                       channel * framesInTile(tile)) *
+                          sampleBytes();
+    }
+
+    /// @brief Write the header to a stream
+    void write(std::ostream& stream) const {
+      stream.write("BW64TILE", 8);
+      utils::writeValue(stream, uint32_t{2});
+      utils::writeValue(stream, channels);
+      utils::writeValue(stream, bitDepth);
+      utils::writeValue(stream, tileFrames);
+      utils::writeValue(stream, uint32_t{0});
+      utils::writeValue(stream, numberOfFrames);
+      utils::writeValue(stream, sourceFileSize);
+      utils::writeValue(stream, sourceDataStart);
+      utils::writeValue(stream, sourceChecksum);
+    }
+
+    /// @brief Read the header from a stream
+    static TiledSidecarHeader read(std::istream& stream) {
+      char magic[8];
+      utils::readChunk(stream, magic, sizeof(magic));
+      uint32_t version, reserved;
+      utils::readValue(stream, version);
+      if (std::memcmp(magic, "BW64TILE", 8) != 0 || version != 2)
+        throw std::runtime_error("not a tiled sidecar file");
+      TiledSidecarHeader header;
+      utils::readValue(stream, header.channels);
+      utils::readValue(stream, header.bitDepth);
+      utils::readValue(stream, header.tileFrames);
+      utils::readValue(stream, reserved);
+      utils::readValue(stream, header.numberOfFrames);
+      utils::readValue(stream, header.sourceFileSize);
+      utils::readValue(stream, header.sourceDataStart);
+      utils::readValue(stream, header.sourceChecksum);
+      if (header.channels == 0 || header.tileFrames == 0 ||
+          (header.bitDepth != 16 && header.bitDepth != 24 &&
+           header.bitDepth != 32))
+        throw std::runtime_error("invalid tiled sidecar header");
+      return header;
+    }
+  };
+
+  /**
+   * @brief Write a tiled sidecar file from interleaved PCM frames
+   *
+   * Frames are passed in tile order with writeTile(). See
+   * Bw64Reader::writeTiledSidecar() to build the sidecar of a file.
+   *
+   * The sidecar is written to `filename` with a `.partial` suffix, which is
+   * renamed to `filename` by close() once all tiles have been written, so
+   * that an incomplete sidecar is never found at `filename`. The partial
+   * file is removed if the writer is destroyed before that.
+   */
+  class TiledSidecarWriter {
+   public:
+    TiledSidecarWriter(const std::string& filename,
+                       const TiledSidecarHeader& header)
+        : header_(header),
+          filename_(filename),
+          partialFilename_(filename + ".partial") {
+      if (header.channels == 0 || header.tileFrames == 0)
+        throw std::runtime_error("invalid tiled sidecar header");
+      fileStream_.open(partialFilename_,
+                       std::fstream::out | std::fstream::binary);
+      if (!fileStream_.is_open()) {
+        std::stringstream errorString;
+        errorString << "Could not open file: " << partialFilename_;
+        throw std::runtime_error(errorString.str());
+      }
+      header_.write(fileStream_);
+    }
+
+    TiledSidecarWriter(const TiledSidecarWriter&) = delete;
+    TiledSidecarWriter& operator=(const TiledSidecarWriter&) = delete;
+
+    ~TiledSidecarWriter() {
+      if (fileStream_.is_open()) {
+        fileStream_.close();
+        std::remove(partialFilename_.c_str());
+      }
+    }
+
+    /// @brief Get number of tiles
+    uint64_t tiles() const {
+      return (header_.numberOfFrames + header_.tileFrames - 1) /
+             header_.tileFrames;
+    }
+    /// @brief Get number of tiles written
+    uint64_t tilesWritten() const { return tile_; }
+
+    /**
+     * @brief Write the next tile
+     *
+     * @param frames interleaved PCM frames of the tile, as stored in the
+     * source file
+     */
+    void writeTile(const char* frames) {
+      if (tile_ == tiles()) throw std::runtime_error("all tiles written");
+      const uint64_t n = header_.framesInTile(tile_);
+      const uint16_t bytes = header_.sampleBytes();
+      const uint64_t frameBytes = uint64_t{header_.channels} * bytes;
+      tileBuffer_.resize(utils::safeCast<size_t>(n * frameBytes));
+      for (uint16_t c = 0; c < header_.channels; ++c) {
+        char* out = tileBuffer_.data() + c * n * bytes;
+        const char* in = frames + c * bytes;
+        for (uint64_t f = 0; f < n; ++f)
+          std::memcpy(out + f * bytes, in + f * frameBytes, bytes);
+      }
+      fileStream_.write(tileBuffer_.data(), tileBuffer_.size());
+      ++tile_;
+    }
+
+    /**
+     * @brief Close the file and move it to its final name
+     *
+     * All tiles must have been written; otherwise, or on file errors, the
+     * partial file is removed and an exception thrown.
+     */
+    void close() {
+      if (!fileStream_.is_open()) return;
+      fileStream_.close();
+      if (tile_ != tiles() || !fileStream_.good()) {
+        std::remove(partialFilename_.c_str());
+        throw std::runtime_error(tile_ != tiles()
+                                     ? "tiled sidecar closed before all tiles"
+                                     : "file error detected when closing");
+      }
+      // rename does not replace existing files on all platforms
+      if (std::rename(partialFilename_.c_str(), filename_.c_str()) != 0 &&
+          (std::remove(filename_.c_str()) != 0 ||
+           std::rename(partialFilename_.c_str(), filename_.c_str()) != 0)) {
+        std::remove(partialFilename_.c_str());
+        std::stringstream errorString;
+        errorString << "Could not rename " << partialFilename_ << " to "
+                    << filename_;
+        throw std::runtime_error(errorString.str());
+      }
+    }
+
+   private:
+    TiledSidecarHeader header_;
+    std::string filename_;
+    std::string partialFilename_;
+    std::ofstream fileStream_;
+    std::vector<char> tileBuffer_;
+    uint64_t tile_{0};
+  };
+
+  /**
+   * @brief Read single channels from a tiled sidecar file
+   *
+   * Throws if the file is not a complete sidecar, i.e. if its size is not
+   * the one given by its header.
+   */
+  class TiledSidecar {
+   public:
+    explicit TiledSidecar(const std::string& filename) {
+      fileStream_.open(filename, std::fstream::in | std::fstream::binary);
+      if (!fileStream_.is_open()) {
+        std::stringstream errorString;
+        errorString << "Could not open file: " << filename;
+        throw std::runtime_error(errorString.str());
+      }
+      header_ = TiledSidecarHeader::read(fileStream_);
+      fileStream_.seekg(0, std::ios::end);
+      const std::streamoff size = fileStream_.tellg();
+      if (!fileStream_.good() || size < 0 ||
+          static_cast<uint64_t>(size) != header_.fileSize()) {
+        std::stringstream errorString;
+        errorString << "tiled sidecar " << filename << " is incomplete";
+        throw std::runtime_error(errorString.str());
+      }
+    }
+
+    /// @brief Get the header
+    const TiledSidecarHeader& header() const { return header_; }
+
+    /**
+     * @brief Read the frames of one channel
+     *
+     * @param channel   channel to read
+     * @param frame     first frame to read
+     * @param outBuffer buffer for `frames` samples
+     * @param frames    number of frames to read
+     *
+     * @returns number of frames read
+     */
+    template <typename T, typename std::enable_if<
+                              std::is_floating_point<T>::value, int>::type = 0>
+    uint64_t readChannel(uint16_t channel, uint64_t frame, T* outBuffer,
+                         uint64_t frames) {
+      if (channel >= header_.channels)
+        throw std::runtime_error("channel out of range");
+      if (frame >= header_.numberOfFrames) return 0;
+      frames = std::min(frames, header_.numberOfFrames - frame);
+      const uint16_t bytes = header_.sampleBytes();
+      uint64_t done = 0;
+      while (done < frames) {
+        const uint64_t position = frame + done;
+        const uint64_t tile = position / header_.tileFrames;
+        const uint64_t inTile = position - tile * header_.tileFrames;
+        const uint64_t n =
+            std::min(frames - done, header_.framesInTile(tile) - inTile);
+        buffer_.resize(utils::safeCast<size_t>(n * bytes));
+        fileStream_.seekg(
+            utils::safeCast<std::streamoff>(header_.offset(tile, channel) +
+                                            inTile * bytes));
+        utils::readChunk(fileStream_, buffer_.data(), buffer_.size());
+        utils::decodePcmSamples(buffer_.data(), outBuffer + done, n,
+                                header_.bitDepth);
+        done += n;
+      }
+      return frames;
+    }
+
+   private:
+    std::ifstream fileStream_;
+    TiledSidecarHeader header_;
+    std::vector<char> buffer_;
+  };
+
+}  // namespace bw64
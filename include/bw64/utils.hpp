@@ -4,13 +4,29 @@
  * Collection of helper functions.
  */
 #pragma once
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <sstream>
+#include <string>
+#include <streambuf>
 #include <stdexcept>
 #include <limits>
 #include <memory>
+#include <new>
 #include <type_traits>
+#include <vector>
 #include <stdint.h>
+#if defined(__linux__)
+#include <stdlib.h>
+#include <sys/mman.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
 #include "chunks.hpp"
 
 namespace bw64 {
@@ -35,6 +51,29 @@ namespace bw64 {
         throw std::runtime_error("file error while reading value");
     }
 
+    /// @brief Read a value from a memory buffer, which need not be aligned
+    template <typename T>
+    T loadValue(const char* src) {
+      T value;
+      std::memcpy(&value, src, sizeof(value));
+      return value;
+    }
+
+    /// @brief Get string from a fixed size field padded with NUL characters
+    inline std::string fixedString(const char* field, size_t size) {
+      return std::string(field, std::find(field, field + size, '\0'));
+    }
+
+    /// @brief Update a 64 bit FNV-1a hash with size bytes
+    inline uint64_t fnv1a(const char* data, size_t size,
+                          uint64_t hash = 0xcbf29ce484222325u) {
+      for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 0x100000001b3u;
+      }
+      return hash;
+    }
+
     /// @brief Read size bytes from stream into dest
     ///
     /// Dest may be null if size == 0. EOF and stream errors are checked.
@@ -48,6 +87,150 @@ namespace bw64 {
       }
     }
 
+    /**
+     * @brief Read-only, seekable `std::streambuf` over a memory buffer
+     *
+     * The buffer is not copied, so it must outlive the MemoryStreamBuf, or be
+     * replaced using reset() before it is freed.
+     */
+    class MemoryStreamBuf : public std::streambuf {
+     public:
+      MemoryStreamBuf() = default;
+      MemoryStreamBuf(const char* data, size_t size) { reset(data, size); }
+
+      /// @brief Point to a different buffer, and rewind to its start
+      void reset(const char* data, size_t size) {
+        char* begin = const_cast<char*>(data);
+        setg(begin, begin, begin + size);
+      }
+
+     protected:
+      pos_type seekoff(off_type offset, std::ios_base::seekdir way,
+                       std::ios_base::openmode which) override {
+        if (!(which & std::ios_base::in)) return pos_type(off_type(-1));
+        const off_type size = egptr() - eback();
+        off_type base = 0;
+        if (way == std::ios_base::cur)
+          base = gptr() - eback();
+        else if (way == std::ios_base::end)
+          base = size;
+        if (offset < -base || offset > size - base)
+          return pos_type(off_type(-1));
+        setg(eback(), eback() + base + offset, egptr());
+        return pos_type(base + offset);
+      }
+
+      pos_type seekpos(pos_type position,
+                       std::ios_base::openmode which) override {
+        return seekoff(off_type(position), std::ios_base::beg, which);
+      }
+    };
+
+    /// @brief Size of a transparent huge page on x86-64 and arm64 Linux
+    inline constexpr size_t hugePageSize() { return size_t{2} << 20; }
+
+    /**
+     * @brief Ask the kernel to back a memory region with transparent huge
+     * pages
+     *
+     * This is only a hint, for buffers or mappings of many megabytes that are
+     * streamed through, to reduce TLB misses. Only the whole huge pages
+     * within the region are affected.
+     *
+     * @returns true if the hint was accepted; always false on systems without
+     * `MADV_HUGEPAGE`
+     */
+    inline bool adviseHugePages(void* data, size_t size) {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+      const uintptr_t begin = reinterpret_cast<uintptr_t>(data);
+      const uintptr_t first =
+          (begin + hugePageSize() - 1) & ~(uintptr_t{hugePageSize()} - 1);
+      if (first >= begin + size) return false;
+      const size_t length = (begin + size - first) & ~(hugePageSize() - 1);
+      if (length == 0) return false;
+      return madvise(reinterpret_cast<void*>(first), length, MADV_HUGEPAGE) ==
+             0;
+#else
+      (void)data;
+      (void)size;
+      return false;
+#endif
+    }
+
+    /**
+     * @brief Allocator for large buffers backed by transparent huge pages
+     *
+     * When enabled, allocations of at least hugePageSize() bytes are aligned
+     * to hugePageSize() and passed to adviseHugePages(); smaller allocations,
+     * and all allocations when disabled, use `operator new`. The state is
+     * propagated on container assignment, so a container can be switched by
+     * assigning it an empty container with a different allocator.
+     */
+    template <typename T>
+    class HugePageAllocator {
+     public:
+      using value_type = T;
+      using propagate_on_container_copy_assignment = std::true_type;
+      using propagate_on_container_move_assignment = std::true_type;
+      using propagate_on_container_swap = std::true_type;
+
+      explicit HugePageAllocator(bool enabled = false) : enabled_(enabled) {}
+      template <typename U>
+      HugePageAllocator(const HugePageAllocator<U>& other)
+          : enabled_(other.enabled()) {}
+
+      /// @brief Check if large allocations use huge pages
+      bool enabled() const { return enabled_; }
+
+      T* allocate(size_t n) {
+        if (n > (std::numeric_limits<size_t>::max)() / sizeof(T))
+          throw std::bad_alloc();
+        const size_t bytes = n * sizeof(T);
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        if (useHugePages(bytes)) {
+          // round up, so that the last huge page is not shared
+          const size_t rounded =
+              (bytes + hugePageSize() - 1) & ~(hugePageSize() - 1);
+          void* data = nullptr;
+          if (rounded < bytes ||
+              posix_memalign(&data, hugePageSize(), rounded) != 0)
+            throw std::bad_alloc();
+          adviseHugePages(data, rounded);
+          return static_cast<T*>(data);
+        }
+#endif
+        return static_cast<T*>(::operator new(bytes));
+      }
+
+      void deallocate(T* data, size_t n) {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        if (useHugePages(n * sizeof(T))) return free(data);
+#endif
+        ::operator delete(data);
+      }
+
+     private:
+      bool useHugePages(size_t bytes) const {
+        return enabled_ && bytes >= hugePageSize();
+      }
+
+      bool enabled_;
+    };
+
+    template <typename T, typename U>
+    bool operator==(const HugePageAllocator<T>& a,
+                    const HugePageAllocator<U>& b) {
+      return a.enabled() == b.enabled();
+    }
+    template <typename T, typename U>
+    bool operator!=(const HugePageAllocator<T>& a,
+                    const HugePageAllocator<U>& b) {
+      return !(a == b);
+    }
+
+    /// @brief Buffer for encoded PCM data; see HugePageAllocator
+    using RawBuffer = std::vector<char, HugePageAllocator<char>>;
+
     /// @brief Write a value to a stream
     template <typename T,
               typename std::enable_if<
@@ -98,11 +281,11 @@ namespace bw64 {
       return static_cast<T>(static_cast<uint32_t>(1) << (bits - 1));
     }
 
-    /// encode one sample to PCM
+    /// convert one sample to the integer value stored in PCM
     template <int bytes, typename IntT, typename T,
               typename std::enable_if<std::is_floating_point<T>::value,
                                       int>::type = 0>
-    void encode(T value, char* buffer) {
+    IntT quantise(T value) {
       static_assert(sizeof(IntT) >= bytes, "IntT must be larger than bytes");
       constexpr int bits = bytes * 8;
       using UnsignedT = typename std::make_unsigned<IntT>::type;
@@ -114,14 +297,17 @@ namespace bw64 {
       constexpr IntT minval = -maxval - 1;
 
       // clip or convert to int
-      IntT value_int;
-      if (value >= static_cast<T>(maxval))
-        value_int = maxval;
-      else if (value <= static_cast<T>(minval))
-        value_int = minval;
-      else
-        value_int = static_cast<IntT>(std::lrint(value));
+      if (value >= static_cast<T>(maxval)) return maxval;
+      if (value <= static_cast<T>(minval)) return minval;
+      return static_cast<IntT>(std::lrint(value));
+    }
 
+    /// encode one sample to PCM
+    template <int bytes, typename IntT, typename T,
+              typename std::enable_if<std::is_floating_point<T>::value,
+                                      int>::type = 0>
+    void encode(T value, char* buffer) {
+      const IntT value_int = quantise<bytes, IntT>(value);
       for (size_t i = 0; i < bytes; i++)
         buffer[i] = (value_int >> (8 * i)) & 0xff;
     }
@@ -153,6 +339,37 @@ namespace bw64 {
       return clipSample(scale_inv * value);
     }
 
+    /**
+     * @brief Copy bytes using non-temporal stores where available, which
+     * bypass the cache
+     *
+     * The stores are weakly ordered, so call nonTemporalFence() before the
+     * output is handed to another thread.
+     */
+    inline void copyNonTemporal(const char* inBuffer, char* outBuffer,
+                                size_t bytes) {
+      size_t i = 0;
+#if defined(__SSE2__)
+      // stream stores need aligned addresses; copy the start normally
+      const size_t head =
+          (16u - reinterpret_cast<uintptr_t>(outBuffer) % 16u) % 16u;
+      i = std::min(head, bytes);
+      std::memcpy(outBuffer, inBuffer, i);
+      for (; i + 16 <= bytes; i += 16)
+        _mm_stream_si128(
+            reinterpret_cast<__m128i*>(outBuffer + i),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(inBuffer + i)));
+#endif
+      std::memcpy(outBuffer + i, inBuffer + i, bytes - i);
+    }
+
+    /// @brief Order non-temporal stores before any later stores
+    inline void nonTemporalFence() {
+#if defined(__SSE2__)
+      _mm_sfence();
+#endif
+    }
+
     /// @brief Decode (integer) PCM samples as float from char array
     template <typename T, typename std::enable_if<
                               std::is_floating_point<T>::value, int>::type = 0>
@@ -177,6 +394,229 @@ namespace bw64 {
       }
     }
 
+#if defined(__SSE2__)
+    /// decode the samples of one 16 byte output and stream them to it
+    template <int bytes, typename IntT, typename T>
+    void decodeStream(const char* in, T* out) {
+      for (size_t i = 0; i < 16 / sizeof(T); ++i)
+        out[i] = decode<bytes, IntT, T>(in + i * bytes);
+    }
+    template <int bytes, typename IntT>
+    void decodeStream(const char* in, float* out) {
+      _mm_stream_ps(out,
+                    _mm_setr_ps(decode<bytes, IntT, float>(in),
+                                decode<bytes, IntT, float>(in + bytes),
+                                decode<bytes, IntT, float>(in + 2 * bytes),
+                                decode<bytes, IntT, float>(in + 3 * bytes)));
+    }
+    template <int bytes, typename IntT>
+    void decodeStream(const char* in, double* out) {
+      _mm_stream_pd(out, _mm_setr_pd(decode<bytes, IntT, double>(in),
+                                     decode<bytes, IntT, double>(in + bytes)));
+    }
+#endif
+
+    /// decode samples, streaming them to the output where it is aligned
+    template <int bytes, typename IntT, typename T>
+    void decodeSamplesNonTemporal(const char* inBuffer, T* outBuffer,
+                                  uint64_t numberOfSamples) {
+      uint64_t i = 0;
+#if defined(__SSE2__)
+      const uint64_t perStore = 16 / sizeof(T);
+      // stream stores need aligned addresses; decode the start normally
+      for (; i < numberOfSamples && i < perStore &&
+             reinterpret_cast<uintptr_t>(outBuffer + i) % 16 != 0;
+           ++i)
+        outBuffer[i] = decode<bytes, IntT, T>(inBuffer + i * bytes);
+      if (reinterpret_cast<uintptr_t>(outBuffer + i) % 16 == 0) {
+        for (; i + perStore <= numberOfSamples; i += perStore)
+          decodeStream<bytes, IntT>(inBuffer + i * bytes, outBuffer + i);
+        nonTemporalFence();
+      }
+#endif
+      for (; i < numberOfSamples; ++i)
+        outBuffer[i] = decode<bytes, IntT, T>(inBuffer + i * bytes);
+    }
+
+    /**
+     * @brief Decode (integer) PCM samples as float from char array, using
+     * non-temporal stores for the output
+     *
+     * The stores bypass the cache, which is only worthwhile if the output is
+     * much larger than the cache and not read again soon; otherwise use
+     * decodePcmSamples(). Samples are decoded in registers and stored directly
+     * when the compiler targets SSE2. Normal stores are used elsewhere, and
+     * for a float output which is not aligned to its size.
+     */
+    template <typename T, typename std::enable_if<
+                              std::is_floating_point<T>::value, int>::type = 0>
+    void decodePcmSamplesNonTemporal(const char* inBuffer, T* outBuffer,
+                                     uint64_t numberOfSamples,
+                                     uint16_t bitsPerSample) {
+      if (bitsPerSample == 16) {
+        decodeSamplesNonTemporal<2, int16_t>(inBuffer, outBuffer,
+                                             numberOfSamples);
+      } else if (bitsPerSample == 24) {
+        decodeSamplesNonTemporal<3, int32_t>(inBuffer, outBuffer,
+                                             numberOfSamples);
+      } else if (bitsPerSample == 32) {
+        decodeSamplesNonTemporal<4, int32_t>(inBuffer, outBuffer,
+                                             numberOfSamples);
+      } else {
+        std::stringstream errorString;
+        errorString << "unsupported number of bits: " << bitsPerSample;
+        throw std::runtime_error(errorString.str());
+      }
+    }
+
+    /// decode whole frames, writing them to the output in reverse order
+    template <int bytes, typename IntT, typename T>
+    void decodeFramesReversed(const char* inBuffer, T* outBuffer,
+                              uint64_t numberOfFrames, uint16_t channels) {
+      for (uint64_t frame = 0; frame < numberOfFrames; ++frame) {
+        const char* in = inBuffer + (numberOfFrames - 1 - frame) * channels *
+                                        static_cast<uint64_t>(bytes);
+        T* out = outBuffer + frame * channels;
+        for (uint16_t channel = 0; channel < channels; ++channel) {
+          out[channel] = decode<bytes, IntT, T>(in + channel * bytes);
+        }
+      }
+    }
+
+    /// @brief Decode (integer) PCM frames as float from char array, reversing
+    /// the order of the frames
+    ///
+    /// The channel order within each frame is kept, i.e. the last frame of
+    /// inBuffer becomes the first frame of outBuffer.
+    template <typename T, typename std::enable_if<
+                              std::is_floating_point<T>::value, int>::type = 0>
+    void decodePcmFramesReversed(const char* inBuffer, T* outBuffer,
+                                 uint64_t numberOfFrames, uint16_t channels,
+                                 uint16_t bitsPerSample) {
+      if (bitsPerSample == 16) {
+        decodeFramesReversed<2, int16_t>(inBuffer, outBuffer, numberOfFrames,
+                                         channels);
+      } else if (bitsPerSample == 24) {
+        decodeFramesReversed<3, int32_t>(inBuffer, outBuffer, numberOfFrames,
+                                         channels);
+      } else if (bitsPerSample == 32) {
+        decodeFramesReversed<4, int32_t>(inBuffer, outBuffer, numberOfFrames,
+                                         channels);
+      } else {
+        std::stringstream errorString;
+        errorString << "unsupported number of bits: " << bitsPerSample;
+        throw std::runtime_error(errorString.str());
+      }
+    }
+
+    /// decode interleaved frames into one buffer per channel
+    template <int bytes, typename IntT, typename T>
+    void decodeFramesPlanar(const char* inBuffer, T* const* outBuffers,
+                            uint64_t numberOfFrames, uint16_t channels) {
+      for (uint16_t channel = 0; channel < channels; ++channel) {
+        const char* in = inBuffer + channel * bytes;
+        T* out = outBuffers[channel];
+        for (uint64_t frame = 0; frame < numberOfFrames; ++frame)
+          out[frame] = decode<bytes, IntT, T>(in + frame * channels * bytes);
+      }
+    }
+
+    /// @brief Decode (integer) PCM frames as float from char array into one
+    /// buffer per channel
+    template <typename T, typename std::enable_if<
+                              std::is_floating_point<T>::value, int>::type = 0>
+    void decodePcmFramesPlanar(const char* inBuffer, T* const* outBuffers,
+                               uint64_t numberOfFrames, uint16_t channels,
+                               uint16_t bitsPerSample) {
+      if (bitsPerSample == 16) {
+        decodeFramesPlanar<2, int16_t>(inBuffer, outBuffers, numberOfFrames,
+                                       channels);
+      } else if (bitsPerSample == 24) {
+        decodeFramesPlanar<3, int32_t>(inBuffer, outBuffers, numberOfFrames,
+                                       channels);
+      } else if (bitsPerSample == 32) {
+        decodeFramesPlanar<4, int32_t>(inBuffer, outBuffers, numberOfFrames,
+                                       channels);
+      } else {
+        std::stringstream errorString;
+        errorString << "unsupported number of bits: " << bitsPerSample;
+        throw std::runtime_error(errorString.str());
+      }
+    }
+
+    /// decode interleaved frames into frames `frameStride` samples apart
+    template <int bytes, typename IntT, typename T>
+    void decodeFramesStrided(const char* inBuffer, T* outBuffer,
+                             uint64_t numberOfFrames, uint16_t channels,
+                             uint64_t frameStride) {
+      for (uint64_t frame = 0; frame < numberOfFrames; ++frame) {
+        const char* in = inBuffer + frame * channels * bytes;
+        T* out = outBuffer + frame * frameStride;
+        for (uint16_t channel = 0; channel < channels; ++channel)
+          out[channel] = decode<bytes, IntT, T>(in + channel * bytes);
+      }
+    }
+
+    /// @brief Decode (integer) PCM frames as float from char array into
+    /// frames which are `frameStride` samples apart
+    ///
+    /// This writes the channels of one file into a subset of the channels of
+    /// a larger interleaved buffer.
+    template <typename T, typename std::enable_if<
+                              std::is_floating_point<T>::value, int>::type = 0>
+    void decodePcmFramesStrided(const char* inBuffer, T* outBuffer,
+                                uint64_t numberOfFrames, uint16_t channels,
+                                uint64_t frameStride, uint16_t bitsPerSample) {
+      if (bitsPerSample == 16) {
+        decodeFramesStrided<2, int16_t>(inBuffer, outBuffer, numberOfFrames,
+                                        channels, frameStride);
+      } else if (bitsPerSample == 24) {
+        decodeFramesStrided<3, int32_t>(inBuffer, outBuffer, numberOfFrames,
+                                        channels, frameStride);
+      } else if (bitsPerSample == 32) {
+        decodeFramesStrided<4, int32_t>(inBuffer, outBuffer, numberOfFrames,
+                                        channels, frameStride);
+      } else {
+        std::stringstream errorString;
+        errorString << "unsupported number of bits: " << bitsPerSample;
+        throw std::runtime_error(errorString.str());
+      }
+    }
+
+    /// decode one channel of interleaved frames
+    template <int bytes, typename IntT, typename T>
+    void decodeChannel(const char* inBuffer, T* outBuffer,
+                       uint64_t numberOfFrames, uint16_t channels,
+                       uint16_t channel) {
+      const char* in = inBuffer + channel * bytes;
+      for (uint64_t frame = 0; frame < numberOfFrames; ++frame)
+        outBuffer[frame] =
+            decode<bytes, IntT, T>(in + frame * channels * bytes);
+    }
+
+    /// @brief Decode one channel of (integer) PCM frames as float from char
+    /// array
+    template <typename T, typename std::enable_if<
+                              std::is_floating_point<T>::value, int>::type = 0>
+    void decodePcmChannel(const char* inBuffer, T* outBuffer,
+                          uint64_t numberOfFrames, uint16_t channels,
+                          uint16_t channel, uint16_t bitsPerSample) {
+      if (bitsPerSample == 16) {
+        decodeChannel<2, int16_t>(inBuffer, outBuffer, numberOfFrames,
+                                  channels, channel);
+      } else if (bitsPerSample == 24) {
+        decodeChannel<3, int32_t>(inBuffer, outBuffer, numberOfFrames,
+                                  channels, channel);
+      } else if (bitsPerSample == 32) {
+        decodeChannel<4, int32_t>(inBuffer, outBuffer, numberOfFrames,
+                                  channels, channel);
+      } else {
+        std::stringstream errorString;
+        errorString << "unsupported number of bits: " << bitsPerSample;
+        throw std::runtime_error(errorString.str());
+      }
+    }
+
     /// @brief Encode PCM samples from float array to char array
     template <typename T,
               typename = std::enable_if<std::is_floating_point<T>::value>>
@@ -203,6 +643,341 @@ namespace bw64 {
       }
     }
 
+    /// type in which samples are encoded; 32 bit samples are converted in
+    /// doubles to avoid roundoff
+    template <int bytes, typename T>
+    using EncodeType = typename std::conditional<bytes == 4, double, T>::type;
+
+    /// quantise one sample for encodeStream()
+    template <int bytes, typename IntT, typename T>
+    IntT quantiseSample(T value) {
+      return quantise<bytes, IntT>(static_cast<EncodeType<bytes, T>>(value));
+    }
+
+#if defined(__SSE2__)
+    /// number of samples encoded into whole 16 byte stores at a time
+    template <int bytes>
+    constexpr uint64_t streamSamples() {
+      return bytes == 3 ? 16 : 16 / bytes;
+    }
+
+    /// encode streamSamples() samples in registers and stream them to `out`
+    template <typename T>
+    void encodeStream(std::integral_constant<int, 2>, const T* in, char* out) {
+      int16_t v[8];
+      for (int i = 0; i < 8; ++i) v[i] = quantiseSample<2, int16_t>(in[i]);
+      _mm_stream_si128(reinterpret_cast<__m128i*>(out),
+                       _mm_setr_epi16(v[0], v[1], v[2], v[3], v[4], v[5],
+                                      v[6], v[7]));
+    }
+    template <typename T>
+    void encodeStream(std::integral_constant<int, 3>, const T* in, char* out) {
+      uint64_t v[16];
+      for (int i = 0; i < 16; ++i)
+        v[i] = static_cast<uint32_t>(quantiseSample<3, int32_t>(in[i])) &
+               0xffffffu;
+      // pack each 8 samples into 3 words of 8 bytes
+      uint64_t w[6];
+      for (int half = 0; half < 2; ++half) {
+        const uint64_t* s = v + 8 * half;
+        w[3 * half] = s[0] | s[1] << 24 | s[2] << 48;
+        w[3 * half + 1] = s[2] >> 16 | s[3] << 8 | s[4] << 32 | s[5] << 56;
+        w[3 * half + 2] = s[5] >> 8 | s[6] << 16 | s[7] << 40;
+      }
+      __m128i* o = reinterpret_cast<__m128i*>(out);
+      for (int i = 0; i < 3; ++i)
+        _mm_stream_si128(o + i,
+                         _mm_set_epi64x(static_cast<int64_t>(w[2 * i + 1]),
+                                        static_cast<int64_t>(w[2 * i])));
+    }
+    template <typename T>
+    void encodeStream(std::integral_constant<int, 4>, const T* in, char* out) {
+      _mm_stream_si128(reinterpret_cast<__m128i*>(out),
+                       _mm_setr_epi32(quantiseSample<4, int32_t>(in[0]),
+                                      quantiseSample<4, int32_t>(in[1]),
+                                      quantiseSample<4, int32_t>(in[2]),
+                                      quantiseSample<4, int32_t>(in[3])));
+    }
+#endif
+
+    /// encode samples, streaming them to the output where it is aligned
+    template <int bytes, typename IntT, typename T>
+    void encodeSamplesNonTemporal(const T* inBuffer, char* outBuffer,
+                                  uint64_t numberOfSamples) {
+      uint64_t i = 0;
+#if defined(__SSE2__)
+      // stream stores need aligned addresses; encode the start normally
+      for (; i < numberOfSamples && i < 16 &&
+             reinterpret_cast<uintptr_t>(outBuffer + i * bytes) % 16 != 0;
+           ++i)
+        encode<bytes, IntT>(static_cast<EncodeType<bytes, T>>(inBuffer[i]),
+                            outBuffer + i * bytes);
+      if (reinterpret_cast<uintptr_t>(outBuffer + i * bytes) % 16 == 0) {
+        for (; i + streamSamples<bytes>() <= numberOfSamples;
+             i += streamSamples<bytes>())
+          encodeStream(std::integral_constant<int, bytes>(), inBuffer + i,
+                       outBuffer + i * bytes);
+        nonTemporalFence();
+      }
+#endif
+      for (; i < numberOfSamples; ++i)
+        encode<bytes, IntT>(static_cast<EncodeType<bytes, T>>(inBuffer[i]),
+                            outBuffer + i * bytes);
+    }
+
+    /// @brief Encode PCM samples from float array to char array, using
+    /// non-temporal stores for the output; see decodePcmSamplesNonTemporal()
+    template <typename T,
+              typename = std::enable_if<std::is_floating_point<T>::value>>
+    void encodePcmSamplesNonTemporal(const T* inBuffer, char* outBuffer,
+                                     uint64_t numberOfSamples,
+                                     uint16_t bitsPerSample) {
+      if (bitsPerSample == 16) {
+        encodeSamplesNonTemporal<2, int16_t>(inBuffer, outBuffer,
+                                             numberOfSamples);
+      } else if (bitsPerSample == 24) {
+        encodeSamplesNonTemporal<3, int32_t>(inBuffer, outBuffer,
+                                             numberOfSamples);
+      } else if (bitsPerSample == 32) {
+        encodeSamplesNonTemporal<4, int32_t>(inBuffer, outBuffer,
+                                             numberOfSamples);
+      } else {
+        std::stringstream errorString;
+        errorString << "unsupported number of bits: " << bitsPerSample;
+        throw std::runtime_error(errorString.str());
+      }
+    }
+
+    /// encode one buffer per channel into interleaved frames
+    template <int bytes, typename IntT, typename U, typename T>
+    void encodeFramesPlanar(const T* const* inBuffers, char* outBuffer,
+                            uint64_t numberOfFrames, uint16_t channels) {
+      for (uint16_t channel = 0; channel < channels; ++channel) {
+        const T* in = inBuffers[channel];
+        char* out = outBuffer + channel * bytes;
+        for (uint64_t frame = 0; frame < numberOfFrames; ++frame)
+          encode<bytes, IntT>(static_cast<U>(in[frame]),
+                              out + frame * channels * bytes);
+      }
+    }
+
+    /// @brief Encode PCM frames from one float buffer per channel to an
+    /// interleaved char array
+    template <typename T,
+              typename = std::enable_if<std::is_floating_point<T>::value>>
+    void encodePcmFramesPlanar(const T* const* inBuffers, char* outBuffer,
+                               uint64_t numberOfFrames, uint16_t channels,
+                               uint16_t bitsPerSample) {
+      if (bitsPerSample == 16) {
+        encodeFramesPlanar<2, int16_t, T>(inBuffers, outBuffer,
+                                          numberOfFrames, channels);
+      } else if (bitsPerSample == 24) {
+        encodeFramesPlanar<3, int32_t, T>(inBuffers, outBuffer,
+                                          numberOfFrames, channels);
+      } else if (bitsPerSample == 32) {
+        // work in doubles for 32 bit to avoid roundoff
+        encodeFramesPlanar<4, int32_t, double>(inBuffers, outBuffer,
+                                               numberOfFrames, channels);
+      } else {
+        std::stringstream errorString;
+        errorString << "unsupported number of bits: " << bitsPerSample;
+        throw std::runtime_error(errorString.str());
+      }
+    }
+
+    /// @brief Encode PCM samples from float array to big-endian char array
+    ///
+    /// This produces e.g. the L16 and L24 payload formats of RTP.
+    template <typename T,
+              typename = std::enable_if<std::is_floating_point<T>::value>>
+    void encodePcmSamplesBigEndian(const T* inBuffer, char* outBuffer,
+                                   uint64_t numberOfSamples,
+                                   uint16_t bitsPerSample) {
+      char sample[4];
+      if (bitsPerSample == 16) {
+        for (uint64_t i = 0; i < numberOfSamples; ++i) {
+          encode<2, int16_t>(inBuffer[i], sample);
+          std::reverse_copy(sample, sample + 2, outBuffer + 2 * i);
+        }
+      } else if (bitsPerSample == 24) {
+        for (uint64_t i = 0; i < numberOfSamples; ++i) {
+          encode<3, int32_t>(inBuffer[i], sample);
+          std::reverse_copy(sample, sample + 3, outBuffer + 3 * i);
+        }
+      } else {
+        std::stringstream errorString;
+        errorString << "unsupported number of bits for big-endian output: "
+                    << bitsPerSample;
+        throw std::runtime_error(errorString.str());
+      }
+    }
+
+    /// convert little-endian samples to big-endian samples of another width,
+    /// keeping the most significant bytes
+    template <int inBytes, int outBytes>
+    void convertToBigEndian(const char* inBuffer, char* outBuffer,
+                            uint64_t numberOfSamples) {
+      for (uint64_t i = 0; i < numberOfSamples; ++i) {
+        const char* in = inBuffer + i * inBytes;
+        char* out = outBuffer + i * outBytes;
+        for (int byte = 0; byte < outBytes; ++byte)
+          out[byte] = byte < inBytes ? in[inBytes - 1 - byte] : 0;
+      }
+    }
+
+    /// reverse the byte order of samples; inBuffer may equal outBuffer
+    template <int bytes>
+    void swapSampleBytes(const char* inBuffer, char* outBuffer,
+                         uint64_t numberOfSamples) {
+      for (uint64_t i = 0; i < numberOfSamples; ++i) {
+        char sample[bytes];
+        std::copy(inBuffer + i * bytes, inBuffer + (i + 1) * bytes, sample);
+        std::reverse_copy(sample, sample + bytes, outBuffer + i * bytes);
+      }
+    }
+
+#if defined(__SSSE3__)
+    /// swap 16 bit samples, 8 at a time
+    template <>
+    inline void swapSampleBytes<2>(const char* inBuffer, char* outBuffer,
+                                   uint64_t numberOfSamples) {
+      const __m128i shuffle =
+          _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+      uint64_t i = 0;
+      for (; i + 8 <= numberOfSamples; i += 8) {
+        __m128i v = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(inBuffer + 2 * i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(outBuffer + 2 * i),
+                         _mm_shuffle_epi8(v, shuffle));
+      }
+      for (; i < numberOfSamples; ++i) {
+        const char low = inBuffer[2 * i];
+        outBuffer[2 * i] = inBuffer[2 * i + 1];
+        outBuffer[2 * i + 1] = low;
+      }
+    }
+
+    /// swap 24 bit samples, 5 per 16 byte load; the 16th byte is passed
+    /// through and rewritten by the next step, so at least 6 samples must
+    /// remain for each step
+    template <>
+    inline void swapSampleBytes<3>(const char* inBuffer, char* outBuffer,
+                                   uint64_t numberOfSamples) {
+      const __m128i shuffle =
+          _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+      uint64_t i = 0;
+      for (; i + 6 <= numberOfSamples; i += 5) {
+        __m128i v = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(inBuffer + 3 * i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(outBuffer + 3 * i),
+                         _mm_shuffle_epi8(v, shuffle));
+      }
+      for (; i < numberOfSamples; ++i) {
+        const char low = inBuffer[3 * i];
+        outBuffer[3 * i] = inBuffer[3 * i + 2];
+        outBuffer[3 * i + 1] = inBuffer[3 * i + 1];
+        outBuffer[3 * i + 2] = low;
+      }
+    }
+#endif
+
+    /**
+     * @brief Convert little-endian PCM samples, as stored in a file, to
+     * big-endian PCM samples
+     *
+     * This produces e.g. the L16 and L24 payload formats of RTP without
+     * decoding to float. When narrowing, the least significant bytes are
+     * dropped; when widening, zero bytes are appended.
+     *
+     * If both bit depths are the same, the conversion is a byte swap, which
+     * can be done in place (`inBuffer == outBuffer`); it uses SSSE3 if the
+     * compiler targets it. Buffers must not overlap otherwise.
+     *
+     * @param inBuffer little-endian samples with 16, 24 or 32 bits
+     * @param outBuffer big-endian samples with 16 or 24 bits
+     */
+    inline void convertPcmSamplesToBigEndian(const char* inBuffer,
+                                             char* outBuffer,
+                                             uint64_t numberOfSamples,
+                                             uint16_t inBitsPerSample,
+                                             uint16_t outBitsPerSample) {
+      const int in = inBitsPerSample;
+      const int out = outBitsPerSample;
+      if (in == 16 && out == 16) {
+        swapSampleBytes<2>(inBuffer, outBuffer, numberOfSamples);
+      } else if (in == 24 && out == 24) {
+        swapSampleBytes<3>(inBuffer, outBuffer, numberOfSamples);
+      } else if (in == 16 && out == 24) {
+        convertToBigEndian<2, 3>(inBuffer, outBuffer, numberOfSamples);
+      } else if (in == 24 && out == 16) {
+        convertToBigEndian<3, 2>(inBuffer, outBuffer, numberOfSamples);
+      } else if (in == 32 && out == 16) {
+        convertToBigEndian<4, 2>(inBuffer, outBuffer, numberOfSamples);
+      } else if (in == 32 && out == 24) {
+        convertToBigEndian<4, 3>(inBuffer, outBuffer, numberOfSamples);
+      } else {
+        std::stringstream errorString;
+        errorString << "unsupported conversion from " << inBitsPerSample
+                    << " to " << outBitsPerSample << " bit big-endian samples";
+        throw std::runtime_error(errorString.str());
+      }
+    }
+
+    /// @brief Convert a float to an IEEE 754 half precision value
+    ///
+    /// Rounds to nearest even; values out of range become infinity.
+    inline uint16_t floatToHalf(float value) {
+      uint32_t f;
+      std::memcpy(&f, &value, sizeof(f));
+      const uint16_t sign = static_cast<uint16_t>((f >> 16) & 0x8000u);
+      f &= 0x7fffffffu;
+      if (f > 0x7f800000u) return sign | 0x7e00u;  // NaN
+      if (f >= 0x47800000u) return sign | 0x7c00u;  // >= 2^16, or infinity
+      if (f < 0x38800000u) {
+        // below the smallest normal half, 2^-14
+        if (f < 0x33000000u) return sign;
+        const uint32_t shift = 126 - (f >> 23);
+        const uint32_t mantissa = (f & 0x7fffffu) | 0x800000u;
+        uint32_t h = mantissa >> shift;
+        const uint32_t rest = mantissa & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (h & 1))) ++h;
+        return static_cast<uint16_t>(sign | h);
+      }
+      // rebias the exponent from 127 to 15; a carry from rounding correctly
+      // moves into the exponent
+      uint32_t h = (f >> 13) - (112u << 10);
+      const uint32_t rest = f & 0x1fffu;
+      if (rest > 0x1000u || (rest == 0x1000u && (h & 1))) ++h;
+      return static_cast<uint16_t>(sign | h);
+    }
+
+    /// @brief Convert an IEEE 754 half precision value to a float
+    inline float halfToFloat(uint16_t value) {
+      const uint32_t sign = static_cast<uint32_t>(value & 0x8000u) << 16;
+      uint32_t exponent = (value >> 10) & 0x1fu;
+      uint32_t mantissa = value & 0x3ffu;
+      uint32_t f;
+      if (exponent == 0x1f) {
+        f = sign | 0x7f800000u | (mantissa << 13);
+      } else if (exponent != 0) {
+        f = sign | ((exponent + 112) << 23) | (mantissa << 13);
+      } else if (mantissa == 0) {
+        f = sign;
+      } else {
+        // subnormal; normalise the mantissa
+        exponent = 113;
+        while (!(mantissa & 0x400u)) {
+          mantissa <<= 1;
+          --exponent;
+        }
+        f = sign | (exponent << 23) | ((mantissa & 0x3ffu) << 13);
+      }
+      float result;
+      std::memcpy(&result, &f, sizeof(result));
+      return result;
+    }
+
     /// check x against the maximum value that To can hold
     template <typename To, typename From>
     void checkUpper(From x) {
@@ -44,12 +44,24 @@ namespace bw64 {
      * the `additionalChunks`. They will be written directly after opening the
      * file.
      *
+     * If `dataAlignment` is not 0, a `JUNK` chunk is inserted before the
+     * `data` chunk so that the first sample is at a multiple of
+     * `dataAlignment` bytes from the start of the file, e.g. 4096 for page
+     * or sector aligned access; it must be even. See
+     * Bw64Reader::isDataAligned().
+     *
      * @note For convenience, you might consider using the `writeFile` helper
      * function.
      */
     Bw64Writer(const char* filename, uint16_t channels, uint32_t sampleRate,
                uint16_t bitDepth,
-               std::vector<std::shared_ptr<Chunk>> additionalChunks) {
+               std::vector<std::shared_ptr<Chunk>> additionalChunks,
+               uint32_t dataAlignment = 0) {
+      if (dataAlignment % 2 != 0) {
+        std::stringstream errorString;
+        errorString << "data alignment must be even, got " << dataAlignment;
+        throw std::runtime_error(errorString.str());
+      }
       fileStream_.open(filename, std::fstream::out | std::fstream::binary);
       if (!fileStream_.is_open()) {
         std::stringstream errorString;
@@ -70,6 +82,7 @@ namespace bw64 {
         writeChunkPlaceholder(utils::fourCC("chna"),
                               MAX_NUMBER_OF_UIDS * 40 + 4);
       }
+      if (dataAlignment) writeAlignmentPadding(dataAlignment);
       auto dataChunk = std::make_shared<DataChunk>();
       writeChunk(dataChunk);
     }
@@ -87,6 +100,8 @@ namespace bw64 {
 
       try {
         finalizeDataChunk();
+        writeChunk(cueChunk_);
+        writeChunk(adtlChunk_);
         for (auto chunk : postDataChunks_) {
           writeChunk(chunk);
         }
@@ -142,7 +157,7 @@ namespace bw64 {
                                   return chunk->id() == chunkId;
                                 });
       if (chunk != chunks.end()) {
-        return std::static_pointer_cast<ChunkType>(*chunk);
+        return std::dynamic_pointer_cast<ChunkType>(*chunk);
       } else {
         return nullptr;
       }
@@ -179,6 +194,22 @@ namespace bw64 {
     /// @brief Use RF64 ID for outer chunk (when >4GB) rather than BW64
     void useRf64Id(bool state) { useRf64Id_ = state; }
 
+    /// @brief Allocate the buffer for encoding frames from huge pages; see
+    /// Bw64Reader::useHugePages()
+    void useHugePages(bool state) {
+      rawDataBuffer_ = utils::RawBuffer(utils::HugePageAllocator<char>(state));
+    }
+    /// @brief Check if the encoding buffer is allocated from huge pages
+    bool usesHugePages() const {
+      return rawDataBuffer_.get_allocator().enabled();
+    }
+
+    /// @brief Encode frames with non-temporal stores; see
+    /// Bw64Reader::useNonTemporalStores()
+    void useNonTemporalStores(bool state) { nonTemporalStores_ = state; }
+    /// @brief Check if write() uses non-temporal stores
+    bool usesNonTemporalStores() const { return nonTemporalStores_; }
+
     void setChnaChunk(std::shared_ptr<ChnaChunk> chunk) {
       if (chunk->numUids() > 1024) {
         // TODO: make pre data chunk chna chunk a JUNK chunk and add chnaChunk
@@ -194,6 +225,46 @@ namespace bw64 {
       postDataChunks_.push_back(chunk);
     }
 
+    /**
+     * @brief Add a marker
+     *
+     * Markers are written to a 'cue ' chunk and, if they have labels, a
+     * 'LIST' chunk of type 'adtl' when the file is closed. They are held in
+     * the same compact form until then, so markers can be added at any rate
+     * while recording.
+     *
+     * @param frame frame position of the marker; must be < 2^32. Readers
+     * ignore markers after the last frame written.
+     * @param label label of the marker; none is written if it is empty
+     *
+     * @returns id of the cue point of the marker
+     */
+    uint32_t addMarker(uint64_t frame, const std::string& label = "") {
+      if (frame > UINT32_MAX) {
+        std::stringstream errorMsg;
+        errorMsg << "marker frame " << frame
+                 << " can not be stored in a cue chunk";
+        throw std::runtime_error(errorMsg.str());
+      }
+      if (!cueChunk_) cueChunk_ = std::make_shared<CueChunk>();
+      const uint32_t cueId =
+          utils::safeCast<uint32_t>(cueChunk_->cuePoints().size() + 1);
+      const uint32_t sampleOffset = static_cast<uint32_t>(frame);
+      cueChunk_->addCuePoint(CuePoint{cueId, sampleOffset,
+                                      utils::fourCC("data"), 0u, 0u,
+                                      sampleOffset});
+      if (!label.empty()) {
+        if (!adtlChunk_) adtlChunk_ = std::make_shared<AdtlChunk>();
+        adtlChunk_->addLabel(cueId, label);
+      }
+      return cueId;
+    }
+
+    /// @brief Get number of markers added
+    size_t markersAdded() const {
+      return cueChunk_ ? cueChunk_->cuePoints().size() : 0u;
+    }
+
     /// @brief Get the chunk size for header
     uint32_t chunkSizeForHeader(uint32_t id) {
       if (chunkHeader(id).size >= UINT32_MAX) {
@@ -276,6 +347,20 @@ namespace bw64 {
       }
     }
 
+    /// write a JUNK chunk so that the data of the next chunk starts at a
+    /// multiple of `alignment`
+    void writeAlignmentPadding(uint32_t alignment) {
+      // chunks start at even positions, so the padding is even too
+      const uint64_t dataPosition =
+          static_cast<uint64_t>(fileStream_.tellp()) + 8u;
+      uint64_t padding = (alignment - dataPosition % alignment) % alignment;
+      if (padding == 0) return;
+      // alignments below 8 may need several steps to fit the JUNK header
+      while (padding < 8u) padding += alignment;
+      writeChunkPlaceholder(utils::fourCC("JUNK"),
+                            utils::safeCast<uint32_t>(padding - 8u));
+    }
+
     void writeChunkPlaceholder(uint32_t id, uint32_t size) {
       uint64_t position = fileStream_.tellp();
       chunkHeaders_.push_back(ChunkHeader(id, size, position));
@@ -331,10 +416,51 @@ namespace bw64 {
     uint64_t write(T* inBuffer, uint64_t frames) {
       uint64_t bytesWritten = frames * formatChunk()->blockAlignment();
       rawDataBuffer_.resize(bytesWritten);
-      utils::encodePcmSamples(inBuffer, &rawDataBuffer_[0],
-                              frames * formatChunk()->channelCount(),
-                              formatChunk()->bitsPerSample());
-      fileStream_.write(&rawDataBuffer_[0], bytesWritten);
+      if (nonTemporalStores_)
+        utils::encodePcmSamplesNonTemporal(
+            inBuffer, rawDataBuffer_.data(),
+            frames * formatChunk()->channelCount(),
+            formatChunk()->bitsPerSample());
+      else
+        utils::encodePcmSamples(inBuffer, rawDataBuffer_.data(),
+                                frames * formatChunk()->channelCount(),
+                                formatChunk()->bitsPerSample());
+      return writeRaw(rawDataBuffer_.data(), frames);
+    }
+
+    /**
+     * @brief Write frames from one buffer per channel to dataChunk
+     *
+     * @param[in] inBuffers `channels()` buffers of at least `frames` samples
+     * each
+     * @param[in] frames    Number of frames to write
+     *
+     * @returns number of frames written
+     */
+    template <typename T, typename std::enable_if<
+                              std::is_floating_point<T>::value, int>::type = 0>
+    uint64_t writePlanar(const T* const* inBuffers, uint64_t frames) {
+      rawDataBuffer_.resize(frames * formatChunk()->blockAlignment());
+      utils::encodePcmFramesPlanar(inBuffers, rawDataBuffer_.data(), frames,
+                                   formatChunk()->channelCount(),
+                                   formatChunk()->bitsPerSample());
+      return writeRaw(rawDataBuffer_.data(), frames);
+    }
+
+    /**
+     * @brief Write already encoded frames to dataChunk
+     *
+     * The buffer must contain interleaved PCM samples in the format of this
+     * file, i.e. `frames * blockAlignment` bytes.
+     *
+     * @param[in] inBuffer Buffer to read encoded frames from
+     * @param[in] frames   Number of frames to write
+     *
+     * @returns number of frames written
+     */
+    uint64_t writeRaw(const char* inBuffer, uint64_t frames) {
+      uint64_t bytesWritten = frames * formatChunk()->blockAlignment();
+      if (bytesWritten) fileStream_.write(inBuffer, bytesWritten);
       dataChunk()->setSize(dataChunk()->size() + bytesWritten);
       chunkHeader(utils::fourCC("data")).size = dataChunk()->size();
       return frames;
@@ -342,10 +468,13 @@ namespace bw64 {
 
    private:
     std::ofstream fileStream_;
-    std::vector<char> rawDataBuffer_;
+    utils::RawBuffer rawDataBuffer_;
+    bool nonTemporalStores_{false};
     std::vector<std::shared_ptr<Chunk>> chunks_;
     std::vector<ChunkHeader> chunkHeaders_;
     std::vector<std::shared_ptr<Chunk>> postDataChunks_;
+    std::shared_ptr<CueChunk> cueChunk_;
+    std::shared_ptr<AdtlChunk> adtlChunk_;
     bool useRf64Id_{false};
   };
 
@@ -0,0 +1,671 @@
+// Python bindings for libbw64, written against the CPython API
+//
+// Samples are decoded straight into buffers passed by the caller (NumPy
+// arrays, array.array, ...) through the buffer protocol, raw PCM data is
+// returned as a memoryview of the buffer it was read into, and the GIL is
+// released while reading, decoding, encoding and writing.
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "bw64/bw64.hpp"
+
+using namespace bw64;
+
+namespace {
+
+  /// exception translated to a Python exception of type `type()`
+  class PythonError : public std::runtime_error {
+   public:
+    PythonError(PyObject* type, const std::string& message)
+        : std::runtime_error(message), type_(type) {}
+    PyObject* type() const { return type_; }
+
+   private:
+    PyObject* type_;
+  };
+
+  /// thrown when a Python exception has already been set
+  struct PythonErrorSet {};
+
+  /// set the Python exception for the exception being handled
+  void setError() {
+    try {
+      throw;
+    } catch (const PythonErrorSet&) {
+    } catch (const PythonError& e) {
+      PyErr_SetString(e.type(), e.what());
+    } catch (const std::bad_alloc&) {
+      PyErr_NoMemory();
+    } catch (const std::exception& e) {
+      PyErr_SetString(PyExc_RuntimeError, e.what());
+    } catch (...) {
+      PyErr_SetString(PyExc_RuntimeError, "unknown error");
+    }
+  }
+
+  /// run `f`, translating exceptions to Python exceptions
+  ///
+  /// On error a value initialised result (nullptr or false) is returned.
+  template <typename F>
+  auto guard(F f) -> decltype(f()) {
+    try {
+      return f();
+    } catch (...) {
+      setError();
+      return decltype(f())();
+    }
+  }
+
+  /// release the GIL for the lifetime of this object
+  class GilRelease {
+   public:
+    GilRelease() : state_(PyEval_SaveThread()) {}
+    ~GilRelease() { PyEval_RestoreThread(state_); }
+    GilRelease(const GilRelease&) = delete;
+    GilRelease& operator=(const GilRelease&) = delete;
+
+   private:
+    PyThreadState* state_;
+  };
+
+  /// owned reference to a Python object
+  class Ref {
+   public:
+    /// take ownership of `object`; throws if it is null, as returned by a
+    /// failed CPython call
+    explicit Ref(PyObject* object) : object_(object) {
+      if (!object_) throw PythonErrorSet();
+    }
+    ~Ref() { Py_XDECREF(object_); }
+    Ref(const Ref&) = delete;
+    Ref& operator=(const Ref&) = delete;
+
+    PyObject* get() const { return object_; }
+    PyObject* release() {
+      PyObject* object = object_;
+      object_ = nullptr;
+      return object;
+    }
+
+   private:
+    PyObject* object_;
+  };
+
+  /// C contiguous buffer exported by a Python object
+  class Buffer {
+   public:
+    Buffer(PyObject* object, bool writable) {
+      const int flags =
+          PyBUF_STRIDES | PyBUF_FORMAT | (writable ? PyBUF_WRITABLE : 0);
+      if (PyObject_GetBuffer(object, &view_, flags) != 0)
+        throw PythonErrorSet();
+      if (!PyBuffer_IsContiguous(&view_, 'C')) {
+        PyBuffer_Release(&view_);
+        throw PythonError(PyExc_TypeError, "buffer must be C contiguous");
+      }
+    }
+    ~Buffer() { PyBuffer_Release(&view_); }
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+
+    const Py_buffer& view() const { return view_; }
+    char* data() const { return static_cast<char*>(view_.buf); }
+    uint64_t size() const { return static_cast<uint64_t>(view_.len); }
+
+   private:
+    Py_buffer view_;
+  };
+
+  /// sample type of a buffer: 'f' for float32 or 'd' for float64
+  char sampleFormat(const Py_buffer& view) {
+    const uint16_t one = 1;
+    const bool littleEndian = *reinterpret_cast<const char*>(&one) == 1;
+    const char* format = view.format ? view.format : "B";
+    if (*format == '@' || *format == '=' || (*format == '<' && littleEndian))
+      ++format;
+    if (format[1] == '\0') {
+      if (format[0] == 'f' && view.itemsize == sizeof(float)) return 'f';
+      if (format[0] == 'd' && view.itemsize == sizeof(double)) return 'd';
+    }
+    std::stringstream errorString;
+    errorString << "buffer must hold float32 or float64 samples, got format '"
+                << (view.format ? view.format : "B") << "'";
+    throw PythonError(PyExc_TypeError, errorString.str());
+  }
+
+  /// number of frames in a buffer of samples
+  ///
+  /// Interleaved buffers have shape (frames, channels) and planar buffers
+  /// (channels, frames); one dimensional buffers hold whole frames in the
+  /// same order.
+  uint64_t frameCount(const Py_buffer& view, uint16_t channels, bool planar) {
+    const uint64_t samples = static_cast<uint64_t>(view.len / view.itemsize);
+    const bool wholeFrames =
+        (view.ndim == 1 && samples % channels == 0) ||
+        (view.ndim == 2 && view.shape[planar ? 0 : 1] == channels);
+    if (!wholeFrames) {
+      std::stringstream errorString;
+      errorString << "buffer must have shape "
+                  << (planar ? "(channels, frames)" : "(frames, channels)")
+                  << " with " << channels
+                  << " channels, or hold whole frames";
+      throw PythonError(PyExc_ValueError, errorString.str());
+    }
+    return samples / channels;
+  }
+
+  /// number of whole frames in a buffer of encoded frames
+  uint64_t rawFrameCount(const Buffer& buffer, uint16_t blockAlignment) {
+    if (buffer.size() % blockAlignment != 0) {
+      std::stringstream errorString;
+      errorString << "buffer must hold whole frames of " << blockAlignment
+                  << " bytes, got " << buffer.size() << " bytes";
+      throw PythonError(PyExc_ValueError, errorString.str());
+    }
+    return buffer.size() / blockAlignment;
+  }
+
+  uint64_t toFrames(PyObject* object) {
+    const unsigned long long frames = PyLong_AsUnsignedLongLong(object);
+    if (PyErr_Occurred()) throw PythonErrorSet();
+    return frames;
+  }
+
+  std::ios_base::seekdir seekDir(int whence) {
+    switch (whence) {
+      case 0:
+        return std::ios::beg;
+      case 1:
+        return std::ios::cur;
+      case 2:
+        return std::ios::end;
+      default:
+        throw PythonError(PyExc_ValueError, "whence must be 0, 1 or 2");
+    }
+  }
+
+  /// Python object holding a reader or writer, which is deleted on close
+  template <typename T>
+  struct Wrapper {
+    PyObject_HEAD
+    T* object;
+  };
+
+  template <typename T>
+  T& unwrap(PyObject* self) {
+    T* object = reinterpret_cast<Wrapper<T>*>(self)->object;
+    if (!object)
+      throw PythonError(PyExc_ValueError, "I/O operation on closed file");
+    return *object;
+  }
+
+  /// close and delete the wrapped object; exceptions from close() propagate
+  /// with the GIL held
+  template <typename T>
+  void closeWrapped(PyObject* self) {
+    std::unique_ptr<T> object(reinterpret_cast<Wrapper<T>*>(self)->object);
+    reinterpret_cast<Wrapper<T>*>(self)->object = nullptr;
+    if (!object) return;
+    GilRelease release;
+    object->close();
+  }
+
+  template <typename T>
+  void dealloc(PyObject* self) {
+    try {
+      closeWrapped<T>(self);
+    } catch (...) {
+      // the file is closed even if finalising it failed
+    }
+    PyTypeObject* type = Py_TYPE(self);
+    type->tp_free(self);
+    Py_DECREF(type);
+  }
+
+  template <typename T, typename R, R (T::*get)() const>
+  PyObject* getUnsigned(PyObject* self, void*) {
+    return guard([&] {
+      return PyLong_FromUnsignedLongLong((unwrap<T>(self).*get)());
+    });
+  }
+
+  template <typename T>
+  PyObject* closeObject(PyObject* self, PyObject*) {
+    return guard([&] {
+      closeWrapped<T>(self);
+      Py_RETURN_NONE;
+    });
+  }
+
+  PyObject* enterContext(PyObject* self, PyObject*) {
+    Py_INCREF(self);
+    return self;
+  }
+
+  template <typename T>
+  PyObject* exitContext(PyObject* self, PyObject*) {
+    return closeObject<T>(self, nullptr);
+  }
+
+  // --- Reader ---
+
+  template <typename T>
+  uint64_t readInto(Bw64Reader& reader, const Buffer& out, bool planar) {
+    const uint64_t frames = frameCount(out.view(), reader.channels(), planar);
+    T* data = reinterpret_cast<T*>(out.data());
+    GilRelease release;
+    if (!planar) return reader.read(data, frames);
+    std::vector<T*> channels(reader.channels());
+    for (uint16_t c = 0; c < reader.channels(); ++c)
+      channels[c] = data + c * frames;
+    return reader.readPlanar(channels.data(), frames);
+  }
+
+  uint64_t readInto(Bw64Reader& reader, const Buffer& out, bool planar) {
+    if (sampleFormat(out.view()) == 'f')
+      return readInto<float>(reader, out, planar);
+    return readInto<double>(reader, out, planar);
+  }
+
+  /// memoryview of a new bytearray holding `frames` decoded float32 frames,
+  /// with shape (frames, channels)
+  PyObject* readNew(Bw64Reader& reader, uint64_t frames) {
+    frames = std::min(frames, reader.numberOfFrames() - reader.tell());
+    const uint16_t channels = reader.channels();
+    Ref bytes(PyByteArray_FromStringAndSize(
+        nullptr, utils::safeCast<Py_ssize_t>(frames * channels *
+                                             sizeof(float))));
+    float* data = reinterpret_cast<float*>(PyByteArray_AS_STRING(bytes.get()));
+    {
+      GilRelease release;
+      reader.read(data, frames);
+    }
+    Ref view(PyMemoryView_FromObject(bytes.get()));
+    // memoryview.cast does not accept a zero dimension
+    if (frames == 0) return PyObject_CallMethod(view.get(), "cast", "s", "f");
+    return PyObject_CallMethod(view.get(), "cast", "s(nn)", "f",
+                               static_cast<Py_ssize_t>(frames),
+                               static_cast<Py_ssize_t>(channels));
+  }
+
+  PyObject* readerRead(PyObject* self, PyObject* arg) {
+    return guard([&]() -> PyObject* {
+      Bw64Reader& reader = unwrap<Bw64Reader>(self);
+      if (PyLong_Check(arg)) return readNew(reader, toFrames(arg));
+      Buffer out(arg, true);
+      return PyLong_FromUnsignedLongLong(readInto(reader, out, false));
+    });
+  }
+
+  PyObject* readerReadPlanar(PyObject* self, PyObject* arg) {
+    return guard([&] {
+      Buffer out(arg, true);
+      return PyLong_FromUnsignedLongLong(
+          readInto(unwrap<Bw64Reader>(self), out, true));
+    });
+  }
+
+  PyObject* readerReadRaw(PyObject* self, PyObject* arg) {
+    return guard([&]() -> PyObject* {
+      Bw64Reader& reader = unwrap<Bw64Reader>(self);
+      if (!PyLong_Check(arg)) {
+        Buffer out(arg, true);
+        uint64_t frames = rawFrameCount(out, reader.blockAlignment());
+        {
+          GilRelease release;
+          frames = reader.readRaw(out.data(), frames);
+        }
+        return PyLong_FromUnsignedLongLong(frames);
+      }
+      const uint64_t frames = std::min(
+          toFrames(arg), reader.numberOfFrames() - reader.tell());
+      Ref bytes(PyByteArray_FromStringAndSize(
+          nullptr,
+          utils::safeCast<Py_ssize_t>(frames * reader.blockAlignment())));
+      char* data = PyByteArray_AS_STRING(bytes.get());
+      {
+        GilRelease release;
+        reader.readRaw(data, frames);
+      }
+      // the view keeps a reference to the bytearray
+      return PyMemoryView_FromObject(bytes.get());
+    });
+  }
+
+  PyObject* readerSeek(PyObject* self, PyObject* args) {
+    long long offset;
+    int whence = 0;
+    if (!PyArg_ParseTuple(args, "L|i", &offset, &whence)) return nullptr;
+    return guard([&] {
+      Bw64Reader& reader = unwrap<Bw64Reader>(self);
+      reader.seek(offset, seekDir(whence));
+      return PyLong_FromUnsignedLongLong(reader.tell());
+    });
+  }
+
+  PyObject* readerTell(PyObject* self, PyObject*) {
+    return guard([&] {
+      return PyLong_FromUnsignedLongLong(unwrap<Bw64Reader>(self).tell());
+    });
+  }
+
+  PyObject* readerEof(PyObject* self, PyObject*) {
+    return guard(
+        [&] { return PyBool_FromLong(unwrap<Bw64Reader>(self).eof()); });
+  }
+
+  PyObject* readerChunks(PyObject* self, PyObject*) {
+    return guard([&] {
+      Ref chunks(PyList_New(0));
+      for (const ChunkHeader& header : unwrap<Bw64Reader>(self).chunks()) {
+        Ref chunk(Py_BuildValue("(sK)", utils::fourCCToStr(header.id).c_str(),
+                                static_cast<unsigned long long>(header.size)));
+        if (PyList_Append(chunks.get(), chunk.get()) != 0)
+          throw PythonErrorSet();
+      }
+      return chunks.release();
+    });
+  }
+
+  PyObject* readerAxml(PyObject* self, PyObject*) {
+    return guard([&]() -> PyObject* {
+      auto axml = unwrap<Bw64Reader>(self).axmlChunk();
+      if (!axml) Py_RETURN_NONE;
+      return PyBytes_FromStringAndSize(
+          axml->data().data(), static_cast<Py_ssize_t>(axml->data().size()));
+    });
+  }
+
+  PyObject* readerMarkers(PyObject* self, PyObject*) {
+    return guard([&] {
+      Ref markers(PyList_New(0));
+      for (const Marker& marker :
+           unwrap<Bw64Reader>(self).markers().markers()) {
+        Ref label(PyUnicode_DecodeUTF8(
+            marker.label.data(), static_cast<Py_ssize_t>(marker.label.size()),
+            "replace"));
+        Ref entry(Py_BuildValue("(KkO)",
+                                static_cast<unsigned long long>(marker.frame),
+                                static_cast<unsigned long>(marker.cueId),
+                                label.get()));
+        if (PyList_Append(markers.get(), entry.get()) != 0)
+          throw PythonErrorSet();
+      }
+      return markers.release();
+    });
+  }
+
+  Py_ssize_t readerLength(PyObject* self) {
+    Py_ssize_t length = -1;
+    guard([&] {
+      length = utils::safeCast<Py_ssize_t>(
+          unwrap<Bw64Reader>(self).numberOfFrames());
+      return true;
+    });
+    return length;
+  }
+
+  int readerInit(PyObject* self, PyObject* args, PyObject* kwds) {
+    static const char* keywords[] = {"filename", nullptr};
+    PyObject* filename = nullptr;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&",
+                                     const_cast<char**>(keywords),
+                                     PyUnicode_FSConverter, &filename))
+      return -1;
+    const bool opened = guard([&] {
+      Ref name(filename);
+      closeWrapped<Bw64Reader>(self);
+      reinterpret_cast<Wrapper<Bw64Reader>*>(self)->object =
+          new Bw64Reader(PyBytes_AS_STRING(name.get()));
+      return true;
+    });
+    return opened ? 0 : -1;
+  }
+
+  PyGetSetDef readerGetSet[] = {
+      {"format_tag", getUnsigned<Bw64Reader, uint16_t, &Bw64Reader::formatTag>,
+       nullptr, nullptr, nullptr},
+      {"channels", getUnsigned<Bw64Reader, uint16_t, &Bw64Reader::channels>,
+       nullptr, nullptr, nullptr},
+      {"sample_rate",
+       getUnsigned<Bw64Reader, uint32_t, &Bw64Reader::sampleRate>, nullptr,
+       nullptr, nullptr},
+      {"bit_depth", getUnsigned<Bw64Reader, uint16_t, &Bw64Reader::bitDepth>,
+       nullptr, nullptr, nullptr},
+      {"block_alignment",
+       getUnsigned<Bw64Reader, uint16_t, &Bw64Reader::blockAlignment>,
+       nullptr, nullptr, nullptr},
+      {"number_of_frames",
+       getUnsigned<Bw64Reader, uint64_t, &Bw64Reader::numberOfFrames>,
+       nullptr, nullptr, nullptr},
+      {"time_reference",
+       getUnsigned<Bw64Reader, uint64_t, &Bw64Reader::timeReference>,
+       nullptr, nullptr, nullptr},
+      {nullptr, nullptr, nullptr, nullptr, nullptr}};
+
+  PyMethodDef readerMethods[] = {
+      {"read", readerRead, METH_O,
+       "read(out) decodes frames into a writable float32 or float64 buffer "
+       "of shape (frames, channels) and returns the number of frames read; "
+       "read(frames) returns a float32 memoryview of shape (frames, "
+       "channels)"},
+      {"read_planar", readerReadPlanar, METH_O,
+       "decode frames into a writable float32 or float64 buffer of shape "
+       "(channels, frames); returns the number of frames read"},
+      {"read_raw", readerReadRaw, METH_O,
+       "read_raw(out) reads encoded frames into a writable buffer and "
+       "returns the number of frames read; read_raw(frames) returns a "
+       "memoryview of the PCM bytes"},
+      {"seek", readerSeek, METH_VARARGS,
+       "seek(offset, whence=0) seeks a frame, with whence as for "
+       "io.IOBase.seek; returns the new position"},
+      {"tell", readerTell, METH_NOARGS, "current frame"},
+      {"eof", readerEof, METH_NOARGS, "whether the end has been reached"},
+      {"chunks", readerChunks, METH_NOARGS,
+       "list of (id, size) of the chunks in the file"},
+      {"axml", readerAxml, METH_NOARGS, "axml chunk data, or None"},
+      {"markers", readerMarkers, METH_NOARGS,
+       "list of (frame, cue id, label) of the markers in the file"},
+      {"close", closeObject<Bw64Reader>, METH_NOARGS, "close the file"},
+      {"__enter__", enterContext, METH_NOARGS, nullptr},
+      {"__exit__", exitContext<Bw64Reader>, METH_VARARGS, nullptr},
+      {nullptr, nullptr, 0, nullptr}};
+
+  PyType_Slot readerSlots[] = {
+      {Py_tp_doc, const_cast<char*>("Reader(filename) reads a BW64 file")},
+      {Py_tp_new, reinterpret_cast<void*>(PyType_GenericNew)},
+      {Py_tp_init, reinterpret_cast<void*>(readerInit)},
+      {Py_tp_dealloc, reinterpret_cast<void*>(dealloc<Bw64Reader>)},
+      {Py_tp_methods, readerMethods},
+      {Py_tp_getset, readerGetSet},
+      {Py_sq_length, reinterpret_cast<void*>(readerLength)},
+      {0, nullptr}};
+
+  PyType_Spec readerSpec = {"bw64.Reader", sizeof(Wrapper<Bw64Reader>), 0,
+                            Py_TPFLAGS_DEFAULT, readerSlots};
+
+  // --- Writer ---
+
+  template <typename T>
+  uint64_t writeFrom(Bw64Writer& writer, const Buffer& in, bool planar) {
+    const uint64_t frames = frameCount(in.view(), writer.channels(), planar);
+    T* data = reinterpret_cast<T*>(in.data());
+    GilRelease release;
+    if (!planar) return writer.write(data, frames);
+    std::vector<const T*> channels(writer.channels());
+    for (uint16_t c = 0; c < writer.channels(); ++c)
+      channels[c] = data + c * frames;
+    return writer.writePlanar(channels.data(), frames);
+  }
+
+  PyObject* writerWrite(PyObject* self, PyObject* arg, bool planar) {
+    return guard([&] {
+      Bw64Writer& writer = unwrap<Bw64Writer>(self);
+      Buffer in(arg, false);
+      const uint64_t frames = sampleFormat(in.view()) == 'f'
+                                  ? writeFrom<float>(writer, in, planar)
+                                  : writeFrom<double>(writer, in, planar);
+      return PyLong_FromUnsignedLongLong(frames);
+    });
+  }
+
+  PyObject* writerWriteInterleaved(PyObject* self, PyObject* arg) {
+    return writerWrite(self, arg, false);
+  }
+
+  PyObject* writerWritePlanar(PyObject* self, PyObject* arg) {
+    return writerWrite(self, arg, true);
+  }
+
+  PyObject* writerWriteRaw(PyObject* self, PyObject* arg) {
+    return guard([&] {
+      Bw64Writer& writer = unwrap<Bw64Writer>(self);
+      Buffer in(arg, false);
+      uint64_t frames =
+          rawFrameCount(in, writer.formatChunk()->blockAlignment());
+      {
+        GilRelease release;
+        frames = writer.writeRaw(in.data(), frames);
+      }
+      return PyLong_FromUnsignedLongLong(frames);
+    });
+  }
+
+  PyObject* writerSetAxml(PyObject* self, PyObject* arg) {
+    return guard([&] {
+      Bw64Writer& writer = unwrap<Bw64Writer>(self);
+      std::string axml;
+      if (PyUnicode_Check(arg)) {
+        Py_ssize_t size;
+        const char* data = PyUnicode_AsUTF8AndSize(arg, &size);
+        if (!data) throw PythonErrorSet();
+        axml.assign(data, static_cast<size_t>(size));
+      } else {
+        Buffer in(arg, false);
+        axml.assign(in.data(), in.size());
+      }
+      writer.setAxmlChunk(std::make_shared<AxmlChunk>(std::move(axml)));
+      Py_RETURN_NONE;
+    });
+  }
+
+  PyObject* writerAddMarker(PyObject* self, PyObject* args) {
+    unsigned long long frame;
+    const char* label = "";
+    if (!PyArg_ParseTuple(args, "K|s", &frame, &label)) return nullptr;
+    return guard([&] {
+      return PyLong_FromUnsignedLong(
+          unwrap<Bw64Writer>(self).addMarker(frame, label));
+    });
+  }
+
+  int writerInit(PyObject* self, PyObject* args, PyObject* kwds) {
+    static const char* keywords[] = {"filename", "channels", "sample_rate",
+                                     "bit_depth", nullptr};
+    PyObject* filename = nullptr;
+    unsigned short channels = 1;
+    unsigned int sampleRate = 48000;
+    unsigned short bitDepth = 24;
+    if (!PyArg_ParseTupleAndKeywords(
+            args, kwds, "O&|HIH", const_cast<char**>(keywords),
+            PyUnicode_FSConverter, &filename, &channels, &sampleRate,
+            &bitDepth))
+      return -1;
+    const bool opened = guard([&] {
+      Ref name(filename);
+      closeWrapped<Bw64Writer>(self);
+      reinterpret_cast<Wrapper<Bw64Writer>*>(self)->object =
+          new Bw64Writer(PyBytes_AS_STRING(name.get()), channels, sampleRate,
+                         bitDepth, {});
+      return true;
+    });
+    return opened ? 0 : -1;
+  }
+
+  PyGetSetDef writerGetSet[] = {
+      {"format_tag", getUnsigned<Bw64Writer, uint16_t, &Bw64Writer::formatTag>,
+       nullptr, nullptr, nullptr},
+      {"channels", getUnsigned<Bw64Writer, uint16_t, &Bw64Writer::channels>,
+       nullptr, nullptr, nullptr},
+      {"sample_rate",
+       getUnsigned<Bw64Writer, uint32_t, &Bw64Writer::sampleRate>, nullptr,
+       nullptr, nullptr},
+      {"bit_depth", getUnsigned<Bw64Writer, uint16_t, &Bw64Writer::bitDepth>,
+       nullptr, nullptr, nullptr},
+      {"frames_written",
+       getUnsigned<Bw64Writer, uint64_t, &Bw64Writer::framesWritten>, nullptr,
+       nullptr, nullptr},
+      {nullptr, nullptr, nullptr, nullptr, nullptr}};
+
+  PyMethodDef writerMethods[] = {
+      {"write", writerWriteInterleaved, METH_O,
+       "encode and write frames from a float32 or float64 buffer of shape "
+       "(frames, channels); returns the number of frames written"},
+      {"write_planar", writerWritePlanar, METH_O,
+       "encode and write frames from a float32 or float64 buffer of shape "
+       "(channels, frames); returns the number of frames written"},
+      {"write_raw", writerWriteRaw, METH_O,
+       "write encoded frames from a bytes-like object"},
+      {"set_axml", writerSetAxml, METH_O,
+       "set the axml chunk from a str or bytes-like object"},
+      {"add_marker", writerAddMarker, METH_VARARGS,
+       "add_marker(frame, label='') adds a marker; returns its cue id"},
+      {"close", closeObject<Bw64Writer>, METH_NOARGS,
+       "finalise and close the file"},
+      {"__enter__", enterContext, METH_NOARGS, nullptr},
+      {"__exit__", exitContext<Bw64Writer>, METH_VARARGS, nullptr},
+      {nullptr, nullptr, 0, nullptr}};
+
+  PyType_Slot writerSlots[] = {
+      {Py_tp_doc,
+       const_cast<char*>("Writer(filename, channels=1, sample_rate=48000, "
+                         "bit_depth=24) writes a BW64 file")},
+      {Py_tp_new, reinterpret_cast<void*>(PyType_GenericNew)},
+      {Py_tp_init, reinterpret_cast<void*>(writerInit)},
+      {Py_tp_dealloc, reinterpret_cast<void*>(dealloc<Bw64Writer>)},
+      {Py_tp_methods, writerMethods},
+      {Py_tp_getset, writerGetSet},
+      {0, nullptr}};
+
+  PyType_Spec writerSpec = {"bw64.Writer", sizeof(Wrapper<Bw64Writer>), 0,
+                            Py_TPFLAGS_DEFAULT, writerSlots};
+
+  PyModuleDef moduleDef = {PyModuleDef_HEAD_INIT,
+                           "bw64",
+                           "Read and write BW64 (ITU-R BS.2088) files",
+                           -1,
+                           nullptr,
+                           nullptr,
+                           nullptr,
+                           nullptr,
+                           nullptr};
+
+  bool addType(PyObject* module, const char* name, PyType_Spec* spec) {
+    PyObject* type = PyType_FromSpec(spec);
+    if (!type) return false;
+    if (PyModule_AddObject(module, name, type) != 0) {
+      Py_DECREF(type);
+      return false;
+    }
+    return true;
+  }
+
+}  // namespace
+
+PyMODINIT_FUNC PyInit_bw64(void) {
+  PyObject* module = PyModule_Create(&moduleDef);
+  if (!module) return nullptr;
+  if (!addType(module, "Reader", &readerSpec) ||
+      !addType(module, "Writer", &writerSpec)) {
+    Py_DECREF(module);
+    return nullptr;
+  }
+  return module;
+}
@@ -0,0 +1,149 @@
+import array
+import os
+import unittest
+
+import bw64
+
+try:
+    import numpy as np
+except ImportError:
+    np = None
+
+TEST_DIR = os.environ.get("BW64_TEST_DIR", ".")
+
+
+def path(name):
+    return os.path.join(TEST_DIR, name)
+
+
+def flatten(view):
+    return [s for frame in view.tolist() for s in frame]
+
+
+def sample(frame, channel):
+    return (frame % 100) / 128 - channel / 4
+
+
+class ReadWriteTest(unittest.TestCase):
+    def setUp(self):
+        self.data = array.array(
+            "f", [sample(f, c) for f in range(1000) for c in range(2)]
+        )
+        with bw64.Writer(path("python.wav"), 2, 48000, 24) as writer:
+            self.assertEqual(writer.write(self.data), 1000)
+            writer.set_axml(b"<xml/>")
+            writer.add_marker(10, "ten")
+            self.assertEqual(writer.frames_written, 1000)
+
+    def assertSamples(self, samples, expected):
+        self.assertEqual(len(samples), len(expected))
+        for a, b in zip(samples, expected):
+            self.assertAlmostEqual(a, b, delta=1e-6)
+
+    def test_format(self):
+        with bw64.Reader(path("python.wav")) as reader:
+            self.assertEqual(reader.channels, 2)
+            self.assertEqual(reader.sample_rate, 48000)
+            self.assertEqual(reader.bit_depth, 24)
+            self.assertEqual(reader.block_alignment, 6)
+            self.assertEqual(len(reader), 1000)
+            self.assertEqual(reader.axml(), b"<xml/>")
+            self.assertEqual(reader.markers(), [(10, 1, "ten")])
+            self.assertIn(("data", 6000), reader.chunks())
+        with self.assertRaises(ValueError):
+            reader.tell()
+
+    def test_read_into(self):
+        reader = bw64.Reader(path("python.wav"))
+        out = array.array("f", bytes(4 * 1200))
+        self.assertEqual(reader.read(out), 600)
+        self.assertSamples(out, self.data[:1200])
+        self.assertEqual(reader.read(out), 400)
+        self.assertSamples(out[:800], self.data[1200:])
+        self.assertTrue(reader.eof())
+
+        self.assertEqual(reader.seek(0), 0)
+        planar = array.array("d", bytes(8 * 2000))
+        self.assertEqual(reader.read_planar(planar), 1000)
+        self.assertSamples(planar[:1000], self.data[0::2])
+        self.assertSamples(planar[1000:], self.data[1::2])
+
+    def test_read_new(self):
+        reader = bw64.Reader(path("python.wav"))
+        reader.seek(-10, 2)
+        view = reader.read(100)
+        self.assertIsInstance(view, memoryview)
+        self.assertEqual(view.format, "f")
+        self.assertEqual(view.shape, (10, 2))
+        self.assertSamples(flatten(view), self.data[-20:])
+        self.assertEqual(len(reader.read(100)), 0)
+
+    def test_wrong_buffer(self):
+        reader = bw64.Reader(path("python.wav"))
+        with self.assertRaises(TypeError):
+            reader.read(array.array("h", bytes(40)))
+        with self.assertRaises(BufferError):
+            reader.read(bytes(40))
+        with self.assertRaises(ValueError):
+            reader.read(array.array("f", bytes(12)))
+        with self.assertRaises(ValueError):
+            reader.read(memoryview(bytearray(24)).cast("f", (2, 3)))
+        self.assertEqual(reader.tell(), 0)
+
+    def test_read_raw(self):
+        reader = bw64.Reader(path("python.wav"))
+        reader.seek(-10, 2)
+        raw = reader.read_raw(100)
+        self.assertIsInstance(raw, memoryview)
+        self.assertEqual(raw.nbytes, 10 * reader.block_alignment)
+        self.assertTrue(reader.eof())
+
+        reader.seek(0)
+        out = bytearray(10 * reader.block_alignment)
+        self.assertEqual(reader.read_raw(out), 10)
+        reader.seek(0)
+        self.assertEqual(reader.read_raw(10), out)
+        with self.assertRaises(ValueError):
+            reader.read_raw(bytearray(5))
+
+    def test_write_raw(self):
+        samples = array.array("h", [0, 16384, -16384])
+        with bw64.Writer(path("python_raw.wav"), 1, 48000, 16) as writer:
+            self.assertEqual(writer.write_raw(samples), 3)
+            with self.assertRaises(ValueError):
+                writer.write_raw(b"\0")
+        reader = bw64.Reader(path("python_raw.wav"))
+        self.assertEqual(flatten(reader.read(3)), [0, 0.5, -0.5])
+
+    @unittest.skipUnless(np, "numpy is not installed")
+    def test_numpy(self):
+        data = np.frombuffer(self.data, dtype=np.float32).reshape(1000, 2)
+        reader = bw64.Reader(path("python.wav"))
+        out = np.zeros((1000, 2), dtype=np.float64)
+        self.assertEqual(reader.read(out), 1000)
+        np.testing.assert_allclose(out, data, atol=1e-6)
+
+        reader.seek(0)
+        planar = np.zeros((2, 1000), dtype=np.float32)
+        self.assertEqual(reader.read_planar(planar), 1000)
+        np.testing.assert_allclose(planar, data.T, atol=1e-6)
+
+        reader.seek(0)
+        view = reader.read(1000)
+        np.testing.assert_allclose(np.asarray(view), data, atol=1e-6)
+
+        with self.assertRaises(TypeError):
+            reader.read(np.zeros((2, 10), dtype=np.float32).T)
+        with self.assertRaises(ValueError):
+            reader.read(np.zeros((10, 3), dtype=np.float32))
+
+        with bw64.Writer(path("python_planar.wav"), 2, 48000, 24) as writer:
+            planar = np.ascontiguousarray(data.T)
+            self.assertEqual(writer.write_planar(planar), 1000)
+        reader = bw64.Reader(path("python_planar.wav"))
+        view = reader.read(1000)
+        np.testing.assert_allclose(np.asarray(view), data, atol=1e-6)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,286 @@
+#include "bw64/bw64_c.h"
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "bw64/bw64.hpp"
+
+struct bw64_reader {
+  std::unique_ptr<bw64::Bw64Reader> reader;
+  std::vector<char> view;
+  /// chunk contents returned by bw64_reader_chunk_data
+  std::map<uint32_t, std::string> chunkData;
+};
+
+struct bw64_writer {
+  std::unique_ptr<bw64::Bw64Writer> writer;
+  std::vector<char> buffer;
+};
+
+namespace {
+
+  thread_local std::string lastError;
+
+  bw64_status fail(bw64_status status, const std::string& message) {
+    lastError = message;
+    return status;
+  }
+
+  bw64_status invalidArgument(const char* function) {
+    return fail(BW64_INVALID_ARGUMENT,
+                std::string("invalid argument to ") + function);
+  }
+
+  /// run `f`, translating exceptions to a status
+  template <typename F>
+  bw64_status guard(F f) {
+    try {
+      f();
+      return BW64_OK;
+    } catch (const std::exception& e) {
+      return fail(BW64_ERROR, e.what());
+    } catch (...) {
+      return fail(BW64_ERROR, "unknown error");
+    }
+  }
+
+}  // namespace
+
+const char* bw64_last_error(void) { return lastError.c_str(); }
+
+uint32_t bw64_fourcc(const char* id) {
+  if (!id) return 0;
+  char value[5] = {' ', ' ', ' ', ' ', '\0'};
+  for (size_t i = 0; i < 4 && id[i]; ++i) value[i] = id[i];
+  return bw64::utils::fourCC(value);
+}
+
+bw64_status bw64_reader_open(const char* filename, bw64_reader** reader) {
+  if (!filename || !reader) return invalidArgument(__func__);
+  *reader = nullptr;
+  return guard([&] {
+    std::unique_ptr<bw64_reader> handle(new bw64_reader);
+    handle->reader.reset(new bw64::Bw64Reader(filename));
+    *reader = handle.release();
+  });
+}
+
+void bw64_reader_close(bw64_reader* reader) { delete reader; }
+
+bw64_status bw64_reader_format(const bw64_reader* reader,
+                               bw64_format* format) {
+  if (!reader || !format) return invalidArgument(__func__);
+  const bw64::Bw64Reader& r = *reader->reader;
+  format->format_tag = r.formatTag();
+  format->channels = r.channels();
+  format->sample_rate = r.sampleRate();
+  format->bit_depth = r.bitDepth();
+  format->block_alignment = r.blockAlignment();
+  format->number_of_frames = r.numberOfFrames();
+  return BW64_OK;
+}
+
+bw64_status bw64_reader_tell(const bw64_reader* reader, uint64_t* frame) {
+  if (!reader || !frame) return invalidArgument(__func__);
+  *frame = reader->reader->tell();
+  return BW64_OK;
+}
+
+bw64_status bw64_reader_seek(bw64_reader* reader, int64_t offset,
+                             bw64_seek_origin origin) {
+  if (!reader) return invalidArgument(__func__);
+  std::ios_base::seekdir way;
+  switch (origin) {
+    case BW64_SEEK_SET:
+      way = std::ios::beg;
+      break;
+    case BW64_SEEK_CUR:
+      way = std::ios::cur;
+      break;
+    case BW64_SEEK_END:
+      way = std::ios::end;
+      break;
+    default:
+      return invalidArgument(__func__);
+  }
+  return guard([&] { reader->reader->seek(offset, way); });
+}
+
+bw64_status bw64_reader_read(bw64_reader* reader, float* out, uint64_t frames,
+                             uint64_t* frames_read) {
+  if (!reader || (!out && frames)) return invalidArgument(__func__);
+  return guard([&] {
+    const uint64_t n = reader->reader->read(out, frames);
+    if (frames_read) *frames_read = n;
+  });
+}
+
+bw64_status bw64_reader_read_planar(bw64_reader* reader, float* const* out,
+                                    uint64_t frames, uint64_t* frames_read) {
+  if (!reader || (!out && frames)) return invalidArgument(__func__);
+  return guard([&] {
+    const uint64_t n = reader->reader->readPlanar(out, frames);
+    if (frames_read) *frames_read = n;
+  });
+}
+
+bw64_status bw64_reader_read_raw(bw64_reader* reader, void* out,
+                                 uint64_t frames, uint64_t* frames_read) {
+  if (!reader || (!out && frames)) return invalidArgument(__func__);
+  return guard([&] {
+    const uint64_t n =
+        reader->reader->readRaw(static_cast<char*>(out), frames);
+    if (frames_read) *frames_read = n;
+  });
+}
+
+bw64_status bw64_reader_read_raw_view(bw64_reader* reader, uint64_t frames,
+                                      const void** data,
+                                      uint64_t* frames_read) {
+  if (!reader || !data) return invalidArgument(__func__);
+  return guard([&] {
+    bw64::Bw64Reader& r = *reader->reader;
+    frames = std::min(frames, r.numberOfFrames() - r.tell());
+    reader->view.resize(
+        bw64::utils::safeCast<size_t>(frames * r.blockAlignment()));
+    const uint64_t n = r.readRaw(reader->view.data(), frames);
+    *data = reader->view.data();
+    if (frames_read) *frames_read = n;
+  });
+}
+
+bw64_status bw64_reader_chunk_count(const bw64_reader* reader, size_t* count) {
+  if (!reader || !count) return invalidArgument(__func__);
+  *count = reader->reader->chunks().size();
+  return BW64_OK;
+}
+
+bw64_status bw64_reader_chunk_info(const bw64_reader* reader, size_t index,
+                                   uint32_t* id, uint64_t* size) {
+  if (!reader) return invalidArgument(__func__);
+  const std::vector<bw64::ChunkHeader> headers = reader->reader->chunks();
+  if (index >= headers.size()) return invalidArgument(__func__);
+  if (id) *id = headers[index].id;
+  if (size) *size = headers[index].size;
+  return BW64_OK;
+}
+
+bw64_status bw64_reader_chunk_data(bw64_reader* reader, uint32_t id,
+                                   const void** data, uint64_t* size) {
+  if (!reader || !data || !size) return invalidArgument(__func__);
+  if (id == bw64::utils::fourCC("data") || !reader->reader->hasChunk(id)) {
+    return fail(BW64_NOT_FOUND, "chunk not available: " +
+                                    bw64::utils::fourCCToStr(id));
+  }
+  return guard([&] {
+    // the axml chunk can be large, so point straight into it
+    if (id == bw64::utils::fourCC("axml")) {
+      if (auto axml = reader->reader->axmlChunk()) {
+        *data = axml->data().data();
+        *size = axml->data().size();
+        return;
+      }
+    }
+    // other chunks are copied from the file rather than serialised, as
+    // parsed chunks may not hold all of their data
+    auto found = reader->chunkData.find(id);
+    if (found == reader->chunkData.end()) {
+      found = reader->chunkData.emplace(id, reader->reader->readChunkData(id))
+                  .first;
+    }
+    *data = found->second.data();
+    *size = found->second.size();
+  });
+}
+
+bw64_status bw64_writer_open(const char* filename, uint16_t channels,
+                             uint32_t sample_rate, uint16_t bit_depth,
+                             bw64_writer** writer) {
+  if (!filename || !writer) return invalidArgument(__func__);
+  *writer = nullptr;
+  return guard([&] {
+    std::unique_ptr<bw64_writer> handle(new bw64_writer);
+    handle->writer.reset(new bw64::Bw64Writer(filename, channels, sample_rate,
+                                              bit_depth, {}));
+    *writer = handle.release();
+  });
+}
+
+bw64_status bw64_writer_close(bw64_writer* writer) {
+  if (!writer) return BW64_OK;
+  std::unique_ptr<bw64_writer> handle(writer);
+  return guard([&] { handle->writer->close(); });
+}
+
+bw64_status bw64_writer_format(const bw64_writer* writer,
+                               bw64_format* format) {
+  if (!writer || !format) return invalidArgument(__func__);
+  const bw64::Bw64Writer& w = *writer->writer;
+  format->format_tag = w.formatTag();
+  format->channels = w.channels();
+  format->sample_rate = w.sampleRate();
+  format->bit_depth = w.bitDepth();
+  format->block_alignment = w.formatChunk()->blockAlignment();
+  format->number_of_frames = w.framesWritten();
+  return BW64_OK;
+}
+
+bw64_status bw64_writer_write(bw64_writer* writer, const float* in,
+                              uint64_t frames) {
+  if (!writer || (!in && frames)) return invalidArgument(__func__);
+  return guard([&] { writer->writer->write(in, frames); });
+}
+
+bw64_status bw64_writer_write_planar(bw64_writer* writer,
+                                     const float* const* in, uint64_t frames) {
+  if (!writer || (!in && frames)) return invalidArgument(__func__);
+  return guard([&] { writer->writer->writePlanar(in, frames); });
+}
+
+bw64_status bw64_writer_write_raw(bw64_writer* writer, const void* in,
+                                  uint64_t frames) {
+  if (!writer || (!in && frames)) return invalidArgument(__func__);
+  return guard([&] {
+    writer->writer->writeRaw(static_cast<const char*>(in), frames);
+  });
+}
+
+bw64_status bw64_writer_buffer(bw64_writer* writer, uint64_t frames,
+                               void** data) {
+  if (!writer || !data) return invalidArgument(__func__);
+  return guard([&] {
+    writer->buffer.resize(bw64::utils::safeCast<size_t>(
+        frames * writer->writer->formatChunk()->blockAlignment()));
+    *data = writer->buffer.data();
+  });
+}
+
+bw64_status bw64_writer_commit(bw64_writer* writer, uint64_t frames) {
+  if (!writer) return invalidArgument(__func__);
+  const uint64_t blockAlignment =
+      writer->writer->formatChunk()->blockAlignment();
+  if (frames > writer->buffer.size() / blockAlignment)
+    return fail(BW64_INVALID_ARGUMENT,
+                "more frames committed than requested from bw64_writer_buffer");
+  return guard(
+      [&] { writer->writer->writeRaw(writer->buffer.data(), frames); });
+}
+
+bw64_status bw64_writer_set_axml(bw64_writer* writer, const char* data,
+                                 size_t size) {
+  if (!writer || (!data && size)) return invalidArgument(__func__);
+  return guard([&] {
+    writer->writer->setAxmlChunk(
+        std::make_shared<bw64::AxmlChunk>(std::string(data, size)));
+  });
+}
+
+bw64_status bw64_writer_add_marker(bw64_writer* writer, uint64_t frame,
+                                   const char* label, uint32_t* cue_id) {
+  if (!writer) return invalidArgument(__func__);
+  return guard([&] {
+    const uint32_t id = writer->writer->addMarker(frame, label ? label : "");
+    if (cue_id) *cue_id = id;
+  });
+}
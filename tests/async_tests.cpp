@@ -0,0 +1,63 @@
+#include <catch2/catch.hpp>
+#include <coroutine>
+#include <exception>
+#include <future>
+#include <vector>
+#include "bw64/async.hpp"
+#include "bw64/bw64.hpp"
+
+using namespace bw64;
+
+/// fire-and-forget coroutine which reports its completion to a future
+struct Job {
+  struct promise_type {
+    std::promise<void> done;
+    Job get_return_object() { return Job{done.get_future()}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() { done.set_value(); }
+    void unhandled_exception() {
+      done.set_exception(std::current_exception());
+    }
+  };
+  std::future<void> done;
+};
+
+// runs on the executor threads, so results are checked by the caller
+Job writeAndRead(Executor& executor, std::vector<float>& written,
+                 std::vector<float>& read, uint64_t& framesRead) {
+  {
+    auto writer = writeFile("async_write_read.wav", 2, 48000, 24);
+    co_await asyncWrite(executor, *writer, written.data(), written.size() / 2);
+    co_await asyncClose(executor, *writer);
+  }
+
+  auto reader = co_await asyncOpen(executor, "async_write_read.wav");
+  framesRead = 0;
+  while (!reader->eof())
+    framesRead +=
+        co_await asyncRead(executor, *reader, &read[framesRead * 2], 100);
+}
+
+Job openMissing(Executor& executor) {
+  co_await asyncOpen(executor, "file_not_found.wav");
+}
+
+TEST_CASE("async_write_read") {
+  ThreadPoolExecutor executor(2);
+  std::vector<float> written(2 * 1000);
+  for (size_t i = 0; i < written.size(); ++i)
+    written[i] = static_cast<float>(i % 100) / 128.f;
+  std::vector<float> read(written.size());
+  uint64_t framesRead = 0;
+
+  writeAndRead(executor, written, read, framesRead).done.get();
+  REQUIRE(framesRead == 1000);
+  for (size_t i = 0; i < written.size(); ++i)
+    REQUIRE(read[i] == Approx(written[i]).margin(1e-6));
+}
+
+TEST_CASE("async_error") {
+  ThreadPoolExecutor executor(1);
+  REQUIRE_THROWS_AS(openMissing(executor).done.get(), std::runtime_error);
+}
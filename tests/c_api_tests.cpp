@@ -0,0 +1,164 @@
+#include <catch2/catch.hpp>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "bw64/bw64.hpp"
+#include "bw64/bw64_c.h"
+
+extern "C" int cApiWritePlanar(const char* filename, uint64_t frames);
+
+/// samples written by cApiWritePlanar(); the C file can't use the C++ test
+/// helpers, so this must match it
+float cApiSample(uint64_t frame, int channel) {
+  return static_cast<float>(frame % 100) / 128.f * (channel ? -1.f : 1.f);
+}
+
+TEST_CASE("c_api_write_read") {
+  REQUIRE(cApiWritePlanar("c_api.wav", 1000) == 0);
+
+  bw64_reader* reader = nullptr;
+  REQUIRE(bw64_reader_open("c_api.wav", &reader) == BW64_OK);
+  bw64_format format;
+  REQUIRE(bw64_reader_format(reader, &format) == BW64_OK);
+  REQUIRE(format.channels == 2);
+  REQUIRE(format.sample_rate == 48000);
+  REQUIRE(format.bit_depth == 24);
+  REQUIRE(format.block_alignment == 6);
+  REQUIRE(format.number_of_frames == 1000);
+
+  SECTION("interleaved") {
+    std::vector<float> data(2000);
+    uint64_t read = 0;
+    REQUIRE(bw64_reader_read(reader, data.data(), 1000, &read) == BW64_OK);
+    REQUIRE(read == 1000);
+    for (uint64_t f = 0; f < 1000; ++f)
+      for (int c = 0; c < 2; ++c)
+        REQUIRE(data[f * 2 + c] == Approx(cApiSample(f, c)).margin(1e-6));
+  }
+
+  SECTION("planar") {
+    REQUIRE(bw64_reader_seek(reader, -100, BW64_SEEK_END) == BW64_OK);
+    std::vector<float> left(200), right(200);
+    float* channels[] = {left.data(), right.data()};
+    uint64_t read = 0;
+    REQUIRE(bw64_reader_read_planar(reader, channels, 200, &read) == BW64_OK);
+    REQUIRE(read == 100);
+    for (uint64_t f = 0; f < 100; ++f) {
+      REQUIRE(left[f] == Approx(cApiSample(f + 900, 0)).margin(1e-6));
+      REQUIRE(right[f] == Approx(cApiSample(f + 900, 1)).margin(1e-6));
+    }
+    uint64_t position = 0;
+    REQUIRE(bw64_reader_tell(reader, &position) == BW64_OK);
+    REQUIRE(position == 1000);
+  }
+
+  SECTION("raw view") {
+    REQUIRE(bw64_reader_seek(reader, 10, BW64_SEEK_SET) == BW64_OK);
+    const void* view = nullptr;
+    uint64_t read = 0;
+    REQUIRE(bw64_reader_read_raw_view(reader, 5, &view, &read) == BW64_OK);
+    REQUIRE(read == 5);
+    std::vector<float> decoded(10);
+    bw64::utils::decodePcmSamples(static_cast<const char*>(view),
+                                  decoded.data(), 10, 24);
+    REQUIRE(decoded[0] == Approx(cApiSample(10, 0)).margin(1e-6));
+    REQUIRE(decoded[9] == Approx(cApiSample(14, 1)).margin(1e-6));
+  }
+
+  SECTION("chunks") {
+    size_t count = 0;
+    REQUIRE(bw64_reader_chunk_count(reader, &count) == BW64_OK);
+    REQUIRE(count > 2);
+    uint32_t id = 0;
+    REQUIRE(bw64_reader_chunk_info(reader, 0, &id, nullptr) == BW64_OK);
+    REQUIRE(id == bw64_fourcc("JUNK"));
+    REQUIRE(bw64_reader_chunk_info(reader, count, &id, nullptr) ==
+            BW64_INVALID_ARGUMENT);
+
+    const void* data = nullptr;
+    uint64_t size = 0;
+    REQUIRE(bw64_reader_chunk_data(reader, bw64_fourcc("axml"), &data,
+                                   &size) == BW64_OK);
+    REQUIRE(std::string(static_cast<const char*>(data), size) == "<xml/>");
+    REQUIRE(bw64_reader_chunk_data(reader, bw64_fourcc("fmt"), &data,
+                                   &size) == BW64_OK);
+    REQUIRE(size == 16);
+    REQUIRE(bw64_reader_chunk_data(reader, bw64_fourcc("bext"), &data,
+                                   &size) == BW64_NOT_FOUND);
+    REQUIRE(bw64_reader_chunk_data(reader, bw64_fourcc("data"), &data,
+                                   &size) == BW64_NOT_FOUND);
+  }
+
+  bw64_reader_close(reader);
+}
+
+TEST_CASE("c_api_chunk_data_bext") {
+  const std::string codingHistory = "A=PCM,F=48000,W=16,M=mono\r\n";
+  {
+    auto bext = std::make_shared<bw64::BextChunk>();
+    bext->timeReference(48000);
+    bext->codingHistory(codingHistory);
+    bw64::Bw64Writer writer("c_api_bext.wav", 1, 48000, 16, {bext});
+    writer.close();
+  }
+
+  bw64_reader* reader = nullptr;
+  REQUIRE(bw64_reader_open("c_api_bext.wav", &reader) == BW64_OK);
+  const void* data = nullptr;
+  uint64_t size = 0;
+  // the CodingHistory is not loaded when opening the file, but is returned
+  REQUIRE(bw64_reader_chunk_data(reader, bw64_fourcc("bext"), &data,
+                                 &size) == BW64_OK);
+  REQUIRE(size == bw64::BextChunk::fixedSize() + codingHistory.size());
+  const char* bytes = static_cast<const char*>(data);
+  REQUIRE(std::string(bytes + bw64::BextChunk::fixedSize(),
+                      codingHistory.size()) == codingHistory);
+  // TimeReference, low word first, at offset 338
+  uint32_t timeReferenceLow = 0;
+  std::memcpy(&timeReferenceLow, bytes + 338, 4);
+  REQUIRE(timeReferenceLow == 48000);
+  bw64_reader_close(reader);
+}
+
+TEST_CASE("c_api_writer_buffer") {
+  bw64_writer* writer = nullptr;
+  REQUIRE(bw64_writer_open("c_api_buffer.wav", 1, 48000, 16, &writer) ==
+          BW64_OK);
+  void* buffer = nullptr;
+  REQUIRE(bw64_writer_buffer(writer, 4, &buffer) == BW64_OK);
+  const int16_t samples[] = {0, 16384, -16384, 32767};
+  std::memcpy(buffer, samples, sizeof(samples));
+  REQUIRE(bw64_writer_commit(writer, 5) == BW64_INVALID_ARGUMENT);
+  REQUIRE(bw64_writer_commit(writer, 4) == BW64_OK);
+  uint32_t cueId = 0;
+  REQUIRE(bw64_writer_add_marker(writer, 2, "two", &cueId) == BW64_OK);
+  bw64_format format;
+  REQUIRE(bw64_writer_format(writer, &format) == BW64_OK);
+  REQUIRE(format.number_of_frames == 4);
+  REQUIRE(bw64_writer_close(writer) == BW64_OK);
+
+  auto reader = bw64::readFile("c_api_buffer.wav");
+  std::vector<float> data(4);
+  reader->read(data.data(), 4);
+  REQUIRE(data[1] == 0.5f);
+  REQUIRE(data[2] == -0.5f);
+  REQUIRE(reader->markers().size() == 1);
+  REQUIRE(reader->markers()[0].frame == 2);
+}
+
+TEST_CASE("c_api_errors") {
+  bw64_reader* reader = nullptr;
+  REQUIRE(bw64_reader_open("file_not_found.wav", &reader) == BW64_ERROR);
+  REQUIRE(reader == nullptr);
+  REQUIRE(std::string(bw64_last_error()).find("file_not_found.wav") !=
+          std::string::npos);
+  REQUIRE(bw64_reader_open(nullptr, &reader) == BW64_INVALID_ARGUMENT);
+  REQUIRE(bw64_reader_format(nullptr, nullptr) == BW64_INVALID_ARGUMENT);
+  bw64_reader_close(nullptr);
+
+  bw64_writer* writer = nullptr;
+  REQUIRE(bw64_writer_open("c_api_error.wav", 1, 48000, 12, &writer) ==
+          BW64_ERROR);
+  REQUIRE(writer == nullptr);
+  REQUIRE(bw64_writer_close(nullptr) == BW64_OK);
+}
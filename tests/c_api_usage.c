@@ -0,0 +1,24 @@
+/* checks that bw64_c.h can be used from C */
+#include <stdlib.h>
+#include <string.h>
+#include "bw64/bw64_c.h"
+
+int cApiWritePlanar(const char* filename, uint64_t frames) {
+  bw64_writer* writer = NULL;
+  float* channels[2];
+  uint64_t i;
+  int c;
+  if (bw64_writer_open(filename, 2, 48000, 24, &writer) != BW64_OK) return 1;
+  for (c = 0; c < 2; ++c) {
+    channels[c] = (float*)malloc(frames * sizeof(float));
+    for (i = 0; i < frames; ++i)
+      channels[c][i] = (float)(i % 100) / 128.f * (c ? -1.f : 1.f);
+  }
+  if (bw64_writer_write_planar(writer, (const float* const*)channels,
+                               frames) != BW64_OK)
+    return 2;
+  for (c = 0; c < 2; ++c) free(channels[c]);
+  if (bw64_writer_set_axml(writer, "<xml/>", strlen("<xml/>")) != BW64_OK)
+    return 3;
+  return bw64_writer_close(writer) == BW64_OK ? 0 : 4;
+}
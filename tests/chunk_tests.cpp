@@ -376,6 +376,113 @@ TEST_CASE("axml_chunk") {
   REQUIRE(stream.str() == str_data);
 }
 
+TEST_CASE("bext_chunk") {
+  BextChunk chunk;
+  chunk.description("description");
+  chunk.originator("originator");
+  chunk.originationDate("2020-01-02");
+  chunk.originationTime("03-04-05");
+  chunk.timeReference(0x123456789ull);
+  chunk.loudnessValue(-2300);
+  chunk.maxTruePeakLevel(-100);
+  std::string umid(64, 'u');
+  chunk.umid(umid.data());
+  chunk.codingHistory("A=PCM,F=48000,W=24,M=stereo\r\n");
+  REQUIRE(chunk.size() == BextChunk::fixedSize() + 29);
+  REQUIRE_THROWS_AS(chunk.originationTime("03-04-05-06"), std::runtime_error);
+
+  std::stringstream stream;
+  chunk.write(stream);
+  REQUIRE(stream.str().size() == chunk.size());
+
+  SECTION("without coding history") {
+    auto parsed = parseBextChunk(stream, utils::fourCC("bext"), chunk.size());
+    REQUIRE(parsed->description() == "description");
+    REQUIRE(parsed->originator() == "originator");
+    REQUIRE(parsed->originatorReference() == "");
+    REQUIRE(parsed->originationDate() == "2020-01-02");
+    REQUIRE(parsed->originationTime() == "03-04-05");
+    REQUIRE(parsed->timeReference() == 0x123456789ull);
+    REQUIRE(parsed->version() == 2);
+    REQUIRE(std::string(parsed->umid(), 64) == umid);
+    REQUIRE(parsed->loudnessValue() == -2300);
+    REQUIRE(parsed->loudnessRange() == 0x7fff);
+    REQUIRE(parsed->maxTruePeakLevel() == -100);
+    REQUIRE(parsed->codingHistorySize() == 29);
+    REQUIRE_FALSE(parsed->hasCodingHistory());
+    REQUIRE(parsed->size() == chunk.size());
+    std::stringstream copy;
+    REQUIRE_THROWS_AS(parsed->write(copy), std::runtime_error);
+    parsed->codingHistory("");
+    REQUIRE(parsed->size() == BextChunk::fixedSize());
+    parsed->write(copy);
+    REQUIRE(copy.str().size() == BextChunk::fixedSize());
+  }
+  SECTION("with coding history") {
+    auto parsed = parseBextChunkWithCodingHistory(
+        stream, utils::fourCC("bext"), chunk.size());
+    REQUIRE(parsed->hasCodingHistory());
+    REQUIRE(parsed->codingHistory() == chunk.codingHistory());
+    REQUIRE(parsed->size() == chunk.size());
+  }
+  SECTION("too small") {
+    REQUIRE_THROWS_AS(parseBextChunk(stream, utils::fourCC("bext"), 601),
+                      std::runtime_error);
+  }
+}
+
+TEST_CASE("cue_chunk") {
+  CueChunk chunk;
+  chunk.addCuePoint(CuePoint{1, 0, utils::fourCC("data"), 0, 0, 1000});
+  chunk.addCuePoint(CuePoint{2, 1, utils::fourCC("data"), 0, 0, 10});
+  REQUIRE(chunk.size() == 4 + 2 * 24);
+
+  std::stringstream stream;
+  chunk.write(stream);
+  REQUIRE(stream.str().size() == chunk.size());
+
+  auto parsed = parseCueChunk(stream, utils::fourCC("cue "), chunk.size());
+  REQUIRE(parsed->cuePoints().size() == 2);
+  REQUIRE(parsed->cuePoints()[0].id == 1);
+  REQUIRE(parsed->cuePoints()[0].sampleOffset == 1000);
+  REQUIRE(parsed->cuePoints()[1].id == 2);
+  REQUIRE(parsed->cuePoints()[1].sampleOffset == 10);
+
+  std::stringstream truncated(stream.str());
+  REQUIRE_THROWS_AS(parseCueChunk(truncated, utils::fourCC("cue "), 28),
+                    std::runtime_error);
+}
+
+TEST_CASE("adtl_chunk") {
+  AdtlChunk chunk;
+  chunk.addLabel(1, "one");
+  chunk.addNote(1, "note");
+  chunk.addLabel(2, "two!");
+
+  std::stringstream stream;
+  chunk.write(stream);
+  REQUIRE(stream.str().size() == chunk.size());
+
+  auto parsed = std::dynamic_pointer_cast<AdtlChunk>(
+      parseListChunk(stream, utils::fourCC("LIST"), chunk.size()));
+  REQUIRE(parsed);
+  REQUIRE(parsed->data() == chunk.data());
+  auto labels = parsed->labels();
+  REQUIRE(labels.size() == 2);
+  REQUIRE(labels[0].cueId == 1);
+  REQUIRE(labels[0].text == "one");
+  REQUIRE(labels[1].cueId == 2);
+  REQUIRE(labels[1].text == "two!");
+  auto notes = parsed->notes();
+  REQUIRE(notes.size() == 1);
+  REQUIRE(notes[0].text == "note");
+
+  std::stringstream info("INFOdata");
+  auto unknown = parseListChunk(info, utils::fourCC("LIST"), 8);
+  REQUIRE(std::dynamic_pointer_cast<UnknownChunk>(unknown));
+  REQUIRE(unknown->size() == 8);
+}
+
 TEST_CASE("axml_chunk_bench", "[.bench]") {
   size_t size = 10000000;
 
@@ -2,6 +2,8 @@
 #include <sstream>
 #include <random>
 #include "bw64/bw64.hpp"
+#include "bw64/packet.hpp"
+#include "test_helpers.hpp"
 
 using namespace bw64;
 
@@ -86,6 +88,35 @@ TEST_CASE("read_check_chunks") {
   bw64File->close();
 }
 
+TEST_CASE("read_header_window_sizes") {
+  auto filename = GENERATE("rect_16bit.wav", "rect_24bit_rf64.wav",
+                           "rect_24bit_bext.wav",
+                           "noise_24bit_uneven_data_chunk_size.wav");
+  Bw64Reader reference(filename);
+  std::vector<float> expected(reference.numberOfFrames() *
+                              reference.channels());
+  reference.read(expected.data(), reference.numberOfFrames());
+
+  // the header parsed partly or entirely from the file rather than memory
+  auto windowSize = GENERATE(0u, 16u, 40u, 100u, 1u << 20);
+  Bw64Reader reader(filename, windowSize);
+  REQUIRE(reader.fileFormat() == reference.fileFormat());
+  REQUIRE(reader.numberOfFrames() == reference.numberOfFrames());
+  REQUIRE(reader.chunks().size() == reference.chunks().size());
+  for (size_t i = 0; i < reader.chunks().size(); ++i) {
+    REQUIRE(reader.chunks()[i].id == reference.chunks()[i].id);
+    REQUIRE(reader.chunks()[i].size == reference.chunks()[i].size);
+    REQUIRE(reader.chunks()[i].position == reference.chunks()[i].position);
+  }
+  REQUIRE((reader.chnaChunk() != nullptr) ==
+          (reference.chnaChunk() != nullptr));
+
+  std::vector<float> actual(expected.size());
+  REQUIRE(reader.read(actual.data(), reader.numberOfFrames()) ==
+          reader.numberOfFrames());
+  REQUIRE(actual == expected);
+}
+
 TEST_CASE("read_seek_tell") {
   auto bw64File = readFile("rect_16bit.wav");
   // should be positioned at the beginning after opening
@@ -118,6 +149,437 @@ TEST_CASE("read_seek_tell") {
   bw64File->close();
 }
 
+TEST_CASE("read_reverse") {
+  auto bw64File = readFile("rect_24bit.wav");
+  const uint64_t frames = bw64File->numberOfFrames();
+  const uint16_t channels = bw64File->channels();
+  std::vector<float> forward(frames * channels);
+  REQUIRE(bw64File->read(forward.data(), frames) == frames);
+  REQUIRE(bw64File->eof());
+
+  auto readahead = GENERATE(1u, 1000u, 65536u);
+  bw64File->setReverseReadahead(readahead);
+  REQUIRE(bw64File->reverseReadahead() == readahead);
+
+  // read the whole file backwards in blocks which do not divide it evenly
+  std::vector<float> backward(frames * channels);
+  uint64_t done = 0;
+  while (done < frames) {
+    auto n = bw64File->readReverse(&backward[done * channels], 333);
+    REQUIRE(n > 0);
+    done += n;
+    REQUIRE(bw64File->tell() == frames - done);
+  }
+  REQUIRE(bw64File->tell() == 0);
+  REQUIRE(bw64File->readReverse(backward.data(), 10) == 0);
+
+  for (uint64_t f = 0; f < frames; ++f)
+    for (uint16_t c = 0; c < channels; ++c)
+      REQUIRE(backward[f * channels + c] ==
+              forward[(frames - 1 - f) * channels + c]);
+
+  // forward reading continues from the position reached by readReverse
+  bw64File->seek(1000);
+  std::vector<float> block(10 * channels);
+  REQUIRE(bw64File->readReverse(block.data(), 10) == 10);
+  REQUIRE(bw64File->tell() == 990);
+  REQUIRE(bw64File->read(block.data(), 10) == 10);
+  REQUIRE(bw64File->tell() == 1000);
+  for (uint64_t i = 0; i < block.size(); ++i)
+    REQUIRE(block[i] == forward[990 * channels + i]);
+}
+
+TEST_CASE("read_loop") {
+  auto bw64File = readFile("rect_16bit.wav");
+  const uint64_t frames = bw64File->numberOfFrames();
+  const uint16_t channels = bw64File->channels();
+  std::vector<float> forward(frames * channels);
+  REQUIRE(bw64File->read(forward.data(), frames) == frames);
+
+  REQUIRE_THROWS_AS(bw64File->setLoop(100, 100), std::runtime_error);
+  REQUIRE_THROWS_AS(bw64File->setLoop(100, frames + 1), std::runtime_error);
+
+  // fully resident, and only partly resident
+  auto residentBytes = GENERATE(1u << 20, 50u * 4u);
+  bw64File->setLoop(1000, 1300, residentBytes);
+  REQUIRE(bw64File->looping());
+  REQUIRE(bw64File->loopResidentFrames() ==
+          std::min<uint64_t>(300, residentBytes / 4));
+
+  // read across several wraps in one call
+  bw64File->seek(900);
+  std::vector<float> block(1000 * channels);
+  REQUIRE(bw64File->read(block.data(), 1000) == 1000);
+  for (uint64_t i = 0; i < 1000; ++i) {
+    uint64_t frame = 900 + i;
+    if (frame >= 1300) frame = 1000 + (frame - 1000) % 300;
+    for (uint16_t c = 0; c < channels; ++c)
+      REQUIRE(block[i * channels + c] == forward[frame * channels + c]);
+  }
+  REQUIRE(bw64File->tell() == 1000 + (1900 - 1000) % 300);
+  REQUIRE_FALSE(bw64File->eof());
+
+  // reading behind the loop is not affected
+  bw64File->seek(-10, std::ios::end);
+  REQUIRE(bw64File->read(block.data(), 1000) == 10);
+  REQUIRE(bw64File->eof());
+
+  // and reading continues past the loop once it has been cleared
+  bw64File->seek(1200);
+  bw64File->clearLoop();
+  REQUIRE_FALSE(bw64File->looping());
+  REQUIRE(bw64File->read(block.data(), 200) == 200);
+  REQUIRE(bw64File->tell() == 1400);
+  for (uint64_t i = 0; i < 200 * channels; ++i)
+    REQUIRE(block[i] == forward[1200 * channels + i]);
+}
+
+TEST_CASE("read_seek_64bit") {
+  auto bw64File = readFile("rect_16bit.wav");
+  bw64File->seek(INT64_MAX);
+  REQUIRE(bw64File->tell() == 22050);
+  bw64File->seek(INT64_MAX, std::ios::cur);
+  REQUIRE(bw64File->tell() == 22050);
+  bw64File->seek(INT64_MIN, std::ios::cur);
+  REQUIRE(bw64File->tell() == 0);
+  bw64File->seek(INT64_MIN, std::ios::end);
+  REQUIRE(bw64File->tell() == 0);
+  bw64File->seek(int64_t{1} << 40);
+  REQUIRE(bw64File->tell() == 22050);
+}
+
+TEST_CASE("read_ranges") {
+  auto bw64File = readFile("rect_24bit.wav");
+  const uint64_t frames = bw64File->numberOfFrames();
+  const uint16_t channels = bw64File->channels();
+  std::vector<float> forward(frames * channels);
+  REQUIRE(bw64File->read(forward.data(), frames) == frames);
+  bw64File->seek(1234);
+
+  // unsorted, overlapping, far apart, and partially or fully behind the end
+  std::vector<uint64_t> starts{20000, 10, 12, 5000, 30, 22000, 23000, 0};
+  const uint64_t length = 100;
+  std::vector<std::vector<float>> buffers(
+      starts.size(), std::vector<float>(length * channels, 1.f));
+  std::vector<FrameRange<float>> ranges;
+  for (size_t i = 0; i < starts.size(); ++i)
+    ranges.push_back(FrameRange<float>{starts[i], length, buffers[i].data()});
+
+  auto maxGapBytes = GENERATE(0u, 4096u, 1u << 30);
+  REQUIRE(bw64File->readRanges(ranges, maxGapBytes) == 6 * length + 50);
+  REQUIRE(bw64File->tell() == 1234);
+
+  for (size_t i = 0; i < starts.size(); ++i) {
+    for (uint64_t f = 0; f < length; ++f) {
+      for (uint16_t c = 0; c < channels; ++c) {
+        const uint64_t frame = starts[i] + f;
+        const float expected =
+            frame < frames ? forward[frame * channels + c] : 0.f;
+        REQUIRE(buffers[i][f * channels + c] == expected);
+      }
+    }
+  }
+}
+
+TEST_CASE("chunk_parser_registry") {
+  ChunkParserRegistry registry;
+  REQUIRE(registry.has(utils::fourCC("fmt ")));
+  REQUIRE_FALSE(registry.has(utils::fourCC("iXML")));
+  REQUIRE(registry.find(utils::fourCC("iXML")).parsing == ChunkParsing::eager);
+
+  int bextParsed = 0;
+  registry.add(
+      utils::fourCC("bext"),
+      [&bextParsed](std::istream& stream, uint32_t id, uint64_t size) {
+        ++bextParsed;
+        return std::make_shared<UnknownChunk>(stream, id, size);
+      },
+      ChunkParsing::lazy);
+  REQUIRE(registry.has(utils::fourCC("bext")));
+  REQUIRE(registry.find(utils::fourCC("bext")).parsing == ChunkParsing::lazy);
+
+  {
+    Bw64Reader reader("rect_24bit_bext.wav", registry);
+    REQUIRE(bextParsed == 0);
+    REQUIRE(reader.hasChunk(utils::fourCC("bext")));
+    REQUIRE_FALSE(reader.isChunkParsed(utils::fourCC("bext")));
+
+    std::vector<float> before(100 * reader.channels());
+    REQUIRE(reader.read(before.data(), 50) == 50);
+
+    auto bext = reader.chunk<UnknownChunk>(utils::fourCC("bext"));
+    REQUIRE(bext);
+    REQUIRE(bext->size() == 602);
+    REQUIRE(bextParsed == 1);
+    REQUIRE(reader.isChunkParsed(utils::fourCC("bext")));
+    REQUIRE(reader.chunk(utils::fourCC("bext")) == bext);
+    REQUIRE(bextParsed == 1);
+    // the typed getter checks the type returned by the replaced parser
+    REQUIRE_FALSE(reader.bextChunk());
+    REQUIRE_FALSE(reader.chunk<BextChunk>(utils::fourCC("bext")));
+
+    // reading continues where it was before the chunk was parsed
+    REQUIRE(reader.read(&before[50 * reader.channels()], 50) == 50);
+    auto expected = readFile("rect_24bit_bext.wav");
+    std::vector<float> after(100 * reader.channels());
+    REQUIRE(expected->read(after.data(), 100) == 100);
+    REQUIRE(before == after);
+  }
+
+  SECTION("dropped chunks") {
+    ChunkParser drop = [](std::istream&, uint32_t,
+                          uint64_t) -> std::shared_ptr<Chunk> {
+      return nullptr;
+    };
+    registry.setDefault(drop);
+    registry.add(utils::fourCC("LIST"), drop);
+    Bw64Reader reader("rect_32bit.wav", registry);
+    REQUIRE(reader.hasChunk(utils::fourCC("LIST")));
+    REQUIRE_FALSE(reader.chunk(utils::fourCC("LIST")));
+    REQUIRE(reader.formatChunk());
+  }
+
+  SECTION("lazy by default") {
+    registry.setDefaultParsing(ChunkParsing::lazy);
+    registry.setParsing(utils::fourCC("chna"), ChunkParsing::lazy);
+    Bw64Reader reader("noise_24bit_uneven_data_chunk_size.wav", registry);
+    REQUIRE_FALSE(reader.isChunkParsed(utils::fourCC("chna")));
+    REQUIRE(reader.chnaChunk());
+    REQUIRE(reader.isChunkParsed(utils::fourCC("chna")));
+  }
+}
+
+TEST_CASE("read_bext") {
+  auto bw64File = readFile("rect_24bit_bext.wav");
+  auto bext = bw64File->bextChunk();
+  REQUIRE(bext);
+  REQUIRE(bext->originator() == "REAPER");
+  REQUIRE(bext->originationDate() == "2017-04-13");
+  REQUIRE(bext->originationTime() == "18-09-42");
+  REQUIRE(bext->version() == 1);
+  REQUIRE(bext->timeReference() == 0);
+  REQUIRE(bext->codingHistorySize() == 0);
+  REQUIRE(bw64File->readBextCodingHistory() == "");
+
+  REQUIRE_FALSE(readFile("rect_24bit.wav")->bextChunk());
+  REQUIRE(readFile("rect_24bit.wav")->timeReference() == 0);
+}
+
+TEST_CASE("write_read_bext_time_reference") {
+  const uint64_t timeReference = 10ull * 3600 * 48000;
+  {
+    auto bext = std::make_shared<BextChunk>();
+    bext->timeReference(timeReference);
+    bext->codingHistory("A=PCM,F=48000,W=16,M=mono\r\n");
+    Bw64Writer writer("write_read_bext.wav", 1, 48000, 16, {bext});
+    std::vector<float> ramp(1000);
+    for (size_t i = 0; i < ramp.size(); ++i) ramp[i] = i / 1024.f;
+    writer.write(ramp.data(), ramp.size());
+    writer.close();
+  }
+
+  auto bw64File = readFile("write_read_bext.wav");
+  REQUIRE(bw64File->timeReference() == timeReference);
+  REQUIRE_FALSE(bw64File->bextChunk()->hasCodingHistory());
+  REQUIRE(bw64File->bextChunk()->size() == BextChunk::fixedSize() + 27);
+  // copying the chunk without its CodingHistory would truncate it
+  REQUIRE_THROWS_AS(Bw64Writer("write_read_bext_copy.wav", 1, 48000, 16,
+                               {bw64File->bextChunk()}),
+                    std::runtime_error);
+  REQUIRE(bw64File->readBextCodingHistory() == "A=PCM,F=48000,W=16,M=mono\r\n");
+  REQUIRE(bw64File->bextChunk()->hasCodingHistory());
+  Bw64Writer("write_read_bext_copy.wav", 1, 48000, 16, {bw64File->bextChunk()})
+      .close();
+  REQUIRE(readFile("write_read_bext_copy.wav")->readBextCodingHistory() ==
+          "A=PCM,F=48000,W=16,M=mono\r\n");
+
+  REQUIRE(bw64File->frameAtTimeReference(timeReference + 500) == 500);
+  REQUIRE(bw64File->frameAtTimeReference(timeReference - 10) == -10);
+
+  REQUIRE(bw64File->seekTimeReference(timeReference + 500));
+  REQUIRE(bw64File->tell() == 500);
+  float sample;
+  REQUIRE(bw64File->read(&sample, 1) == 1);
+  REQUIRE(sample == Approx(500 / 1024.f));
+
+  REQUIRE_FALSE(bw64File->seekTimeReference(timeReference - 10));
+  REQUIRE(bw64File->tell() == 0);
+  REQUIRE_FALSE(bw64File->seekTimeReference(timeReference + 1000));
+  REQUIRE(bw64File->eof());
+}
+
+TEST_CASE("read_small_bext") {
+  // files with a bext chunk which is too small for its fixed fields were
+  // opened before bext chunks were parsed, and still are
+  {
+    Bw64Writer writer("read_small_bext.wav", 1, 48000, 16,
+                      {rawChunk("bext", std::string(100, 'b'))});
+    std::vector<float> data(10, 0.5f);
+    writer.write(data.data(), data.size());
+    writer.close();
+  }
+
+  auto reader = readFile("read_small_bext.wav");
+  REQUIRE(reader->numberOfFrames() == 10);
+  REQUIRE_FALSE(reader->bextChunk());
+  auto bext = reader->chunk<UnknownChunk>(utils::fourCC("bext"));
+  REQUIRE(bext);
+  REQUIRE(bext->size() == 100);
+  REQUIRE(reader->timeReference() == 0);
+  REQUIRE(reader->readBextCodingHistory().empty());
+
+  // the strict parser rejects it
+  ChunkParserRegistry registry;
+  registry.add(utils::fourCC("bext"), parseBextChunk);
+  REQUIRE_THROWS_AS(Bw64Reader("read_small_bext.wav", registry),
+                    std::runtime_error);
+}
+
+TEST_CASE("write_read_markers") {
+  // out of order, with and without labels, and two at the same frame
+  std::vector<std::pair<uint64_t, std::string>> added{
+      {500, "b"}, {100, "a"}, {900, ""}, {500, "c"}, {0, "start"},
+      {1000, "end"}, {1500, "after the end"}};
+  {
+    auto writer = writeFile("write_read_markers.wav", 1, 48000, 16);
+    std::vector<float> silence(1000);
+    writer->write(silence.data(), 1000);
+    for (size_t i = 0; i < added.size(); ++i)
+      REQUIRE(writer->addMarker(added[i].first, added[i].second) == i + 1);
+    REQUIRE(writer->markersAdded() == added.size());
+    REQUIRE_THROWS_AS(writer->addMarker(uint64_t(1) << 32),
+                      std::runtime_error);
+    writer->close();
+  }
+
+  auto reader = readFile("write_read_markers.wav");
+  REQUIRE(reader->cueChunk()->cuePoints().size() == added.size());
+  const MarkerIndex& markers = reader->markers();
+  REQUIRE(markers.size() == 6);
+  std::vector<uint64_t> frames;
+  std::vector<std::string> labels;
+  for (auto& marker : markers.markers()) {
+    frames.push_back(marker.frame);
+    labels.push_back(marker.label);
+  }
+  REQUIRE(frames == std::vector<uint64_t>{0, 100, 500, 500, 900, 1000});
+  REQUIRE(labels ==
+          std::vector<std::string>{"start", "a", "b", "c", "", "end"});
+
+  REQUIRE(markers.next(0)->label == "a");
+  REQUIRE(markers.next(100)->label == "b");
+  REQUIRE(markers.next(499)->label == "b");
+  REQUIRE(markers.next(500)->frame == 900);
+  REQUIRE(markers.next(900)->label == "end");
+  REQUIRE(markers.next(1000) == nullptr);
+  REQUIRE(markers.previous(0) == nullptr);
+  REQUIRE(markers.previous(100)->label == "start");
+  REQUIRE(markers.previous(501)->label == "c");
+  REQUIRE(markers.previous(5000)->frame == 1000);
+  REQUIRE(markers.find(3)->frame == 900);
+  REQUIRE(markers.find(7) == nullptr);
+  REQUIRE(markers.find(8) == nullptr);
+
+  reader->seekToMarker(1);
+  REQUIRE(reader->tell() == 500);
+  REQUIRE_THROWS_AS(reader->seekToMarker(42), std::runtime_error);
+  REQUIRE_THROWS_AS(reader->seekToMarker(7), std::runtime_error);
+  reader->seekToMarker(6);
+  REQUIRE(reader->eof());
+
+  REQUIRE(readFile("rect_24bit.wav")->markers().empty());
+  REQUIRE(std::dynamic_pointer_cast<UnknownChunk>(
+      readFile("rect_32bit.wav")->chunk(utils::fourCC("LIST"))));
+}
+
+TEST_CASE("read_malformed_cue") {
+  // files with a cue chunk which is too small for its cue points, or a LIST
+  // chunk without a list type, were opened before these chunks were parsed,
+  // and still are, without markers
+  {
+    std::string cue(4, '\xff');
+    cue += std::string(sizeof(CuePoint), '\0');
+    Bw64Writer writer("read_malformed_cue.wav", 1, 48000, 16,
+                      {rawChunk("cue ", cue), rawChunk("LIST", "ad")});
+    std::vector<float> data(10, 0.5f);
+    writer.write(data.data(), data.size());
+    writer.close();
+  }
+
+  auto reader = readFile("read_malformed_cue.wav");
+  REQUIRE(reader->numberOfFrames() == 10);
+  REQUIRE_FALSE(reader->cueChunk());
+  REQUIRE(reader->markers().empty());
+  auto cue = reader->chunk<UnknownChunk>(utils::fourCC("cue "));
+  REQUIRE(cue);
+  REQUIRE(cue->size() == 4 + sizeof(CuePoint));
+  REQUIRE(reader->chunk<UnknownChunk>(utils::fourCC("LIST")));
+
+  // the strict parser rejects it
+  ChunkParserRegistry registry;
+  registry.add(utils::fourCC("cue "), parseCueChunk);
+  REQUIRE_THROWS_AS(Bw64Reader("read_malformed_cue.wav", registry),
+                    std::runtime_error);
+}
+
+TEST_CASE("read_big_endian") {
+  auto bitDepth = GENERATE(16, 24);
+  auto bw64File = readFile("rect_24bit.wav");
+  const uint16_t channels = bw64File->channels();
+  const uint64_t frames = 1001;
+  std::vector<char> raw(frames * bw64File->blockAlignment());
+  REQUIRE(bw64File->readRaw(raw.data(), frames) == frames);
+
+  bw64File->seek(0);
+  std::vector<char> big(frames * channels * bitDepth / 8);
+  REQUIRE(bw64File->readBigEndian(big.data(), frames, bitDepth) == frames);
+  REQUIRE(bw64File->tell() == frames);
+  std::vector<char> expected(big.size());
+  utils::convertPcmSamplesToBigEndian(raw.data(), expected.data(),
+                                      frames * channels, 24, bitDepth);
+  REQUIRE(big == expected);
+
+  REQUIRE_THROWS_AS(bw64File->readBigEndian(big.data(), 1, 32),
+                    std::runtime_error);
+}
+
+TEST_CASE("packet_reader") {
+  REQUIRE(framesPerPacket(48000, std::chrono::milliseconds(1)) == 48);
+  REQUIRE(framesPerPacket(96000, std::chrono::microseconds(125)) == 12);
+  REQUIRE_THROWS_AS(framesPerPacket(44100, std::chrono::microseconds(333)),
+                    std::runtime_error);
+
+  auto bw64File = readFile("rect_16bit.wav");
+  const uint16_t channels = bw64File->channels();
+  const uint64_t frames = bw64File->numberOfFrames();
+  std::vector<char> all(frames * channels * 3);
+  REQUIRE(bw64File->readBigEndian(all.data(), frames, 24) == frames);
+  bw64File->seek(0);
+
+  // leave room for a 12 byte header before each payload
+  const uint64_t packetFrames = 1000;
+  PacketReader packets(*bw64File, 24, packetFrames);
+  const uint64_t payloadSize = packets.payloadSize();
+  REQUIRE(payloadSize == packetFrames * channels * 3);
+  const uint64_t stride = 12 + payloadSize;
+  const size_t expectedPackets = (frames + packetFrames - 1) / packetFrames;
+  std::vector<char> buffer((expectedPackets + 4) * stride, 'x');
+  size_t read = 0;
+  while (size_t n = packets.readPackets(&buffer[read * stride + 12], 4, stride))
+    read += n;
+  REQUIRE(read == expectedPackets);
+  REQUIRE_FALSE(packets.readPacket(buffer.data()));
+
+  for (size_t p = 0; p < read; ++p) {
+    REQUIRE(std::string(&buffer[p * stride], 12) == std::string(12, 'x'));
+    for (uint64_t i = 0; i < payloadSize; ++i) {
+      const uint64_t position = p * payloadSize + i;
+      const char expected = position < all.size() ? all[position] : 0;
+      REQUIRE(buffer[p * stride + 12 + i] == expected);
+    }
+  }
+}
+
 TEST_CASE("write_16bit") {
   auto bw64File = writeFile("zeros_16bit.wav", 2u, 48000u, 16u);
 
@@ -217,22 +679,6 @@ TEST_CASE("write_read_32bit_clipped") {
   REQUIRE(data.at(3200) == Approx(1.f).epsilon(1e-6));
 }
 
-void writeRandom(const std::string& filename, uint16_t bitDepth,
-                 uint64_t frames, uint16_t channels = 1u,
-                 uint32_t sampleRate = 48000u) {
-  // Generate vector with random values between -1.f and 1.f
-  std::random_device rd;
-  std::mt19937 engine(rd());
-  std::uniform_real_distribution<float> dist(-1.f, 1.f);
-  auto gen = [&]() { return dist(engine); };
-  std::vector<float> data(frames * channels);
-  generate(begin(data), end(data), gen);
-
-  auto bw64File = writeFile(filename, channels, sampleRate, bitDepth);
-  bw64File->write(&data[0], frames);
-  bw64File->close();
-}
-
 TEST_CASE("write_read_riff_header") {
   int frames = 4800;
   writeRandom("write_read_riff_header.wav", 32, frames);
@@ -290,6 +736,115 @@ TEST_CASE("write_read_odd_chunks_after") {
   }
 }
 
+TEST_CASE("write_read_data_alignment") {
+  const uint32_t alignment = GENERATE(2u, 4u, 8u, 12u, 512u, 4096u);
+  // axml chunks of 1 to 8 bytes end the header at every even residue modulo
+  // 8, so every padding size is needed
+  const size_t axmlSize = GENERATE(range(0, 9));
+  const bool withAxml = axmlSize != 0;
+  const int frames = 13;
+  std::vector<float> data(frames * 2, 0.25f);
+
+  {
+    auto axml = withAxml
+                    ? std::make_shared<AxmlChunk>(std::string(axmlSize, 'a'))
+                    : nullptr;
+    auto writer = writeFile("write_read_data_alignment.wav", 2, 48000, 24,
+                            nullptr, axml, alignment);
+    writer->write(&data[0], frames);
+    writer->setChnaChunk(std::make_shared<ChnaChunk>());
+    writer->close();
+  }
+
+  auto reader = readFile("write_read_data_alignment.wav");
+  REQUIRE(reader->dataOffset() % alignment == 0);
+  REQUIRE(reader->isDataAligned(alignment));
+  REQUIRE(reader->numberOfFrames() == frames);
+  REQUIRE(reader->chnaChunk());
+  REQUIRE((reader->axmlChunk() != nullptr) == withAxml);
+  if (withAxml) REQUIRE(reader->axmlChunk()->data().size() == axmlSize);
+  std::vector<float> read(frames * 2);
+  REQUIRE(reader->read(&read[0], frames) == frames);
+  REQUIRE(read == data);
+
+  REQUIRE_THROWS_AS(writeFile("write_read_data_alignment.wav", 2, 48000, 24,
+                              nullptr, nullptr, 4097),
+                    std::runtime_error);
+}
+
+TEST_CASE("write_read_huge_pages") {
+  const uint64_t frames = utils::hugePageSize() / 6 + 100;
+  std::vector<float> data(frames * 2);
+  for (size_t i = 0; i < data.size(); ++i)
+    data[i] = static_cast<float>(i % 1000) / 1024.f;
+
+  auto writer = writeFile("write_read_huge_pages.wav", 2, 48000, 24);
+  writer->useHugePages(true);
+  REQUIRE(writer->usesHugePages());
+  writer->write(data.data(), frames);
+  writer->close();
+
+  auto reader = readFile("write_read_huge_pages.wav");
+  REQUIRE_FALSE(reader->usesHugePages());
+  reader->useHugePages(true);
+  REQUIRE(reader->usesHugePages());
+  std::vector<float> read(frames * 2);
+  REQUIRE(reader->read(read.data(), frames) == frames);
+  REQUIRE(read == data);
+  REQUIRE(reader->readReverse(read.data(), frames) == frames);
+  reader->useHugePages(false);
+  REQUIRE(reader->readReverse(read.data(), 1) == 0);
+  REQUIRE(reader->read(read.data(), 1) == 1);
+  REQUIRE(read[0] == data[0]);
+}
+
+TEST_CASE("write_read_non_temporal") {
+  const uint64_t frames = 1001;
+  std::vector<float> data(frames * 3);
+  for (size_t i = 0; i < data.size(); ++i)
+    data[i] = static_cast<float>(i % 1000) / 1024.f - 0.5f;
+
+  auto writer = writeFile("write_read_non_temporal.wav", 3, 48000, 24);
+  REQUIRE_FALSE(writer->usesNonTemporalStores());
+  writer->useNonTemporalStores(true);
+  REQUIRE(writer->usesNonTemporalStores());
+  writer->write(data.data(), frames);
+  writer->close();
+
+  auto reader = readFile("write_read_non_temporal.wav");
+  REQUIRE_FALSE(reader->usesNonTemporalStores());
+  reader->useNonTemporalStores(true);
+  REQUIRE(reader->usesNonTemporalStores());
+  std::vector<float> read(frames * 3);
+  REQUIRE(reader->read(read.data(), frames) == frames);
+  REQUIRE(read == data);
+}
+
+TEST_CASE("huge_pages_bench", "[.bench]") {
+  // 8 channels of 24 bit samples; 96 MiB of PCM data per read
+  const uint64_t frames = 4u << 20;
+  writeRandom("huge_pages_bench.wav", 24, frames, 8);
+  std::vector<float> out(frames * 8);
+
+  for (bool hugePages : {false, true}) {
+    auto reader = readFile("huge_pages_bench.wav");
+    reader->useHugePages(hugePages);
+    BENCHMARK(hugePages ? "read, huge pages" : "read, 4 KiB pages") {
+      reader->seek(0);
+      return reader->read(out.data(), frames);
+    };
+  }
+
+  for (bool hugePages : {false, true}) {
+    utils::RawBuffer raw(utils::HugePageAllocator<char>{hugePages});
+    raw.resize(frames * 8 * 3);
+    BENCHMARK(hugePages ? "decode, huge pages" : "decode, 4 KiB pages") {
+      utils::decodePcmSamples(raw.data(), out.data(), frames * 8, 24);
+      return out[0];
+    };
+  }
+}
+
 TEST_CASE("write_read_big", "[.big]") {
   uint64_t frames = 0x90000000UL;
   uint64_t blockSize = 0x1000UL;
@@ -415,3 +970,48 @@ TEST_CASE("write_too_many_big_chunks", "[.big]") {
 
   remove(filename.c_str());
 }
+
+/// block cache which never holds blocks, counting the calls
+class DroppingBlockCache : public BlockCache {
+ public:
+  size_t blockBytes() const override { return 4096; }
+  FileIdentity identify(const std::string&) override { return identity; }
+  bool lookup(const FileIdentity&, uint64_t, size_t, size_t, size_t,
+              void*) override {
+    ++lookups;
+    return false;
+  }
+  void insert(const FileIdentity&, uint64_t, const void*, size_t) override {
+    ++inserts;
+  }
+
+  FileIdentity identity;
+  int lookups = 0;
+  int inserts = 0;
+};
+
+TEST_CASE("block_cache_keeps_last_block") {
+  const uint64_t frames = 1000;
+  writeRandom("block_cache.wav", 24, frames, 2);
+  std::vector<float> expected(frames * 2);
+  readFile("block_cache.wav")->read(expected.data(), frames);
+
+  auto cache = std::make_shared<DroppingBlockCache>();
+  auto reader = readFile("block_cache.wav");
+  REQUIRE_THROWS_AS(reader->useBlockCache(cache), std::runtime_error);
+  cache->identity.size = reader->dataOffset() + frames * 2 * 3;
+  reader->useBlockCache(cache);
+
+  // 512 frames of 2 float samples per block
+  std::vector<float> data(frames * 2);
+  for (uint64_t done = 0; done < frames;)
+    done += reader->read(data.data() + done * 2, 10);
+  REQUIRE(data == expected);
+  REQUIRE(cache->lookups == 2);
+  REQUIRE(cache->inserts == 2);
+
+  reader->seek(0);
+  REQUIRE(reader->read(data.data(), 10) == 10);
+  REQUIRE(cache->inserts == 3);
+  std::remove("block_cache.wav");
+}
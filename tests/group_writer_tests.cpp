@@ -0,0 +1,167 @@
+#include <catch2/catch.hpp>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "bw64/bw64.hpp"
+#include "test_helpers.hpp"
+
+using namespace bw64;
+
+TEST_CASE("channel_group_writer") {
+  const uint16_t channels = 6;
+  const uint64_t blockFrames = 64;
+  const uint64_t frames = 1000;  // last block is partial
+  std::vector<ChannelGroup> groups{ChannelGroup(0, 2), ChannelGroup(2, 1),
+                                   ChannelGroup(3, 3)};
+
+  {
+    auto writer = writeFile("channel_group_writer.wav", channels, 48000, 24);
+    ChannelGroupWriter groupWriter(*writer, groups, blockFrames, 3);
+
+    std::vector<std::thread> producers;
+    for (size_t g = 0; g < groups.size(); ++g) {
+      producers.emplace_back([&, g]() {
+        const ChannelGroup& group = groups[g];
+        std::vector<float> block(blockFrames * group.channels);
+        for (uint64_t start = 0; start < frames; start += blockFrames) {
+          uint64_t n = std::min(blockFrames, frames - start);
+          for (uint64_t f = 0; f < n; ++f)
+            for (uint16_t c = 0; c < group.channels; ++c)
+              block[f * group.channels + c] =
+                  testSample(start + f, group.firstChannel + c);
+          groupWriter.submit(g, block.data(), n);
+        }
+      });
+    }
+    for (auto& producer : producers) producer.join();
+
+    REQUIRE(groupWriter.blocksWritten() == 16);
+    REQUIRE(writer->framesWritten() == frames);
+    writer->close();
+  }
+
+  auto reader = readFile("channel_group_writer.wav");
+  REQUIRE(reader->numberOfFrames() == frames);
+  std::vector<float> data(frames * channels);
+  REQUIRE(reader->read(data.data(), frames) == frames);
+  for (uint64_t f = 0; f < frames; ++f)
+    for (uint16_t c = 0; c < channels; ++c)
+      REQUIRE(data[f * channels + c] ==
+              Approx(testSample(f, c)).margin(1e-6));
+}
+
+TEST_CASE("channel_group_writer_gaps_are_silent") {
+  {
+    auto writer = writeFile("channel_group_writer_gaps.wav", 3, 48000, 16);
+    ChannelGroupWriter groupWriter(*writer, {ChannelGroup(1, 1)}, 16);
+    std::vector<float> block(16, 0.5f);
+    groupWriter.submit(0, block.data(), 16);
+    writer->close();
+  }
+
+  auto reader = readFile("channel_group_writer_gaps.wav");
+  std::vector<float> data(16 * 3);
+  REQUIRE(reader->read(data.data(), 16) == 16);
+  for (size_t f = 0; f < 16; ++f) {
+    REQUIRE(data[f * 3 + 0] == 0.f);
+    REQUIRE(data[f * 3 + 1] == Approx(0.5f).epsilon(1e-3));
+    REQUIRE(data[f * 3 + 2] == 0.f);
+  }
+}
+
+TEST_CASE("channel_group_writer_invalid") {
+  auto writer = writeFile("channel_group_writer_invalid.wav", 4, 48000, 16);
+  REQUIRE_THROWS_AS(ChannelGroupWriter(*writer, {}, 16), std::runtime_error);
+  REQUIRE_THROWS_AS(ChannelGroupWriter(*writer, {ChannelGroup(0, 2)}, 0),
+                    std::runtime_error);
+  REQUIRE_THROWS_AS(ChannelGroupWriter(*writer, {ChannelGroup(3, 2)}, 16),
+                    std::runtime_error);
+  REQUIRE_THROWS_AS(ChannelGroupWriter(
+                        *writer, {ChannelGroup(0, 2), ChannelGroup(1, 2)}, 16),
+                    std::runtime_error);
+
+  ChannelGroupWriter groupWriter(
+      *writer, {ChannelGroup(0, 2), ChannelGroup(2, 2)}, 16);
+  std::vector<float> block(32 * 2);
+  REQUIRE_THROWS_AS(groupWriter.submit(2, block.data(), 16),
+                    std::runtime_error);
+  REQUIRE_THROWS_AS(groupWriter.submit(0, block.data(), 32),
+                    std::runtime_error);
+  REQUIRE_FALSE(groupWriter.failed());
+  groupWriter.submit(0, block.data(), 16);
+  // a frame count mismatch fails the writer, as group 0 would otherwise wait
+  // for the first block forever
+  REQUIRE_THROWS_AS(groupWriter.submit(1, block.data(), 8),
+                    std::runtime_error);
+  REQUIRE(groupWriter.failed());
+  REQUIRE_THROWS_AS(groupWriter.submit(1, block.data(), 16),
+                    std::runtime_error);
+  REQUIRE_THROWS_AS(groupWriter.submit(0, block.data(), 16),
+                    std::runtime_error);
+  REQUIRE(writer->framesWritten() == 0);
+}
+
+TEST_CASE("channel_group_writer_failing_producer") {
+  const uint64_t blockFrames = 16;
+  auto writer = writeFile("channel_group_writer_failing.wav", 3, 48000, 16);
+  ChannelGroupWriter groupWriter(
+      *writer, {ChannelGroup(0, 1), ChannelGroup(1, 1), ChannelGroup(2, 1)},
+      blockFrames, 2);
+  std::vector<float> block(blockFrames, 0.25f);
+
+  // groups 0 and 1 submit more blocks than there are slots, so they end up
+  // waiting for group 2, which submits a short block 3 and stops
+  std::atomic<int> failures(0);
+  std::vector<std::thread> producers;
+  for (size_t g = 0; g < 2; ++g) {
+    producers.emplace_back([&, g]() {
+      try {
+        for (int i = 0; i < 20; ++i)
+          groupWriter.submit(g, block.data(), blockFrames);
+      } catch (const std::runtime_error&) {
+        ++failures;
+      }
+    });
+  }
+  for (int i = 0; i < 3; ++i) groupWriter.submit(2, block.data(), blockFrames);
+  while (groupWriter.blocksWritten() < 3) std::this_thread::yield();
+  try {
+    groupWriter.submit(2, block.data(), blockFrames / 2);
+  } catch (const std::runtime_error&) {
+    // thrown if group 0 or 1 claimed block 3 first; otherwise one of them
+    // fails when it submits its block 3
+  }
+  for (auto& producer : producers) producer.join();
+
+  REQUIRE(failures == 2);
+  REQUIRE(groupWriter.failed());
+  REQUIRE(groupWriter.blocksWritten() == 3);
+  REQUIRE(writer->framesWritten() == 3 * blockFrames);
+}
+
+TEST_CASE("channel_group_writer_abort") {
+  auto writer = writeFile("channel_group_writer_abort.wav", 2, 48000, 16);
+  ChannelGroupWriter groupWriter(
+      *writer, {ChannelGroup(0, 1), ChannelGroup(1, 1)}, 16, 2);
+  std::vector<float> block(16, 0.25f);
+
+  // group 1 never submits, so group 0 waits for a slot after two blocks
+  bool failed = false;
+  std::thread producer([&]() {
+    try {
+      for (int i = 0; i < 3; ++i) groupWriter.submit(0, block.data(), 16);
+    } catch (const std::runtime_error&) {
+      failed = true;
+    }
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  groupWriter.abort();
+  producer.join();
+
+  REQUIRE(failed);
+  REQUIRE(groupWriter.failed());
+  REQUIRE_THROWS_AS(groupWriter.submit(1, block.data(), 16),
+                    std::runtime_error);
+  REQUIRE(writer->framesWritten() == 0);
+}
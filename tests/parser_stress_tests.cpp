@@ -0,0 +1,203 @@
+#include <catch2/catch.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "bw64/bw64.hpp"
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+using namespace bw64;
+
+namespace {
+
+  /// chunks of a pathological file; see writeStressFile()
+  struct StressLayout {
+    const char* name;
+    /// number of 16 byte unknown chunks
+    uint32_t smallChunks;
+    /// number of entries of the ds64 table, for chunks which don't exist
+    uint32_t ds64Entries;
+    /// number of UIDs in the chna chunk; none if 0
+    uint16_t chnaUids;
+    /// size of the axml chunk; none if 0
+    uint64_t axmlBytes;
+    /// number and size of large unknown chunks
+    uint32_t unknownChunks;
+    uint64_t unknownBytes;
+  };
+
+  /// write a chunk of `size` bytes of `fill` without holding it in memory
+  void writeFilledChunk(std::ostream& stream, uint32_t id, uint64_t size,
+                        char fill) {
+    utils::writeValue(stream, id);
+    utils::writeValue(stream, utils::safeCast<uint32_t>(size));
+    const std::vector<char> piece(1u << 20, fill);
+    for (uint64_t written = 0; written < size;) {
+      const uint64_t n = std::min<uint64_t>(piece.size(), size - written);
+      stream.write(piece.data(), static_cast<std::streamsize>(n));
+      written += n;
+    }
+    if (size % 2 == 1) utils::writeValue(stream, '\0');
+  }
+
+  /**
+   * write a BW64 file with the chunks of `layout` in front of a short data
+   * chunk: ds64, fmt, the small chunks, chna, axml, then the large unknown
+   * chunks
+   */
+  void writeStressFile(const std::string& filename,
+                       const StressLayout& layout) {
+    std::ofstream stream(filename, std::ios::binary);
+    const uint32_t frames = 480;
+
+    utils::writeValue(stream, utils::fourCC("BW64"));
+    utils::writeValue(stream, UINT32_MAX);
+    utils::writeValue(stream, utils::fourCC("WAVE"));
+
+    // ids below 0x20202020 are not printable, so don't clash with the chunks
+    std::map<uint32_t, uint64_t> table;
+    for (uint32_t i = 0; i < layout.ds64Entries; ++i) table[i + 1] = i;
+    auto ds64 = std::make_shared<DataSize64Chunk>(0, frames * 2u, table);
+    utils::writeChunk(stream, ds64, utils::safeCast<uint32_t>(ds64->size()));
+
+    auto fmt = std::make_shared<FormatInfoChunk>(1, 48000, 16);
+    utils::writeChunk(stream, fmt, utils::safeCast<uint32_t>(fmt->size()));
+
+    for (uint32_t i = 0; i < layout.smallChunks; ++i)
+      writeFilledChunk(stream, utils::fourCC("smal"), 16, 's');
+
+    if (layout.chnaUids) {
+      auto chna = std::make_shared<ChnaChunk>();
+      for (uint32_t i = 0; i < layout.chnaUids; ++i) {
+        char uid[13];
+        std::snprintf(uid, sizeof(uid), "ATU_%08X", i + 1);
+        chna->addAudioId(AudioId(static_cast<uint16_t>(i % 1000 + 1), uid,
+                                 "AT_00031001_01", "AP_00031001"));
+      }
+      utils::writeChunk(stream, chna, utils::safeCast<uint32_t>(chna->size()));
+    }
+
+    if (layout.axmlBytes)
+      writeFilledChunk(stream, utils::fourCC("axml"), layout.axmlBytes, ' ');
+
+    for (uint32_t i = 0; i < layout.unknownChunks; ++i)
+      writeFilledChunk(stream, utils::fourCC("big "), layout.unknownBytes, 'b');
+
+    writeFilledChunk(stream, utils::fourCC("data"), frames * 2u, '\0');
+
+    // the RIFF size is taken from the ds64 chunk
+    const uint64_t fileSize = static_cast<uint64_t>(stream.tellp());
+    stream.seekp(20);
+    utils::writeValue(stream, fileSize - 8u);
+    REQUIRE(stream.good());
+  }
+
+#ifdef __linux__
+  /// reset the peak resident set size of this process to the current one
+  bool resetPeakRss() {
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+    clearRefs.flush();
+    return clearRefs.good();
+  }
+
+  /// get a field of /proc/self/status in bytes, or 0 if it is not there
+  uint64_t statusBytes(const std::string& field) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+      if (line.compare(0, field.size() + 1, field + ":") != 0) continue;
+      std::istringstream value(line.substr(field.size() + 1));
+      uint64_t kiB = 0;
+      value >> kiB;
+      return kiB * 1024u;
+    }
+    return 0;
+  }
+#else
+  bool resetPeakRss() { return false; }
+  uint64_t statusBytes(const std::string&) { return 0; }
+#endif
+
+  /// open a file with `registry` and report the peak memory used by it
+  void reportOpenPeakRss(const std::string& filename, const std::string& name,
+                         const ChunkParserRegistry& registry) {
+#ifdef __GLIBC__
+    // return memory freed by earlier runs, which would otherwise be reused
+    malloc_trim(0);
+#endif
+    const uint64_t before = statusBytes("VmRSS");
+    if (!resetPeakRss()) {
+      WARN(name << ": peak memory can not be measured on this system");
+      return;
+    }
+    {
+      Bw64Reader reader(filename.c_str(), registry);
+      REQUIRE(reader.numberOfFrames() == 480u);
+    }
+    // memory freed before the reset may make the peak lower than `before`
+    const uint64_t peak = std::max(statusBytes("VmHWM"), before);
+    WARN(name << ": open peak memory " << (peak - before) / 1024u
+              << " KiB above " << before / 1024u << " KiB");
+  }
+
+  ChunkParserRegistry lazyRegistry() {
+    ChunkParserRegistry registry;
+    registry.setParsing(utils::fourCC("axml"), ChunkParsing::lazy);
+    registry.setDefaultParsing(ChunkParsing::lazy);
+    return registry;
+  }
+
+}  // namespace
+
+TEST_CASE("parser_stress_layouts") {
+  const StressLayout layout{"all", 100, 100, 50, 1001, 2, 70000};
+  writeStressFile("parser_stress.wav", layout);
+
+  for (bool lazy : {false, true}) {
+    const ChunkParserRegistry registry =
+        lazy ? lazyRegistry() : ChunkParserRegistry();
+    Bw64Reader reader("parser_stress.wav", registry);
+    REQUIRE(reader.numberOfFrames() == 480u);
+    REQUIRE(reader.ds64Chunk()->tableLength() == 100u);
+    REQUIRE(reader.chnaChunk()->numUids() == 50u);
+    REQUIRE(reader.chnaChunk()->numTracks() == 50u);
+    REQUIRE(reader.axmlChunk()->size() == 1001u);
+    REQUIRE(reader.chunks().size() == 107u);
+    REQUIRE(reader.chunk(utils::fourCC("big "))->size() == 70000u);
+  }
+  std::remove("parser_stress.wav");
+}
+
+TEST_CASE("parser_stress_bench", "[.bench]") {
+  const std::vector<StressLayout> layouts{
+      {"small chunks", 20000, 0, 0, 0, 0, 0},
+      {"ds64 table", 0, 1000000, 0, 0, 0, 0},
+      {"chna table", 0, 0, 65535, 0, 0, 0},
+      {"axml", 0, 0, 0, 256u << 20, 0, 0},
+      {"unknown chunks", 0, 0, 0, 0, 8, 32u << 20},
+  };
+
+  for (const StressLayout& layout : layouts) {
+    const std::string filename = "parser_stress_bench.wav";
+    writeStressFile(filename, layout);
+
+    for (bool lazy : {false, true}) {
+      const ChunkParserRegistry registry =
+          lazy ? lazyRegistry() : ChunkParserRegistry();
+      const std::string name =
+          std::string("open, ") + layout.name + (lazy ? ", lazy" : "");
+      reportOpenPeakRss(filename, name, registry);
+      BENCHMARK(name.c_str()) {
+        Bw64Reader reader(filename.c_str(), registry);
+        return reader.numberOfFrames();
+      };
+    }
+    std::remove(filename.c_str());
+  }
+}
@@ -0,0 +1,143 @@
+#include <catch2/catch.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "bw64/bw64.hpp"
+#include "bw64/pipeline.hpp"
+#include "test_helpers.hpp"
+
+using namespace bw64;
+
+/// source producing a given number of blocks, then throwing
+class FailingSource : public BlockSource {
+ public:
+  FailingSource(BlockPool& pool, int blocks) : pool_(pool), blocks_(blocks) {}
+  uint16_t channels() const override { return 1; }
+  uint32_t sampleRate() const override { return 48000; }
+  BlockPtr pull() override {
+    if (blocks_-- == 0) throw std::runtime_error("upstream failed");
+    return pool_.acquire(1);
+  }
+
+ private:
+  BlockPool& pool_;
+  int blocks_;
+};
+
+TEST_CASE("block_pool") {
+  BlockPool pool(64, 2, 2);
+  REQUIRE(pool.available() == 2);
+  {
+    BlockPtr a = pool.acquire(2);
+    REQUIRE(a->channels() == 2);
+    REQUIRE(a->frames() == 64);
+    BlockPtr b = pool.acquire(1);
+    REQUIRE(b->frameCapacity() == 128);
+    REQUIRE(pool.available() == 0);
+    REQUIRE_THROWS_AS(b->resize(1, 129), std::runtime_error);
+  }
+  REQUIRE(pool.available() == 2);
+  REQUIRE_THROWS_AS(pool.acquire(3), std::runtime_error);
+}
+
+TEST_CASE("pipeline_read_select_meter_write") {
+  const uint64_t frames = 10000;
+  writeTestFile("pipeline_in.wav", 4, frames);
+  auto peak = [](uint16_t channel) {
+    float result = 0.f;
+    for (uint64_t f = 0; f < frames; ++f)
+      result = std::max(result, std::abs(testSample(f, channel)));
+    return result;
+  };
+
+  auto useThread = GENERATE(false, true);
+  {
+    auto reader = readFile("pipeline_in.wav");
+    auto writer = writeFile("pipeline_out.wav", 6, 48000, 24);
+    BlockPool pool(1000, 6, 8);
+
+    ReaderSource source(*reader, pool);
+    std::unique_ptr<ThreadedStage> readAhead;
+    BlockSource* upstream = &source;
+    if (useThread) {
+      readAhead.reset(new ThreadedStage(source, 3));
+      upstream = readAhead.get();
+    }
+    // in place, then into a new block with more channels
+    ChannelSelect reverse(*upstream, {3, 2, 1}, pool);
+    ChannelSelect expand(reverse, {0, 1, 2, 2, 1, 0}, pool);
+    ConvertBitDepth convert(expand, 16);
+    Meter meter(convert);
+    WriterSink sink(*writer);
+    REQUIRE(meter.channels() == 6);
+
+    REQUIRE(runPipeline(meter, sink) == frames);
+    REQUIRE(meter.frames() == frames);
+    REQUIRE(meter.peak(0) == Approx(peak(3)).margin(1e-4));
+    REQUIRE(meter.peak(2) == Approx(peak(1)).margin(1e-4));
+    REQUIRE(meter.rms(0) > 0.0);
+    writer->close();
+    REQUIRE(pool.available() == pool.size());
+  }
+
+  auto reader = readFile("pipeline_out.wav");
+  REQUIRE(reader->numberOfFrames() == frames);
+  std::vector<float> data(frames * 6);
+  reader->read(data.data(), frames);
+  const uint16_t mapping[] = {3, 2, 1, 1, 2, 3};
+  for (uint64_t f = 0; f < frames; ++f)
+    for (uint16_t c = 0; c < 6; ++c)
+      REQUIRE(data[f * 6 + c] ==
+              Approx(testSample(f, mapping[c])).margin(1 / 32768.));
+}
+
+TEST_CASE("pipeline_threaded_error") {
+  BlockPool pool(16, 1, 4);
+  FailingSource source(pool, 2);
+  ThreadedStage stage(source, 2);
+  REQUIRE(stage.pull());
+  REQUIRE(stage.pull());
+  REQUIRE_THROWS_AS(stage.pull(), std::runtime_error);
+}
+
+TEST_CASE("pipeline_threaded_early_stop") {
+  writeTestFile("pipeline_stop.wav", 1, 100000);
+  auto reader = readFile("pipeline_stop.wav");
+  BlockPool pool(64, 1, 4);
+  ReaderSource source(*reader, pool);
+  {
+    ThreadedStage stage(source, 2);
+    REQUIRE(stage.pull()->frames() == 64);
+  }
+  REQUIRE(pool.available() == 4);
+}
+
+TEST_CASE("pipeline_invalid") {
+  BlockPool pool(16, 2, 4);
+  FailingSource source(pool, 0);
+  REQUIRE_THROWS_AS(ChannelSelect(source, {1}, pool), std::runtime_error);
+  REQUIRE_THROWS_AS(ChannelSelect(source, {0, 0, 0}, pool),
+                    std::runtime_error);
+  REQUIRE_THROWS_AS(ConvertBitDepth(source, 8), std::runtime_error);
+  REQUIRE_THROWS_AS(ThreadedStage(source, 0), std::runtime_error);
+}
+
+TEST_CASE("pipeline_pool_blocks") {
+  BlockPool pool(16, 2, 5);
+  FailingSource source(pool, 0);
+  REQUIRE(source.poolBlocks() == 1);
+  ConvertBitDepth convert(source, 16);
+  REQUIRE(convert.poolBlocks() == 1);
+  ChannelSelect expand(convert, {0, 0}, pool);
+  REQUIRE(expand.poolBlocks() == 2);
+  ChannelSelect select(expand, {1}, pool);
+  REQUIRE(select.poolBlocks() == 2);
+
+  // the queue could take all other blocks while the upmix holds its input
+  ThreadedStage stage(source, 4);
+  REQUIRE(stage.poolBlocks() == 5);
+  REQUIRE_THROWS_AS(ChannelSelect(stage, {0, 0}, pool), std::runtime_error);
+  REQUIRE_THROWS_AS(MatrixMix(stage, 2, {1.f, 1.f}, pool),
+                    std::runtime_error);
+  REQUIRE(MatrixMix(stage, 1, {1.f}, pool).poolBlocks() == 5);
+}
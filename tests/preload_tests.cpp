@@ -0,0 +1,58 @@
+#include <catch2/catch.hpp>
+#include <vector>
+#include "bw64/bw64.hpp"
+#include "bw64/preload.hpp"
+
+using namespace bw64;
+
+TEST_CASE("preload_cache") {
+  auto format = GENERATE(PreloadFormat::raw, PreloadFormat::decoded);
+  const uint64_t preloadFrames = 1000;
+
+  PreloadCache cache(preloadFrames, format, 4096);
+  cache.load({"rect_16bit.wav", "rect_24bit.wav", "rect_32bit.wav",
+              "noise_24bit_uneven_data_chunk_size.wav"},
+             2);
+  REQUIRE(cache.size() == 4);
+  REQUIRE(cache.entry(0).preloadedFrames == preloadFrames);
+  REQUIRE(cache.entry(3).preloadedFrames == 13);
+  REQUIRE(cache.memoryReserved() >= cache.memoryUsed());
+  if (format == PreloadFormat::raw) {
+    REQUIRE(cache.memoryUsed() == 1000 * (4 + 6 + 8) + 13 * 3);
+  }
+
+  for (size_t i = 0; i < cache.size(); ++i) {
+    auto reader = readFile(cache.entry(i).filename);
+    std::vector<float> expected(reader->numberOfFrames() * reader->channels());
+    reader->read(expected.data(), reader->numberOfFrames());
+
+    // read in blocks which straddle the end of the preloaded frames
+    auto cursor = cache.cursor(i);
+    REQUIRE(cursor.numberOfFrames() == reader->numberOfFrames());
+    REQUIRE(cursor.inPreload());
+    std::vector<float> actual(expected.size());
+    uint64_t frames = 0;
+    while (!cursor.eof()) {
+      frames += cursor.read(&actual[frames * cursor.channels()], 300);
+    }
+    REQUIRE(frames == reader->numberOfFrames());
+    REQUIRE_FALSE(cursor.inPreload());
+    REQUIRE(actual == expected);
+  }
+}
+
+TEST_CASE("preload_cache_missing_file") {
+  PreloadCache cache(100, PreloadFormat::raw, 1024);
+  cache.load({"rect_16bit.wav"});
+  const size_t used = cache.memoryUsed();
+  const size_t reserved = cache.memoryReserved();
+  REQUIRE_THROWS_AS(cache.load({"rect_16bit.wav", "rect_24bit.wav",
+                                "file_not_found.wav"}),
+                    std::runtime_error);
+  REQUIRE(cache.size() == 1);
+  REQUIRE(cache.memoryUsed() == used);
+  REQUIRE(cache.memoryReserved() == reserved);
+
+  cache.load({"rect_24bit.wav"});
+  REQUIRE(cache.memoryUsed() == used + 100 * 2 * 3);
+}
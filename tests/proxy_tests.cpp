@@ -0,0 +1,176 @@
+#include <catch2/catch.hpp>
+#include <cmath>
+#include <vector>
+#include "bw64/bw64.hpp"
+#include "bw64/proxy.hpp"
+#include "test_helpers.hpp"
+
+using namespace bw64;
+
+const double pi = 3.14159265358979323846;
+
+/// write a 1 kHz sine with amplitude 0.5 on one channel of a file
+void writeProxyInput(const std::string& filename, uint16_t channels,
+                     uint16_t sineChannel, uint64_t frames,
+                     std::shared_ptr<ChnaChunk> chna = nullptr,
+                     std::shared_ptr<AxmlChunk> axml = nullptr) {
+  writeSamples(
+      filename, channels, frames,
+      [sineChannel](uint64_t frame, uint16_t channel) {
+        if (channel != sineChannel) return 0.f;
+        return static_cast<float>(0.5 * std::sin(2 * pi * 1000.0 * frame /
+                                                 48000));
+      },
+      24, 48000, chna, axml);
+}
+
+/// RMS of one channel, ignoring the first and last `margin` frames
+double channelRms(const std::string& filename, uint16_t channel,
+                  uint64_t margin) {
+  auto reader = readFile(filename);
+  std::vector<float> data(reader->numberOfFrames() * reader->channels());
+  reader->read(data.data(), reader->numberOfFrames());
+  double sum = 0.0;
+  uint64_t n = 0;
+  for (uint64_t f = margin; f + margin < reader->numberOfFrames(); ++f, ++n)
+    sum += std::pow(data[f * reader->channels() + channel], 2);
+  return std::sqrt(sum / n);
+}
+
+TEST_CASE("default_mix_matrix") {
+  REQUIRE(defaultMixMatrix(2, 2) == std::vector<float>{1, 0, 0, 1});
+  REQUIRE(defaultMixMatrix(4, 1) == std::vector<float>(4, 0.25f));
+  REQUIRE(defaultMixMatrix(3, 2) == std::vector<float>{0.5, 0, 0.5, 0, 1, 0});
+  REQUIRE(defaultMixMatrix(1, 2) == std::vector<float>{1, 0});
+
+  const std::vector<float> surround = defaultMixMatrix(6, 2);
+  const float g = static_cast<float>(1 / std::sqrt(2.0));
+  REQUIRE(surround == std::vector<float>{1, 0, g, 0, g, 0,  //
+                                         0, 1, g, 0, 0, g});
+  REQUIRE_THROWS_AS(defaultMixMatrix(0, 2), std::runtime_error);
+}
+
+TEST_CASE("matrix_mix") {
+  BlockPool pool(16, 3, 4);
+  struct Source : public BlockSource {
+    explicit Source(BlockPool& pool) : pool_(pool) {}
+    uint16_t channels() const override { return 2; }
+    uint32_t sampleRate() const override { return 48000; }
+    BlockPtr pull() override {
+      if (done_) return nullptr;
+      done_ = true;
+      BlockPtr block = pool_.acquire(2);
+      block->resize(2, 2);
+      const float data[] = {1.f, 2.f, 3.f, 4.f};
+      std::copy(data, data + 4, block->data());
+      return block;
+    }
+    BlockPool& pool_;
+    bool done_ = false;
+  };
+
+  SECTION("down") {
+    Source source(pool);
+    MatrixMix mix(source, 1, {0.5f, 0.25f}, pool);
+    BlockPtr block = mix.pull();
+    REQUIRE(block->channels() == 1);
+    REQUIRE(block->frames() == 2);
+    REQUIRE(block->data()[0] == 1.f);
+    REQUIRE(block->data()[1] == 2.5f);
+  }
+
+  SECTION("up") {
+    Source source(pool);
+    MatrixMix mix(source, 3, {1, 0, 0, 1, 1, 1}, pool);
+    BlockPtr block = mix.pull();
+    REQUIRE(block->channels() == 3);
+    const std::vector<float> expected{1, 2, 3, 3, 4, 7};
+    REQUIRE(std::vector<float>(block->data(), block->data() + 6) == expected);
+    REQUIRE(mix.pull() == nullptr);
+  }
+
+  Source source(pool);
+  REQUIRE_THROWS_AS(MatrixMix(source, 2, {1, 0, 0}, pool), std::runtime_error);
+}
+
+TEST_CASE("write_proxy") {
+  const uint64_t frames = 48000;
+
+  SECTION("5.1 to stereo") {
+    auto axml = std::make_shared<AxmlChunk>("<ebuCoreMain/>");
+    auto chna = std::make_shared<ChnaChunk>();
+    for (uint16_t t = 1; t <= 6; ++t)
+      chna->addAudioId(AudioId(t, "ATU_0000000" + std::to_string(t),
+                               "AT_00010001_01", "AP_00010002"));
+    writeProxyInput("proxy_input.wav", 6, 2, frames, chna, axml);
+
+    ProxyOptions options;
+    options.blockFrames = 1000;
+    REQUIRE(writeProxy("proxy_input.wav", "proxy.wav", options) == 24000);
+
+    auto proxy = readFile("proxy.wav");
+    REQUIRE(proxy->channels() == 2);
+    REQUIRE(proxy->sampleRate() == 24000);
+    REQUIRE(proxy->bitDepth() == 16);
+    REQUIRE(proxy->numberOfFrames() == 24000);
+    // no proxy channel is an unchanged input channel, so the axml would
+    // refer to tracks which do not exist
+    REQUIRE_FALSE(proxy->axmlChunk());
+    REQUIRE(proxy->chnaChunk()->numUids() == 0);
+
+    // the centre sine at -3 dB in both channels
+    const double expected = 0.5 / std::sqrt(2.0) / std::sqrt(2.0);
+    REQUIRE(channelRms("proxy.wav", 0, 100) == Approx(expected).epsilon(0.01));
+    REQUIRE(channelRms("proxy.wav", 1, 100) == Approx(expected).epsilon(0.01));
+
+    options.channels = 6;
+    options.sampleRate = 0;
+    writeProxy("proxy_input.wav", "proxy.wav", options);
+    proxy = readFile("proxy.wav");
+    REQUIRE(proxy->axmlChunk()->data() == "<ebuCoreMain/>");
+    REQUIRE(proxy->chnaChunk()->numUids() == 6);
+  }
+
+  SECTION("channel selection keeps chna entries") {
+    auto chna = std::make_shared<ChnaChunk>();
+    for (uint16_t t = 1; t <= 3; ++t)
+      chna->addAudioId(AudioId(t, "ATU_0000000" + std::to_string(t),
+                               "AT_00010001_01", "AP_00010002"));
+    writeProxyInput("proxy_input.wav", 3, 2, frames, chna);
+
+    ProxyOptions options;
+    options.sampleRate = 0;
+    options.bitDepth = 24;
+    options.mixMatrix = {0, 0, 1, 0.5f, 0.5f, 0};
+    options.copyAxml = false;
+    REQUIRE(writeProxy("proxy_input.wav", "proxy.wav", options) == frames);
+
+    auto proxy = readFile("proxy.wav");
+    REQUIRE(proxy->sampleRate() == 48000);
+    REQUIRE_FALSE(proxy->axmlChunk());
+    const std::vector<AudioId> ids = proxy->chnaChunk()->audioIds();
+    REQUIRE(ids.size() == 1);
+    REQUIRE(ids[0].trackIndex() == 1);
+    REQUIRE(ids[0].uid() == "ATU_00000003");
+
+    auto input = readFile("proxy_input.wav");
+    std::vector<float> in(frames * 3), out(frames * 2);
+    input->read(in.data(), frames);
+    proxy->read(out.data(), frames);
+    for (uint64_t f = 0; f < frames; ++f) {
+      REQUIRE(out[f * 2] == in[f * 3 + 2]);
+      REQUIRE(out[f * 2 + 1] == Approx(0.5f * in[f * 3]).margin(1e-6));
+    }
+  }
+
+  SECTION("upsampling mono") {
+    writeProxyInput("proxy_input.wav", 1, 0, 4801);
+    ProxyOptions options;
+    options.channels = 1;
+    options.sampleRate = 96000;
+    options.blockFrames = 512;
+    REQUIRE(writeProxy("proxy_input.wav", "proxy.wav", options) == 9602);
+    REQUIRE(channelRms("proxy.wav", 0, 100) ==
+            Approx(0.5 / std::sqrt(2.0)).epsilon(0.01));
+  }
+}
@@ -0,0 +1,139 @@
+#include <catch2/catch.hpp>
+#include <cmath>
+#include <vector>
+#include "bw64/bw64.hpp"
+#include "bw64/resampler.hpp"
+
+using namespace bw64;
+
+const double pi = 3.14159265358979323846;
+
+/// sine of a given frequency on channel 0, and half of it on channel 1
+std::vector<float> makeSine(uint64_t frames, uint32_t sampleRate,
+                            double frequency) {
+  std::vector<float> data(frames * 2);
+  for (uint64_t f = 0; f < frames; ++f) {
+    data[f * 2] =
+        static_cast<float>(0.5 * std::sin(2 * pi * frequency * f / sampleRate));
+    data[f * 2 + 1] = 0.5f * data[f * 2];
+  }
+  return data;
+}
+
+/// largest error against makeSine, ignoring `margin` frames at both ends
+double sineError(const std::vector<float>& data, uint32_t sampleRate,
+                 double frequency, uint64_t margin) {
+  const std::vector<float> expected =
+      makeSine(data.size() / 2, sampleRate, frequency);
+  double error = 0.0;
+  for (size_t i = margin * 2; i + margin * 2 < data.size(); ++i)
+    error = std::max(error, std::abs(static_cast<double>(data[i]) -
+                                     static_cast<double>(expected[i])));
+  return error;
+}
+
+TEST_CASE("resampler_factors") {
+  Resampler resampler(44100, 48000, 2);
+  REQUIRE(resampler.upFactor() == 160);
+  REQUIRE(resampler.downFactor() == 147);
+  REQUIRE(resampler.latency() == resampler.taps() / 2);
+  REQUIRE(resampler.outputFrames(44100) == 48000);
+  REQUIRE(resampler.outputFrames(1) == 2);
+
+  Resampler down(96000, 48000, 1, 8);
+  REQUIRE(down.upFactor() == 1);
+  REQUIRE(down.downFactor() == 2);
+  // the filter is stretched to keep the cutoff below the output Nyquist
+  REQUIRE(down.taps() > Resampler(48000, 96000, 1, 8).taps());
+
+  REQUIRE_THROWS_AS(Resampler(0, 48000, 1), std::runtime_error);
+  REQUIRE_THROWS_AS(Resampler(48000, 48000, 0), std::runtime_error);
+}
+
+TEST_CASE("resampler_state_across_calls") {
+  const std::vector<float> input = makeSine(5000, 44100, 1000.0);
+
+  Resampler whole(44100, 48000, 2);
+  whole.push(input.data(), 5000);
+  whole.flush();
+  std::vector<float> expected(whole.available() * 2);
+  REQUIRE(whole.pull(expected.data(), whole.available()) ==
+          expected.size() / 2);
+
+  Resampler pieces(44100, 48000, 2);
+  std::vector<float> output;
+  std::vector<float> block(64 * 2);
+  for (uint64_t start = 0; start < 5000; start += 37) {
+    const uint64_t frames = std::min<uint64_t>(37, 5000 - start);
+    pieces.push(input.data() + start * 2, frames);
+    uint64_t pulled;
+    while ((pulled = pieces.pull(block.data(), 64)) > 0)
+      output.insert(output.end(), block.begin(), block.begin() + pulled * 2);
+  }
+  pieces.flush();
+  const uint64_t pulled = pieces.pull(block.data(), 64);
+  output.insert(output.end(), block.begin(), block.begin() + pulled * 2);
+  REQUIRE(pieces.available() == 0);
+
+  REQUIRE(output.size() == expected.size());
+  for (size_t i = 0; i < output.size(); ++i) REQUIRE(output[i] == expected[i]);
+}
+
+TEST_CASE("resampling_reader") {
+  const uint32_t inRate = GENERATE(44100u, 48000u, 96000u);
+  const uint64_t frames = inRate / 10;
+  {
+    auto writer = writeFile("resampler_in.wav", 2, inRate, 32);
+    writer->write(makeSine(frames, inRate, 1000.0).data(), frames);
+    writer->close();
+  }
+
+  auto reader = readFile("resampler_in.wav");
+  ResamplingReader resampling(*reader, 48000);
+  REQUIRE(resampling.channels() == 2);
+  REQUIRE(resampling.sampleRate() == 48000);
+  REQUIRE(resampling.numberOfFrames() == 4800);
+  REQUIRE(resampling.latency() > 0);
+
+  std::vector<float> data(4800 * 2);
+  uint64_t read = 0;
+  while (!resampling.eof()) read += resampling.read(&data[read * 2], 1000);
+  REQUIRE(read == 4800);
+  REQUIRE(resampling.read(data.data(), 1) == 0);
+  REQUIRE(sineError(data, 48000, 1000.0, 100) < 1e-3);
+}
+
+TEST_CASE("resampler_rejects_above_nyquist") {
+  // 30 kHz is above the Nyquist frequency of the output
+  const std::vector<float> input = makeSine(9600, 96000, 30000.0);
+  Resampler resampler(96000, 48000, 2);
+  resampler.push(input.data(), 9600);
+  resampler.flush();
+  std::vector<float> output(4800 * 2);
+  REQUIRE(resampler.pull(output.data(), 4800) == 4800);
+  float peak = 0.f;
+  for (size_t i = 400; i + 400 < output.size(); ++i)
+    peak = std::max(peak, std::abs(output[i]));
+  REQUIRE(peak < 1e-3f);
+}
+
+TEST_CASE("resampling_writer") {
+  const uint64_t frames = 4410;
+  const std::vector<float> input = makeSine(frames, 44100, 440.0);
+  {
+    auto writer = writeFile("resampler_out.wav", 2, 48000, 32);
+    ResamplingWriter resampling(*writer, 44100);
+    REQUIRE(resampling.sampleRate() == 44100);
+    for (uint64_t start = 0; start < frames; start += 1000)
+      resampling.write(&input[start * 2],
+                       std::min<uint64_t>(1000, frames - start));
+    resampling.flush();
+    writer->close();
+  }
+
+  auto reader = readFile("resampler_out.wav");
+  REQUIRE(reader->numberOfFrames() == 4800);
+  std::vector<float> data(4800 * 2);
+  reader->read(data.data(), 4800);
+  REQUIRE(sineError(data, 48000, 440.0, 100) < 1e-3);
+}
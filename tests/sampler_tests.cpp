@@ -0,0 +1,126 @@
+#include <catch2/catch.hpp>
+#include <string>
+#include <vector>
+#include "bw64/bw64.hpp"
+#include "bw64/sampler.hpp"
+#include "test_helpers.hpp"
+
+using namespace bw64;
+
+std::string samplerFile(int file) {
+  return "sampler_" + std::to_string(file) + ".wav";
+}
+
+void writeSamplerFiles(int files, uint64_t frames) {
+  for (int file = 0; file < files; ++file)
+    writeTestFile(samplerFile(file), 2, frames, 32, file);
+}
+
+std::vector<WindowRequest> samplerRequests(int batch) {
+  std::vector<WindowRequest> requests;
+  for (int i = 0; i < 12; ++i) {
+    const int file = (i * 7 + batch) % 4;
+    const uint64_t frame = static_cast<uint64_t>((i * 331 + batch * 97) % 900);
+    requests.push_back({samplerFile(file), frame, 64});
+  }
+  // partially behind the end of the file, and shorter than a window
+  requests.push_back({samplerFile(0), 990, 64});
+  requests.push_back({samplerFile(1), 10, 20});
+  return requests;
+}
+
+/// get sample (window, frame, channel) of a batch as float
+float batchSample(Batch& batch, size_t window, uint64_t frame,
+                  uint16_t channel) {
+  const uint64_t index = batch.layout() == BatchLayout::interleaved
+                             ? frame * batch.channels() + channel
+                             : channel * batch.windowFrames() + frame;
+  if (batch.format() == BatchFormat::float32)
+    return batch.window<float>(window)[index];
+  return utils::halfToFloat(batch.window<uint16_t>(window)[index]);
+}
+
+void checkBatch(Batch& batch) {
+  const double margin = batch.format() == BatchFormat::float32 ? 1e-6 : 1e-3;
+  for (size_t w = 0; w < batch.size(); ++w) {
+    const WindowRequest& request = batch.requests()[w];
+    const int file = request.filename[8] - '0';
+    const uint64_t available =
+        std::min<uint64_t>(request.frames, 1000 - request.frame);
+    REQUIRE(batch.framesRead(w) == available);
+    for (uint64_t f = 0; f < batch.windowFrames(); ++f) {
+      for (uint16_t c = 0; c < 2; ++c) {
+        const float expected =
+            f < available ? testSample(request.frame + f, c, file) : 0.f;
+        REQUIRE(batchSample(batch, w, f, c) ==
+                Approx(expected).margin(margin));
+      }
+    }
+  }
+}
+
+TEST_CASE("batch_sampler") {
+  writeSamplerFiles(4, 1000);
+  const BatchLayout layout =
+      GENERATE(BatchLayout::interleaved, BatchLayout::planar);
+  const BatchFormat format =
+      GENERATE(BatchFormat::float32, BatchFormat::float16);
+
+  BatchSampler sampler(2, 64, layout, format, 3, 4);
+  Batch first = sampler.read(samplerRequests(0));
+  REQUIRE(first.size() == 14);
+  REQUIRE(first.bytes() == 14 * 2 * 64 * first.sampleSize());
+  checkBatch(first);
+
+  // prefetch: several batches in flight
+  sampler.submit(samplerRequests(1));
+  sampler.submit(samplerRequests(2));
+  REQUIRE(sampler.pending() == 2);
+  REQUIRE_THROWS_AS(sampler.read(samplerRequests(3)), std::runtime_error);
+  for (int i = 3; i < 6; ++i) {
+    sampler.submit(samplerRequests(i));
+    Batch batch = sampler.next();
+    checkBatch(batch);
+  }
+  REQUIRE(sampler.pending() == 2);
+  REQUIRE(sampler.cache().size() <= 4);
+  REQUIRE(sampler.cache().hits() > 0);
+}
+
+TEST_CASE("batch_sampler_errors") {
+  writeSamplerFiles(1, 100);
+  BatchSampler sampler(1, 16, BatchLayout::interleaved, BatchFormat::float32,
+                       2);
+  REQUIRE_THROWS_AS(sampler.next(), std::runtime_error);
+  REQUIRE_THROWS_AS(sampler.submit({{samplerFile(0), 0, 17}}),
+                    std::runtime_error);
+  // wrong number of channels
+  REQUIRE_THROWS_AS(sampler.read({{samplerFile(0), 0, 16}}),
+                    std::runtime_error);
+  REQUIRE_THROWS_AS(sampler.read({{"file_not_found.wav", 0, 16}}),
+                    std::runtime_error);
+  REQUIRE(sampler.pending() == 0);
+
+  Batch batch(std::vector<WindowRequest>(2), 1, 16, BatchLayout::planar,
+              BatchFormat::float16);
+  REQUIRE_THROWS_AS(batch.window<float>(0), std::runtime_error);
+  REQUIRE_THROWS_AS(batch.window<uint16_t>(2), std::runtime_error);
+}
+
+TEST_CASE("reader_cache") {
+  writeSamplerFiles(3, 10);
+  ReaderCache cache(2);
+  auto a = cache.acquire(samplerFile(0));
+  auto b = cache.acquire(samplerFile(0));
+  REQUIRE(cache.opened() == 2);
+  cache.release(samplerFile(0), std::move(a));
+  cache.release(samplerFile(0), std::move(b));
+  cache.release(samplerFile(1), cache.acquire(samplerFile(1)));
+  // the least recently used reader of file 0 was closed
+  REQUIRE(cache.size() == 2);
+  REQUIRE(cache.opened() == 3);
+  cache.acquire(samplerFile(0));
+  REQUIRE(cache.hits() == 1);
+  cache.acquire(samplerFile(0));
+  REQUIRE(cache.opened() == 4);
+}
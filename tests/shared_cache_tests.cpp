@@ -0,0 +1,141 @@
+#include <catch2/catch.hpp>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "bw64/bw64.hpp"
+#include "bw64/shared_cache.hpp"
+#include "test_helpers.hpp"
+
+using namespace bw64;
+
+std::string cacheName(const std::string& test) {
+  return "/bw64-test-" + test + "-" + std::to_string(getpid());
+}
+
+TEST_CASE("shared_block_cache") {
+  const std::string name = cacheName("blocks");
+  SharedBlockCache::remove(name);
+  SharedBlockCache cache(name, 16 * 1000, 1000);
+  REQUIRE(cache.created());
+  REQUIRE(cache.blockBytes() == 1024);
+  REQUIRE(cache.slots() == 15);
+
+  FileIdentity file;
+  file.inode = 42;
+  std::vector<char> block(1000);
+  for (size_t i = 0; i < block.size(); ++i) block[i] = static_cast<char>(i);
+  std::vector<char> out(1000, 0);
+  REQUIRE_FALSE(cache.lookup(file, 7, 1000, 0, 1000, out.data()));
+  cache.insert(file, 7, block.data(), 1000);
+  REQUIRE(cache.lookup(file, 7, 1000, 0, 1000, out.data()));
+  REQUIRE(out == block);
+  REQUIRE(cache.lookup(file, 7, 1000, 10, 5, out.data()));
+  REQUIRE(out[0] == 10);
+  REQUIRE_FALSE(cache.lookup(file, 7, 999, 0, 10, out.data()));
+  REQUIRE_FALSE(cache.lookup(file, 7, 1000, 990, 20, out.data()));
+  REQUIRE_FALSE(cache.lookup(file, 8, 1000, 0, 10, out.data()));
+  file.modified = 1;
+  REQUIRE_FALSE(cache.lookup(file, 7, 1000, 0, 10, out.data()));
+  REQUIRE(cache.hits() == 2);
+  REQUIRE(cache.misses() == 4);
+
+  SECTION("attach") {
+    SharedBlockCache other(name, 1 << 20, 64);
+    REQUIRE_FALSE(other.created());
+    REQUIRE(other.blockBytes() == 1024);
+    REQUIRE(other.slots() == 15);
+    file.modified = 0;
+    REQUIRE(other.lookup(file, 7, 1000, 0, 1000, out.data()));
+    REQUIRE(out == block);
+  }
+
+  SECTION("replacement") {
+    // more blocks than slots; all lookups either miss or return the block
+    for (uint64_t b = 0; b < 100; ++b) {
+      block[0] = static_cast<char>(b);
+      cache.insert(file, b, block.data(), 1000);
+    }
+    int found = 0;
+    for (uint64_t b = 0; b < 100; ++b) {
+      if (cache.lookup(file, b, 1000, 0, 1, out.data())) {
+        REQUIRE(out[0] == static_cast<char>(b));
+        ++found;
+      }
+    }
+    REQUIRE(found > 0);
+    REQUIRE(found <= 15);
+  }
+
+  REQUIRE(SharedBlockCache::remove(name));
+  REQUIRE_FALSE(SharedBlockCache::remove(name));
+  REQUIRE_THROWS_AS(SharedBlockCache("no-slash"), std::runtime_error);
+}
+
+TEST_CASE("shared_block_cache_reader") {
+  const std::string name = cacheName("reader");
+  SharedBlockCache::remove(name);
+  const uint64_t frames = 10000;
+  writeTestFile("shared_cache.wav", 3, frames);
+
+  std::vector<float> expected(frames * 3);
+  readFile("shared_cache.wav")->read(expected.data(), frames);
+
+  // one process reads the file through the cache in uneven steps
+  const pid_t child = fork();
+  REQUIRE(child >= 0);
+  if (child == 0) {
+    int status = 1;
+    try {
+      auto cache = std::make_shared<SharedBlockCache>(name, 1 << 20, 4096);
+      auto reader = readFile("shared_cache.wav");
+      reader->useBlockCache(cache);
+      std::vector<float> data(frames * 3);
+      uint64_t done = 0;
+      while (done < frames)
+        done += reader->read(data.data() + done * 3, 777);
+      if (data == expected && cache->misses() > 0) status = 0;
+    } catch (...) {
+    }
+    _exit(status);
+  }
+  int status = -1;
+  REQUIRE(waitpid(child, &status, 0) == child);
+  REQUIRE(WIFEXITED(status));
+  REQUIRE(WEXITSTATUS(status) == 0);
+
+  // another one finds all blocks
+  auto cache = std::make_shared<SharedBlockCache>(name);
+  REQUIRE_FALSE(cache->created());
+  auto reader = readFile("shared_cache.wav");
+  reader->useBlockCache(cache);
+  REQUIRE(reader->blockCache() == cache);
+  std::vector<float> data(frames * 3);
+  reader->seek(123);
+  REQUIRE(reader->read(data.data(), frames) == frames - 123);
+  REQUIRE(std::equal(data.begin(), data.begin() + (frames - 123) * 3,
+                     expected.begin() + 123 * 3));
+  REQUIRE(reader->tell() == frames);
+  REQUIRE(cache->hits() > 0);
+  REQUIRE(cache->misses() == 0);
+
+  // double reads do not use the cache
+  std::vector<double> doubles(10);
+  reader->seek(0);
+  REQUIRE(reader->read(doubles.data(), 3) == 3);
+  REQUIRE(doubles[4] == Approx(expected[4]));
+  REQUIRE(cache->misses() == 0);
+
+  // a changed file has a different identity, and can not be identified by
+  // readers which opened it before the change
+  writeTestFile("shared_cache.wav", 3, frames + 1);
+  REQUIRE_THROWS_AS(reader->useBlockCache(cache), std::runtime_error);
+  auto changed = readFile("shared_cache.wav");
+  changed->useBlockCache(cache);
+  REQUIRE(changed->read(data.data(), 10) == 10);
+  REQUIRE(cache->misses() == 1);
+
+  reader->useBlockCache(nullptr);
+  REQUIRE_FALSE(reader->blockCache());
+  SharedBlockCache::remove(name);
+}
@@ -0,0 +1,79 @@
+#include <catch2/catch.hpp>
+#include <string>
+#include <vector>
+#include "bw64/bw64.hpp"
+#include "bw64/stems.hpp"
+#include "test_helpers.hpp"
+
+using namespace bw64;
+
+/// expected value of a combined channel
+float combinedSample(uint64_t frame, uint16_t channel) {
+  // stems have 2, 1 and 3 channels, and 1000, 600 and 1000 frames
+  if (channel < 2) return testSample(frame, channel, 0);
+  if (channel < 3) return frame < 600 ? testSample(frame, 0, 1) : 0.f;
+  return testSample(frame, channel - 3, 2);
+}
+
+TEST_CASE("stem_reader") {
+  writeTestFile("stem_0.wav", 2, 1000, 24, 0);
+  writeTestFile("stem_1.wav", 1, 600, 24, 1);
+  writeTestFile("stem_2.wav", 3, 1000, 24, 2);
+  const size_t threads = GENERATE(0, 1, 2);
+  StemReader stems({"stem_0.wav", "stem_1.wav", "stem_2.wav"}, threads);
+  REQUIRE(stems.size() == 3);
+  REQUIRE(stems.channels() == 6);
+  REQUIRE(stems.channelOffset(0) == 0);
+  REQUIRE(stems.channelOffset(1) == 2);
+  REQUIRE(stems.channelOffset(2) == 3);
+  REQUIRE(stems.sampleRate() == 48000);
+  REQUIRE(stems.numberOfFrames() == 1000);
+  REQUIRE(stems.reader(1).numberOfFrames() == 600);
+
+  SECTION("interleaved") {
+    stems.seek(500);
+    std::vector<float> data(300 * 6, -1.f);
+    REQUIRE(stems.read(data.data(), 300) == 300);
+    for (uint64_t f = 0; f < 300; ++f)
+      for (uint16_t c = 0; c < 6; ++c)
+        REQUIRE(data[f * 6 + c] ==
+                Approx(combinedSample(500 + f, c)).margin(1e-6));
+    REQUIRE(stems.tell() == 800);
+  }
+
+  SECTION("sequential reads") {
+    std::vector<float> data(64 * 6);
+    uint64_t frame = 0;
+    while (!stems.eof()) {
+      const uint64_t n = stems.read(data.data(), 64);
+      for (uint64_t f = 0; f < n; ++f, ++frame)
+        for (uint16_t c = 0; c < 6; ++c)
+          REQUIRE(data[f * 6 + c] ==
+                  Approx(combinedSample(frame, c)).margin(1e-6));
+    }
+    REQUIRE(frame == 1000);
+  }
+
+  SECTION("planar") {
+    stems.seek(-250, std::ios::end);
+    std::vector<std::vector<float>> channels(6, std::vector<float>(300, -1.f));
+    std::vector<float*> pointers;
+    for (auto& channel : channels) pointers.push_back(channel.data());
+    REQUIRE(stems.readPlanar(pointers.data(), 300) == 250);
+    REQUIRE(stems.eof());
+    for (uint64_t f = 0; f < 250; ++f)
+      for (uint16_t c = 0; c < 6; ++c)
+        REQUIRE(channels[c][f] ==
+                Approx(combinedSample(750 + f, c)).margin(1e-6));
+  }
+}
+
+TEST_CASE("stem_reader_errors") {
+  writeTestFile("stem_0.wav", 2, 100, 24, 0);
+  writeTestFile("stem_44k.wav", 1, 100, 24, 1, 44100);
+  REQUIRE_THROWS_AS(StemReader({}), std::runtime_error);
+  REQUIRE_THROWS_AS(StemReader({"stem_0.wav", "stem_44k.wav"}),
+                    std::runtime_error);
+  REQUIRE_THROWS_AS(StemReader({"stem_0.wav", "file_not_found.wav"}),
+                    std::runtime_error);
+}
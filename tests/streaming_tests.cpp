@@ -0,0 +1,114 @@
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "bw64/bw64.hpp"
+#include "bw64/streaming.hpp"
+#include "test_helpers.hpp"
+
+using namespace bw64;
+
+TEST_CASE("streaming_engine_service") {
+  writeTestFile("streaming_ramp.wav", 2, 10000);
+
+  StreamingEngine engine(0, 4096, 1024);
+  auto voice = engine.addVoice("streaming_ramp.wav", 100);
+  auto late = engine.addVoice("streaming_ramp.wav", 9000);
+  REQUIRE(engine.voices() == 2);
+  REQUIRE(voice->channels() == 2);
+  REQUIRE(voice->bufferedFrames() == 0);
+
+  // nothing has been read yet, so this is an underrun
+  std::vector<float> block(512 * 2);
+  REQUIRE(voice->read(block.data(), 512) == 0);
+  REQUIRE(voice->underruns() == 1);
+  REQUIRE(block[0] == 0.f);
+
+  REQUIRE(engine.service() == 2);
+  REQUIRE(voice->bufferedFrames() == 4096);
+  REQUIRE(late->bufferedFrames() == 1000);
+  REQUIRE(late->endOfFile());
+  REQUIRE_FALSE(late->finished());
+  REQUIRE(engine.minimumUnderrunMargin() == Approx(4096 / 48000.));
+
+  // not enough space free for a refill yet
+  REQUIRE(voice->read(block.data(), 512) == 512);
+  REQUIRE(engine.service() == 0);
+
+  uint64_t frame = 100;
+  for (uint64_t f = 0; f < 512; ++f, ++frame)
+    for (uint16_t c = 0; c < 2; ++c)
+      REQUIRE(block[f * 2 + c] == Approx(testSample(frame, c)));
+
+  while (!voice->finished()) {
+    engine.service();
+    uint64_t n = voice->read(block.data(), 512);
+    for (uint64_t f = 0; f < n; ++f, ++frame)
+      for (uint16_t c = 0; c < 2; ++c)
+        REQUIRE(block[f * 2 + c] == Approx(testSample(frame, c)));
+  }
+  REQUIRE(frame == 10000);
+  REQUIRE(voice->underruns() == 1);
+
+  engine.removeVoice(late);
+  REQUIRE(engine.voices() == 1);
+}
+
+TEST_CASE("streaming_engine_remove_pending") {
+  writeTestFile("streaming_ramp_remove.wav", 1, 10000);
+
+  StreamingEngine engine(0, 4096, 1024);
+  auto voice = engine.addVoice("streaming_ramp_remove.wav");
+  auto other = engine.addVoice("streaming_ramp_remove.wav");
+  REQUIRE(engine.service() == 2);
+
+  // both voices request a refill from read(); the removed one is dropped
+  std::vector<float> block(2048);
+  REQUIRE(voice->read(block.data(), 2048) == 2048);
+  REQUIRE(other->read(block.data(), 2048) == 2048);
+  engine.removeVoice(voice);
+  REQUIRE(engine.voices() == 1);
+  REQUIRE(engine.service() == 1);
+  REQUIRE(voice->bufferedFrames() == 2048);
+  REQUIRE(other->bufferedFrames() == 4096);
+
+  // and does not request any more
+  REQUIRE(voice->read(block.data(), 2048) == 2048);
+  REQUIRE(engine.service() == 0);
+}
+
+TEST_CASE("streaming_engine_threads") {
+  writeTestFile("streaming_ramp_threads.wav", 1, 20000);
+
+  StreamingEngine engine(2, 2048, 512, std::chrono::microseconds(200));
+  std::vector<std::shared_ptr<StreamingVoice>> voices;
+  for (uint64_t i = 0; i < 8; ++i)
+    voices.push_back(engine.addVoice("streaming_ramp_threads.wav", i * 100));
+
+  std::vector<uint64_t> frames;
+  for (uint64_t i = 0; i < 8; ++i) frames.push_back(i * 100);
+
+  std::vector<float> block(256);
+  auto start = std::chrono::steady_clock::now();
+  bool done = false;
+  while (!done) {
+    REQUIRE(std::chrono::steady_clock::now() - start <
+            std::chrono::seconds(30));
+    done = true;
+    for (size_t i = 0; i < voices.size(); ++i) {
+      uint64_t n = voices[i]->read(block.data(), 256);
+      for (uint64_t f = 0; f < n; ++f, ++frames[i])
+        REQUIRE(block[f] == Approx(testSample(frames[i], 0)));
+      done = done && voices[i]->finished();
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  for (size_t i = 0; i < voices.size(); ++i) REQUIRE(frames[i] == 20000);
+}
+
+TEST_CASE("streaming_engine_invalid") {
+  REQUIRE_THROWS_AS(StreamingEngine(0, 0, 0), std::runtime_error);
+  REQUIRE_THROWS_AS(StreamingEngine(0, 1024, 2048), std::runtime_error);
+  StreamingEngine engine(0);
+  REQUIRE_THROWS_AS(engine.addVoice("file_not_found.wav"), std::runtime_error);
+}
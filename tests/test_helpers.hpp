@@ -0,0 +1,76 @@
+// helpers shared by the unit tests, for writing files with known contents
+#pragma once
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "bw64/bw64.hpp"
+
+/**
+ * value of sample (frame, channel) of test file number `file`, such that
+ * every file, frame and the first 32 channels can be identified
+ *
+ * Values stay within [-0.5, 1) for files 0 to 3, and differ by more than
+ * the quantisation step of 16 bit samples.
+ */
+inline float testSample(uint64_t frame, uint16_t channel, int file = 0) {
+  return static_cast<float>((frame % 128) / 512.0 + file * 0.25 -
+                            (channel % 32) / 64.0);
+}
+
+/// write a file with `frames` frames of `sample(frame, channel)`
+template <typename Sample>
+void writeSamples(const std::string& filename, uint16_t channels,
+                  uint64_t frames, Sample sample, uint16_t bitDepth = 24,
+                  uint32_t sampleRate = 48000,
+                  std::shared_ptr<bw64::ChnaChunk> chna = nullptr,
+                  std::shared_ptr<bw64::AxmlChunk> axml = nullptr) {
+  std::vector<float> data(frames * channels);
+  for (uint64_t f = 0; f < frames; ++f)
+    for (uint16_t c = 0; c < channels; ++c)
+      data[f * channels + c] = sample(f, c);
+  auto writer =
+      bw64::writeFile(filename, channels, sampleRate, bitDepth, chna, axml);
+  writer->write(data.data(), frames);
+  writer->close();
+}
+
+/// write a file of testSample(frame, channel, file)
+inline void writeTestFile(const std::string& filename, uint16_t channels,
+                          uint64_t frames, uint16_t bitDepth = 24,
+                          int file = 0, uint32_t sampleRate = 48000) {
+  writeSamples(
+      filename, channels, frames,
+      [file](uint64_t frame, uint16_t channel) {
+        return testSample(frame, channel, file);
+      },
+      bitDepth, sampleRate);
+}
+
+/// write a file of random samples between -1 and 1
+inline void writeRandom(const std::string& filename, uint16_t bitDepth,
+                        uint64_t frames, uint16_t channels = 1u,
+                        uint32_t sampleRate = 48000u) {
+  std::random_device rd;
+  std::mt19937 engine(rd());
+  std::uniform_real_distribution<float> dist(-1.f, 1.f);
+  writeSamples(
+      filename, channels, frames,
+      [&](uint64_t, uint16_t) { return dist(engine); }, bitDepth,
+      sampleRate);
+}
+
+/// chunk holding `data` as is, to write malformed chunks
+inline std::shared_ptr<bw64::UnknownChunk> rawChunk(const char* id,
+                                                    const std::string& data) {
+  std::istringstream stream(data);
+  return std::make_shared<bw64::UnknownChunk>(stream, bw64::utils::fourCC(id),
+                                              data.size());
+}
+
+inline bool fileExists(const std::string& filename) {
+  return std::ifstream(filename).good();
+}
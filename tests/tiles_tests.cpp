@@ -0,0 +1,150 @@
+#include <catch2/catch.hpp>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "bw64/bw64.hpp"
+#include "bw64/tiles.hpp"
+#include "test_helpers.hpp"
+
+using namespace bw64;
+
+void writeTilesInput(const std::string& filename, uint16_t channels,
+                     uint64_t frames, uint16_t bitDepth, float gain = 1.f) {
+  writeSamples(
+      filename, channels, frames,
+      [gain](uint64_t frame, uint16_t channel) {
+        return gain * testSample(frame, channel);
+      },
+      bitDepth);
+}
+
+TEST_CASE("tiled_sidecar_header") {
+  TiledSidecarHeader header;
+  header.channels = 3;
+  header.bitDepth = 24;
+  header.tileFrames = 100;
+  header.numberOfFrames = 250;
+  REQUIRE(header.framesInTile(0) == 100);
+  REQUIRE(header.framesInTile(2) == 50);
+  REQUIRE(header.offset(0, 0) == TiledSidecarHeader::size());
+  REQUIRE(header.offset(0, 2) == TiledSidecarHeader::size() + 2 * 100 * 3);
+  REQUIRE(header.offset(2, 1) ==
+          TiledSidecarHeader::size() + (2 * 100 * 3 + 50) * 3);
+
+  std::stringstream stream;
+  header.write(stream);
+  REQUIRE(stream.str().size() == TiledSidecarHeader::size());
+  const TiledSidecarHeader read = TiledSidecarHeader::read(stream);
+  REQUIRE(read.channels == 3);
+  REQUIRE(read.numberOfFrames == 250);
+
+  std::stringstream invalid("BW64TILX");
+  REQUIRE_THROWS_AS(TiledSidecarHeader::read(invalid), std::runtime_error);
+}
+
+TEST_CASE("read_channel") {
+  const uint16_t bitDepth = GENERATE(16, 24, 32);
+  const uint64_t frames = 1000;
+  writeTilesInput("tiles.wav", 5, frames, bitDepth);
+  std::remove(tiledSidecarPath("tiles.wav").c_str());
+  const double margin = bitDepth == 16 ? 1 / 32768. : 1e-6;
+
+  auto readAndCheck = [&](Bw64Reader& reader, uint16_t channel,
+                          uint64_t frame, uint64_t count) {
+    const uint64_t total = reader.numberOfFrames();
+    std::vector<float> data(count, -1.f);
+    const uint64_t expected = frame < total ? std::min(count, total - frame)
+                                            : 0;
+    REQUIRE(reader.readChannel(channel, frame, data.data(), count) ==
+            expected);
+    for (uint64_t f = 0; f < expected; ++f)
+      REQUIRE(data[f] == Approx(testSample(frame + f, channel)).margin(margin));
+  };
+
+  SECTION("without sidecar") {
+    auto reader = readFile("tiles.wav");
+    readAndCheck(*reader, 3, 0, frames);
+    REQUIRE_FALSE(reader->hasTiledSidecar());
+    REQUIRE(reader->tell() == 0);
+  }
+
+  SECTION("with sidecar") {
+    readFile("tiles.wav")->writeTiledSidecar("", 64);
+    auto reader = readFile("tiles.wav");
+    reader->seek(10);
+    readAndCheck(*reader, 4, 0, frames);
+    REQUIRE(reader->hasTiledSidecar());
+    readAndCheck(*reader, 0, 63, 2);
+    readAndCheck(*reader, 2, 990, 64);
+    readAndCheck(*reader, 1, 1000, 1);
+    REQUIRE(reader->tell() == 10);
+    REQUIRE_THROWS_AS(reader->readChannel(5, 0, (float*)nullptr, 0),
+                      std::runtime_error);
+  }
+
+  SECTION("stale sidecar") {
+    readFile("tiles.wav")->writeTiledSidecar("", 64);
+    writeTilesInput("tiles.wav", 5, frames + 1, bitDepth);
+    auto reader = readFile("tiles.wav");
+    readAndCheck(*reader, 1, 500, 501);
+    REQUIRE_FALSE(reader->hasTiledSidecar());
+    REQUIRE_THROWS_AS(reader->useTiledSidecar(tiledSidecarPath("tiles.wav")),
+                      std::runtime_error);
+  }
+
+  SECTION("incomplete sidecar") {
+    {
+      TiledSidecarHeader header;
+      header.channels = 5;
+      header.bitDepth = bitDepth;
+      header.tileFrames = 64;
+      header.numberOfFrames = frames;
+      TiledSidecarWriter writer(tiledSidecarPath("tiles.wav"), header);
+      std::vector<char> tile(64 * 5 * bitDepth / 8);
+      writer.writeTile(tile.data());
+      REQUIRE_FALSE(fileExists(tiledSidecarPath("tiles.wav")));
+      REQUIRE_THROWS_AS(writer.close(), std::runtime_error);
+    }
+    REQUIRE_FALSE(fileExists(tiledSidecarPath("tiles.wav")));
+    REQUIRE_FALSE(fileExists(tiledSidecarPath("tiles.wav") + ".partial"));
+
+    // e.g. left behind by a crash after the rename by another tool
+    readFile("tiles.wav")->writeTiledSidecar("", 64);
+    std::vector<char> sidecar;
+    {
+      std::ifstream in(tiledSidecarPath("tiles.wav"), std::ios::binary);
+      sidecar.assign(std::istreambuf_iterator<char>(in),
+                     std::istreambuf_iterator<char>());
+    }
+    {
+      std::ofstream out(tiledSidecarPath("tiles.wav"), std::ios::binary);
+      out.write(sidecar.data(), sidecar.size() / 2);
+    }
+    auto reader = readFile("tiles.wav");
+    readAndCheck(*reader, 4, 900, 100);
+    REQUIRE_FALSE(reader->hasTiledSidecar());
+  }
+
+  SECTION("sidecar truncated while in use") {
+    readFile("tiles.wav")->writeTiledSidecar("", 64);
+    auto reader = readFile("tiles.wav");
+    readAndCheck(*reader, 4, 0, 10);
+    REQUIRE(reader->hasTiledSidecar());
+    std::ofstream(tiledSidecarPath("tiles.wav"), std::ios::binary).close();
+    readAndCheck(*reader, 4, 900, 100);
+    REQUIRE_FALSE(reader->hasTiledSidecar());
+  }
+
+  SECTION("sidecar of a file re-rendered at the same length") {
+    readFile("tiles.wav")->writeTiledSidecar("", 64);
+    writeTilesInput("tiles.wav", 5, frames, bitDepth, -1.f);
+    auto reader = readFile("tiles.wav");
+    std::vector<float> data(frames);
+    REQUIRE(reader->readChannel(2, 0, data.data(), frames) == frames);
+    REQUIRE_FALSE(reader->hasTiledSidecar());
+    for (uint64_t f = 0; f < frames; ++f)
+      REQUIRE(data[f] == Approx(-testSample(f, 2)).margin(margin));
+  }
+}
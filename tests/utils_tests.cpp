@@ -227,6 +227,94 @@ TEST_CASE("decode_encode_passthrough") {
   SECTION("32 bit double") { checkDecodeEncodeAroundEdges<4, double>(1000); }
 }
 
+TEST_CASE("decode_pcm_frames_reversed") {
+  // 3 frames of 2 channels
+  const int16_t encoded[] = {1, 2, 3, 4, 5, 6};
+  float decoded[6];
+  utils::decodePcmFramesReversed(reinterpret_cast<const char*>(encoded),
+                                 decoded, 3, 2, 16);
+  const float expected[] = {5, 6, 3, 4, 1, 2};
+  for (int i = 0; i < 6; ++i) REQUIRE(decoded[i] == expected[i] / 32768.f);
+
+  REQUIRE_THROWS_AS(utils::decodePcmFramesReversed(
+                        reinterpret_cast<const char*>(encoded), decoded, 3, 2,
+                        8),
+                    std::runtime_error);
+}
+
+TEST_CASE("convert_pcm_samples_to_big_endian") {
+  // enough samples for several vector steps and a scalar tail
+  const uint64_t samples = 37;
+  std::vector<char> in(samples * 4);
+  for (size_t i = 0; i < in.size(); ++i) in[i] = static_cast<char>(i * 7 + 1);
+
+  for (int inBytes : {2, 3, 4}) {
+    for (int outBytes : {2, 3}) {
+      std::vector<char> out(samples * outBytes);
+      utils::convertPcmSamplesToBigEndian(in.data(), out.data(), samples,
+                                          inBytes * 8, outBytes * 8);
+      for (uint64_t i = 0; i < samples; ++i)
+        for (int b = 0; b < outBytes; ++b)
+          REQUIRE(out[i * outBytes + b] ==
+                  (b < inBytes ? in[i * inBytes + inBytes - 1 - b] : 0));
+    }
+  }
+
+  for (int bytes : {2, 3}) {
+    std::vector<char> inPlace(in.begin(), in.begin() + samples * bytes);
+    utils::convertPcmSamplesToBigEndian(inPlace.data(), inPlace.data(),
+                                        samples, bytes * 8, bytes * 8);
+    for (uint64_t i = 0; i < samples; ++i)
+      for (int b = 0; b < bytes; ++b)
+        REQUIRE(inPlace[i * bytes + b] == in[i * bytes + bytes - 1 - b]);
+  }
+
+  REQUIRE_THROWS_AS(utils::convertPcmSamplesToBigEndian(in.data(), in.data(),
+                                                        1, 16, 32),
+                    std::runtime_error);
+}
+
+TEST_CASE("encode_pcm_samples_big_endian") {
+  std::vector<float> in{0.f, 0.5f, -0.5f, 1.f, -1.f, 0.123f, -0.987f};
+  for (int bytes : {2, 3}) {
+    std::vector<char> little(in.size() * bytes);
+    std::vector<char> big(in.size() * bytes);
+    utils::encodePcmSamples(in.data(), little.data(), in.size(), bytes * 8);
+    utils::encodePcmSamplesBigEndian(in.data(), big.data(), in.size(),
+                                     bytes * 8);
+    for (size_t i = 0; i < in.size(); ++i)
+      for (int b = 0; b < bytes; ++b)
+        REQUIRE(big[i * bytes + b] == little[i * bytes + bytes - 1 - b]);
+  }
+  std::vector<char> out(4);
+  REQUIRE_THROWS_AS(
+      utils::encodePcmSamplesBigEndian(in.data(), out.data(), 1, 32),
+      std::runtime_error);
+}
+
+TEST_CASE("memory_stream_buf") {
+  const char data[] = "0123456789";
+  utils::MemoryStreamBuf buffer(data, 10);
+  std::istream stream(&buffer);
+
+  char value[4];
+  utils::readValue(stream, value);
+  REQUIRE(std::string(value, 4) == "0123");
+  stream.seekg(2, std::ios::cur);
+  utils::readValue(stream, value[0]);
+  REQUIRE(value[0] == '6');
+  stream.seekg(-1, std::ios::end);
+  utils::readValue(stream, value[0]);
+  REQUIRE(value[0] == '9');
+  REQUIRE_THROWS_AS(utils::readValue(stream, value[0]), std::runtime_error);
+
+  stream.clear();
+  stream.seekg(10);
+  REQUIRE(stream.good());
+  stream.seekg(11);
+  REQUIRE(stream.fail());
+}
+
 TEST_CASE("write_chunk_with_padding") {
   auto axmlChunk = std::make_shared<AxmlChunk>("123456789");
   std::ostringstream stream;
@@ -356,3 +444,136 @@ TEST_CASE("safe add") {
   checkAddNegative<int32_t>();
   checkAddNegative<int64_t>();
 }
+
+TEST_CASE("half_float") {
+  using utils::floatToHalf;
+  using utils::halfToFloat;
+  REQUIRE(floatToHalf(0.f) == 0x0000);
+  REQUIRE(floatToHalf(-0.f) == 0x8000);
+  REQUIRE(floatToHalf(1.f) == 0x3c00);
+  REQUIRE(floatToHalf(-2.f) == 0xc000);
+  REQUIRE(floatToHalf(65504.f) == 0x7bff);
+  REQUIRE(floatToHalf(65520.f) == 0x7c00);
+  REQUIRE(floatToHalf(1e10f) == 0x7c00);
+  // smallest subnormal, and ties to even around it
+  REQUIRE(floatToHalf(std::ldexp(1.f, -24)) == 0x0001);
+  REQUIRE(floatToHalf(std::ldexp(1.f, -25)) == 0x0000);
+  REQUIRE(floatToHalf(std::ldexp(3.f, -25)) == 0x0002);
+  // 1 + 2^-11 is halfway between 1 and the next half
+  REQUIRE(floatToHalf(1.f + std::ldexp(1.f, -11)) == 0x3c00);
+  REQUIRE(floatToHalf(1.f + std::ldexp(3.f, -11)) == 0x3c02);
+
+  for (uint32_t h = 0; h < 0x7c00; ++h) {
+    const uint16_t value = static_cast<uint16_t>(h);
+    REQUIRE(floatToHalf(halfToFloat(value)) == value);
+    REQUIRE(floatToHalf(-halfToFloat(value)) == (value | 0x8000));
+  }
+  REQUIRE(std::isinf(halfToFloat(0x7c00)));
+  REQUIRE(std::isnan(halfToFloat(floatToHalf(std::nanf("")))));
+}
+
+TEST_CASE("huge_page_allocator") {
+  utils::HugePageAllocator<char> enabled(true);
+  utils::HugePageAllocator<float> disabled;
+  REQUIRE(enabled != utils::HugePageAllocator<char>(disabled));
+  REQUIRE(utils::HugePageAllocator<float>(enabled).enabled());
+
+  const size_t bytes = GENERATE(size_t{100}, utils::hugePageSize() + 3);
+  char* data = enabled.allocate(bytes);
+  data[0] = 1;
+  data[bytes - 1] = 2;
+#if defined(__linux__)
+  if (bytes >= utils::hugePageSize())
+    REQUIRE(reinterpret_cast<uintptr_t>(data) % utils::hugePageSize() == 0);
+#endif
+  enabled.deallocate(data, bytes);
+
+  utils::RawBuffer buffer(bytes, 'x');
+  REQUIRE_FALSE(buffer.get_allocator().enabled());
+  buffer = utils::RawBuffer(enabled);
+  REQUIRE(buffer.get_allocator().enabled());
+  buffer.resize(bytes, 'y');
+  REQUIRE(buffer[bytes - 1] == 'y');
+}
+
+TEST_CASE("non_temporal_decode_encode") {
+  const uint16_t bitDepth = GENERATE(16, 24, 32);
+  const size_t offset = GENERATE(0, 1, 3);
+  const uint64_t samples = GENERATE(0, 1, 1500, 3000);
+  const uint16_t bytes = bitDepth / 8;
+
+  std::vector<float> input(samples);
+  for (uint64_t i = 0; i < samples; ++i)
+    input[i] = static_cast<float>(i % 256) / 100.f - 1.28f;
+  std::vector<char> pcm(samples * bytes + offset, 'x');
+  std::vector<char> expectedPcm(samples * bytes);
+  utils::encodePcmSamplesNonTemporal(input.data(), pcm.data() + offset,
+                                     samples, bitDepth);
+  utils::encodePcmSamples(input.data(), expectedPcm.data(), samples,
+                          bitDepth);
+  REQUIRE(std::equal(expectedPcm.begin(), expectedPcm.end(),
+                     pcm.begin() + offset));
+
+  std::vector<double> output(samples + offset, -2.0);
+  std::vector<double> expected(samples);
+  utils::decodePcmSamplesNonTemporal(expectedPcm.data(),
+                                     output.data() + offset, samples,
+                                     bitDepth);
+  utils::decodePcmSamples(expectedPcm.data(), expected.data(), samples,
+                          bitDepth);
+  REQUIRE(std::equal(expected.begin(), expected.end(),
+                     output.begin() + offset));
+  for (size_t i = 0; i < offset; ++i) REQUIRE(output[i] == -2.0);
+
+  std::vector<float> floatOutput(samples + offset, -2.f);
+  std::vector<float> floatExpected(samples);
+  utils::decodePcmSamplesNonTemporal(expectedPcm.data(),
+                                     floatOutput.data() + offset, samples,
+                                     bitDepth);
+  utils::decodePcmSamples(expectedPcm.data(), floatExpected.data(), samples,
+                          bitDepth);
+  REQUIRE(std::equal(floatExpected.begin(), floatExpected.end(),
+                     floatOutput.begin() + offset));
+}
+
+TEST_CASE("non_temporal_bench", "[.bench]") {
+  // 256 MiB of float output, and a working set which fits in the cache
+  const uint64_t samples = uint64_t{64} << 20;
+  std::vector<char> pcm(samples * 3);
+  for (size_t i = 0; i < pcm.size(); ++i) pcm[i] = static_cast<char>(i * 7);
+  std::vector<float> out(samples);
+  std::vector<float> workingSet(512 << 10, 1.f);
+
+  BENCHMARK("decode, cached stores") {
+    utils::decodePcmSamples(pcm.data(), out.data(), samples, 24);
+    return out[0];
+  };
+  BENCHMARK("decode, non-temporal stores") {
+    utils::decodePcmSamplesNonTemporal(pcm.data(), out.data(), samples, 24);
+    return out[0];
+  };
+  BENCHMARK("encode, cached stores") {
+    utils::encodePcmSamples(out.data(), pcm.data(), samples, 24);
+    return pcm[0];
+  };
+  BENCHMARK("encode, non-temporal stores") {
+    utils::encodePcmSamplesNonTemporal(out.data(), pcm.data(), samples, 24);
+    return pcm[0];
+  };
+
+  // decode, then a stage which reuses its own working set, e.g. filter
+  // coefficients or a model, which the decode should not evict
+  auto process = [&]() {
+    float sum = 0.f;
+    for (float value : workingSet) sum += value;
+    return sum;
+  };
+  BENCHMARK("decode then process, cached stores") {
+    utils::decodePcmSamples(pcm.data(), out.data(), samples, 24);
+    return process();
+  };
+  BENCHMARK("decode then process, non-temporal stores") {
+    utils::decodePcmSamplesNonTemporal(pcm.data(), out.data(), samples, 24);
+    return process();
+  };
+}